@@ -14,12 +14,29 @@ size_t tree_size(tree_t *tree);
 
 int tree_add(tree_t *tree, void *elem);
 
+int tree_remove(tree_t *tree, void *elem);
+
 int tree_find(tree_t *tree, void *elem);
 
+int tree_find_many(tree_t *tree, void **elems, int n, unsigned char *found);
+
+size_t tree_rank(tree_t *tree, void *elem);
+
+void *tree_select(tree_t *tree, size_t k);
+
 tree_t *tree_copy(tree_t *tree);
 
+/* Nonzero if tree_copy takes O(1) time, so copying a large tree and patching it is cheap. */
+extern const int tree_cheap_copy;
+
+tree_t *tree_build_sorted(cmpfunc_t cmpfunc, void **elems, size_t n);
+
 tree_iter_t *tree_createiter(tree_t *tree);
 
+tree_iter_t *tree_createiter_range(tree_t *tree, void *lo, void *hi);
+
+void tree_iter_seek(tree_iter_t *iter, void *key);
+
 void tree_destroyiter(tree_iter_t *iter);
 
 int tree_hasnext(tree_iter_t *iter);
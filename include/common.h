@@ -7,12 +7,19 @@
 #include <ctype.h>
 
 struct list;
+struct set;
 
 /*
  * The type of comparison functions.
  */
 typedef int (*cmpfunc_t)(void *, void *);
 
+/*
+ * The type of hash functions.  Elements that are equal according
+ * to the comparison function in use must hash to the same value.
+ */
+typedef unsigned long (*hashfunc_t)(void *);
+
 
 /*
  * Reads the given file, and parses it into words (tokens).
@@ -22,9 +29,93 @@ typedef int (*cmpfunc_t)(void *, void *);
  * This tokenizer ignores punctuation and whitespace, so if the file
  * contains the text "Hello! This is an example...." the recognized
  * words will be "Hello", "This", "is", "an", and "example".
+ * Words are made of letters, digits, apostrophes and underscores, and
+ * words longer than 100 characters are split into pieces of 100.
+ *
+ * Regular files are mapped into memory and scanned in place with a
+ * word scanner (see wordscan.h).  Pipes and other files that cannot
+ * be mapped are read in large chunks.
  */
 void tokenize_file(FILE *file, struct list *list);
 
+/*
+ * The type of functions that turn a word into a set element.  The
+ * word is only valid during the call.
+ */
+typedef void *(*wordfunc_t)(const char *word, void *arg);
+
+/*
+ * Reads the given file, and adds the words found by tokenize_file to
+ * the given set, without building a list of every word first.
+ *
+ * If elemfunc is NULL, the set must hold strings that compare with
+ * compare_strings.  Only words not already in the set are copied with
+ * strdup(), and the caller frees the copies.  Otherwise each word is
+ * added as elemfunc(word, arg), and elemfunc decides what to keep.
+ * Either way, the memory used grows with the number of distinct
+ * words, not with the number of words in the file.
+ */
+void tokenize_file_into_set(FILE *file, struct set *set, wordfunc_t elemfunc, void *arg);
+
+/*
+ * A word that is not copied: the len bytes starting at data.  The
+ * bytes are not followed by a NUL.
+ */
+typedef struct span {
+    const char *data;
+    size_t len;
+} span_t;
+
+/*
+ * The type of tokenized files, which keep the contents of a file
+ * along with spans for each of its words.
+ */
+struct tokens;
+typedef struct tokens tokens_t;
+
+/*
+ * Reads the given file and finds the same words as tokenize_file, but
+ * does not copy them.  The file's contents stay mapped (or buffered)
+ * until the result is destroyed, and the words are spans into them,
+ * so a file costs a handful of allocations however many words it has.
+ */
+tokens_t *tokenize_file_spans(FILE *file);
+
+/*
+ * Destroys the given tokenized file.  Its spans are no longer valid
+ * after this.
+ */
+void tokens_destroy(tokens_t *tokens);
+
+/*
+ * Returns the number of words in the given tokenized file.
+ */
+int tokens_size(tokens_t *tokens);
+
+/*
+ * Returns the span of the i'th word of the given tokenized file, in
+ * the order the words occur in the file.  The span may be added to a
+ * set that compares with compare_spans.
+ */
+span_t *tokens_get(tokens_t *tokens, int i);
+
+/*
+ * The type of functions called for each file found by walk_files.
+ * The path is only valid during the call.
+ */
+typedef void (*filefunc_t)(char *path, void *arg);
+
+/*
+ * Recursively walks the given root directory, and calls func(path, arg)
+ * for each file under it that is not a directory, as soon as it is
+ * found.  Files come in the same order as from find(1), and paths
+ * are built the same way, with no limit on their length.  Symbolic
+ * links are reported as files and not followed, including a root
+ * that is one, as with find -P.  Directories that cannot be read are
+ * reported on stderr and skipped.  Returns the number of files found.
+ */
+int walk_files(char *root, filefunc_t func, void *arg);
+
 /*
  * Recursively finds the names of all files under the given root directory.
  * Returns the file names as a list of strings.
@@ -36,4 +127,15 @@ struct list *find_files(char *root);
  */
 int compare_strings(void *a, void *b);
 
+/*
+ * Compares two spans in the same order as compare_strings compares
+ * the same words as strings.
+ */
+int compare_spans(void *a, void *b);
+
+/*
+ * Hashes a span, for sets created with set_create_hashed.
+ */
+unsigned long hash_spans(void *a);
+
 #endif
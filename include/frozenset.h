@@ -0,0 +1,79 @@
+#ifndef FROZENSET_H
+#define FROZENSET_H
+
+#include "common.h"
+#include "set.h"
+
+/*
+ * The type of frozen sets.
+ *
+ * A frozen set is an immutable copy of a set, kept in one contiguous
+ * array in Eytzinger order: the root first, then its two children,
+ * then their four children and so on.  The first levels of every
+ * search share the same few cache lines, and the elements a search
+ * may need a few steps ahead can be prefetched, so lookups suit sets
+ * that are built once and then queried many times.
+ */
+struct frozenset;
+typedef struct frozenset frozenset_t;
+
+/*
+ * Creates a frozen set holding the elements of the given set, which
+ * must be ordered by the given comparison function.  The given set is
+ * left unchanged, and may be destroyed once it has been frozen.
+ */
+frozenset_t *set_freeze(set_t *set, cmpfunc_t cmpfunc);
+
+/*
+ * Destroys the given frozen set.
+ */
+void frozenset_destroy(frozenset_t *set);
+
+/*
+ * Returns the size (cardinality) of the given frozen set.
+ */
+int frozenset_size(frozenset_t *set);
+
+/*
+ * Returns 1 if the given element is contained in the given
+ * frozen set, 0 otherwise.
+ */
+int frozenset_contains(frozenset_t *set, void *elem);
+
+/*
+ * Looks up the n given elements in the given frozen set.  Sets bit i
+ * of the bitmap found, which must hold (n + 7) / 8 bytes, if elems[i]
+ * is contained in the set, and clears it otherwise.  Returns the
+ * number of elements found.
+ */
+int frozenset_contains_many(frozenset_t *set, void **elems, int n, unsigned char *found);
+
+/*
+ * The type of frozen set iterators.
+ */
+struct frozenset_iter;
+typedef struct frozenset_iter frozenset_iter_t;
+
+/*
+ * Creates a new iterator that visits the elements of the given
+ * frozen set in ascending order.
+ */
+frozenset_iter_t *frozenset_createiter(frozenset_t *set);
+
+/*
+ * Destroys the given frozen set iterator.
+ */
+void frozenset_destroyiter(frozenset_iter_t *iter);
+
+/*
+ * Returns 0 if the given iterator has reached the end of the
+ * frozen set, or 1 otherwise.
+ */
+int frozenset_hasnext(frozenset_iter_t *iter);
+
+/*
+ * Returns the next element of the given iterator.
+ */
+void *frozenset_next(frozenset_iter_t *iter);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdint.h>
+
+/*
+ * The type of intern tables.
+ *
+ * An intern table gives every distinct word a small integer ID, so
+ * that words can be stored and compared as integers.  Words are
+ * case-folded first, so "Hello" and "hello" get the same ID.  IDs are
+ * dense: the n distinct words seen so far have the IDs 1 to n.  0 is
+ * never an ID, so an ID can be stored as a non-NULL set element.
+ */
+struct intern;
+typedef struct intern intern_t;
+
+/*
+ * Creates a new, empty intern table.
+ */
+intern_t *intern_create(void);
+
+/*
+ * Destroys the given intern table, and the words it holds.
+ */
+void intern_destroy(intern_t *table);
+
+/*
+ * Returns the number of distinct words in the given intern table.
+ */
+int intern_count(intern_t *table);
+
+/*
+ * Returns the ID of the given word, giving it the next unused ID if
+ * the word has not been seen before.  The word is copied, and need
+ * not outlive the call.
+ */
+uint32_t intern_word(intern_t *table, const char *word);
+
+/*
+ * Returns the case-folded word with the given ID, or NULL if no word
+ * has that ID.  The word lives as long as the table.
+ */
+const char *intern_lookup(intern_t *table, uint32_t id);
+
+#endif
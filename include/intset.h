@@ -0,0 +1,108 @@
+#ifndef INTSET_H
+#define INTSET_H
+
+#include "common.h"
+#include "set.h"
+
+/*
+ * The type of integer sets.
+ *
+ * An integer set stores non-negative integers directly, in the manner
+ * of a Roaring bitmap: values are grouped by their upper 16 bits, and
+ * the lower 16 bits of each group are kept in a container that is
+ * either a sorted array (sparse groups), a 65536-bit bitmap (dense
+ * groups) or a list of runs (long consecutive stretches).  Union,
+ * intersection and difference work on whole 64-bit words at a time
+ * wherever two bitmaps meet.
+ */
+struct intset;
+typedef struct intset intset_t;
+
+/*
+ * Creates a new, empty integer set.
+ */
+intset_t *intset_create(void);
+
+/*
+ * Creates a new integer set holding the same values as the given set,
+ * whose elements must be pointers to non-negative ints.
+ */
+intset_t *intset_from_set(set_t *set);
+
+/*
+ * Destroys the given integer set.
+ */
+void intset_destroy(intset_t *set);
+
+/*
+ * Returns the size (cardinality) of the given integer set.
+ */
+int intset_size(intset_t *set);
+
+/*
+ * Adds the given value to the given integer set.
+ */
+void intset_add(intset_t *set, unsigned int value);
+
+/*
+ * Returns 1 if the given value is contained in the given
+ * integer set, 0 otherwise.
+ */
+int intset_contains(intset_t *set, unsigned int value);
+
+/*
+ * Converts containers to runs wherever that takes less space.
+ * Call this once a set is done growing; adding a value to a run
+ * container turns it back into an array or bitmap.
+ */
+void intset_optimize(intset_t *set);
+
+/*
+ * Returns the union of the two given integer sets.
+ */
+intset_t *intset_union(intset_t *a, intset_t *b);
+
+/*
+ * Returns the intersection of the two given integer sets.
+ */
+intset_t *intset_intersection(intset_t *a, intset_t *b);
+
+/*
+ * Returns the values of a that are not in b.
+ */
+intset_t *intset_difference(intset_t *a, intset_t *b);
+
+/*
+ * Returns a copy of the given integer set.
+ */
+intset_t *intset_copy(intset_t *set);
+
+/*
+ * The type of integer set iterators.
+ */
+struct intset_iter;
+typedef struct intset_iter intset_iter_t;
+
+/*
+ * Creates a new iterator that visits the values of the given
+ * integer set in ascending order.
+ */
+intset_iter_t *intset_createiter(intset_t *set);
+
+/*
+ * Destroys the given integer set iterator.
+ */
+void intset_destroyiter(intset_iter_t *iter);
+
+/*
+ * Returns 0 if the given iterator has reached the end of the
+ * integer set, or 1 otherwise.
+ */
+int intset_hasnext(intset_iter_t *iter);
+
+/*
+ * Returns the next value of the given iterator.
+ */
+unsigned int intset_next(intset_iter_t *iter);
+
+#endif
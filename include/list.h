@@ -53,6 +53,14 @@ void *list_popfirst(list_t *list);
  */
 void *list_poplast(list_t *list);
 
+/*
+ * Removes the first element of the given list that is equal to the
+ * given element.  Returns 1 if an element was removed, 0 otherwise.
+ *
+ * The comparison function of the list is used to check elements for equality.
+ */
+int list_remove(list_t *list, void *elem);
+
 /*
  * Returns 1 if the given list contains the given element, 0 otherwise.
  *
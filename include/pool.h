@@ -0,0 +1,41 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/*
+ * The type of node pools.
+ *
+ * A pool hands out objects of one fixed size from large slabs, so a
+ * container that allocates one node per element makes only a handful
+ * of calls to malloc.  Freed objects are kept on a free list and
+ * reused by later allocations, and destroying the pool releases every
+ * object at once, without visiting them one by one.
+ */
+struct pool;
+typedef struct pool pool_t;
+
+/*
+ * Creates a new, empty pool for objects of the given size.
+ * Returns NULL if out of memory.
+ */
+pool_t *pool_create(size_t objsize);
+
+/*
+ * Destroys the given pool, and every object allocated from it.
+ */
+void pool_destroy(pool_t *pool);
+
+/*
+ * Returns a new, uninitialized object from the given pool, or NULL
+ * if out of memory.
+ */
+void *pool_alloc(pool_t *pool);
+
+/*
+ * Returns the given object to the pool it was allocated from, so it
+ * may be handed out again.
+ */
+void pool_free(pool_t *pool, void *obj);
+
+#endif
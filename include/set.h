@@ -16,6 +16,24 @@ typedef struct set set_t;
  */
 set_t *set_create(cmpfunc_t cmpfunc);
 
+/*
+ * Creates a new set using the given comparison function to compare
+ * elements, and the given hash function to hash them.  Backends that
+ * do not hash their elements ignore the hash function, so this is
+ * always a valid replacement for set_create().
+ */
+set_t *set_create_hashed(cmpfunc_t cmpfunc, hashfunc_t hashfunc);
+
+/*
+ * Creates a new set holding the n elements of the given array, which
+ * must be sorted in ascending order by the given comparison function.
+ * Duplicates are skipped.  The set is built directly from the sorted
+ * elements in O(n) time where the backend allows it.  The hash
+ * function may be NULL, as for set_create_hashed().
+ */
+set_t *set_from_sorted_array(cmpfunc_t cmpfunc, hashfunc_t hashfunc,
+                             void **elems, int n);
+
 /*
  * Destroys the given set.  Subsequently accessing the set
  * will lead to undefined behavior.
@@ -32,12 +50,49 @@ int set_size(set_t *set);
  */
 void set_add(set_t *set, void *elem);
 
+/*
+ * Adds the n elements of the given array, in any order, to the given
+ * set.  The array is left untouched.  This sorts the elements once
+ * and merges them into the set, instead of searching the set for
+ * each element in turn.
+ */
+void set_add_all(set_t *set, void **elems, int n);
+
+/*
+ * Removes the given element from the given set, if it is there.
+ * Returns 1 if the element was removed, 0 if it was not in the set.
+ */
+int set_remove(set_t *set, void *elem);
+
 /*
  * Returns 1 if the given element is contained in
  * the given set, 0 otherwise.
  */
 int set_contains(set_t *set, void *elem);
 
+/*
+ * Looks up the n given elements in the given set.  Sets bit i of the
+ * bitmap found, which must hold (n + 7) / 8 bytes, if elems[i] is
+ * contained in the set, and clears it otherwise.  Returns the number
+ * of elements found.
+ */
+int set_contains_many(set_t *set, void **elems, int n, unsigned char *found);
+
+/*
+ * Returns the number of elements in the given set that are smaller
+ * than the given element, which need not be in the set itself.
+ */
+int set_rank(set_t *set, void *elem);
+
+/*
+ * Returns the element at position k, counting from 0, of the given
+ * set in ascending order, or NULL if there is no such position.  The
+ * p-th percentile is set_select(set, p * (set_size(set) - 1) / 100).
+ * The binary tree backends answer both this and set_rank() in
+ * O(log n).
+ */
+void *set_select(set_t *set, int k);
+
 /*
  * Returns the union of the two given sets; the returned
  * set contains all elements that are contained in either
@@ -59,6 +114,19 @@ set_t *set_intersection(set_t *a, set_t *b);
  */
 set_t *set_difference(set_t *a, set_t *b);
 
+/*
+ * Adds every element of b to a.  Unlike set_union(), this changes a
+ * instead of creating a new set, so folding a union over many sets
+ * keeps only one set alive.
+ */
+void set_union_into(set_t *a, set_t *b);
+
+/*
+ * Removes every element from a that is not contained in b.  This is
+ * the in-place counterpart of set_intersection().
+ */
+void set_intersect_into(set_t *a, set_t *b);
+
 /*
  * Returns a copy of the given set.
  */
@@ -75,6 +143,14 @@ typedef struct set_iter set_iter_t;
  */
 set_iter_t *set_createiter(set_t *set);
 
+/*
+ * Creates a new set iterator that visits, in ascending order, the
+ * elements of the given set that are not smaller than lo and smaller
+ * than hi.  Either bound may be NULL, leaving that end open.  The
+ * tree backends find both ends in O(log n).
+ */
+set_iter_t *set_createiter_range(set_t *set, void *lo, void *hi);
+
 /*
  * Destroys the given set iterator.
  */
@@ -92,4 +168,12 @@ int set_hasnext(set_iter_t *iter);
  */
 void *set_next(set_iter_t *iter);
 
+/*
+ * Moves the given set iterator forward to the first element that is
+ * not smaller than key, so that the next call to set_next() returns
+ * it.  A key at or before the current position leaves the iterator
+ * where it is, and a key past the end of its range exhausts it.
+ */
+void set_iter_seek(set_iter_t *iter, void *key);
+
 #endif
@@ -0,0 +1,834 @@
+#ifndef SET_HPP
+#define SET_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * A header-only C++ counterpart to set.h.
+ *
+ * sets::Set<T, Compare, Backend> stores its elements by value, not
+ * as void pointers, and orders them with a comparison object whose
+ * type is known at compile time, so comparisons can be inlined.
+ * Compare follows the standard library: a strict weak ordering,
+ * std::less<T> by default.  Elements only need to be movable; copying
+ * a set, or taking the union, intersection or difference of sets
+ * passed as lvalues, also needs them to be copyable.  Sets passed as
+ * rvalues have their elements moved into the result.
+ *
+ * The backend decides how the elements are kept:
+ *  - sets::list_backend:  a sorted, singly linked list, like set.c.
+ *  - sets::tree_backend:  a balanced (AVL) binary search tree.
+ *  - sets::array_backend: a sorted array, like set_array.c.
+ */
+namespace sets {
+
+namespace detail {
+
+/*
+ * Allocates the nodes of one list or tree from a few large chunks,
+ * like pool.c does for the C backends, so that nodes made one after
+ * another lie close together in memory.  Freed nodes are reused.
+ */
+template <typename Node>
+class node_pool {
+    union slot {
+        slot *next;
+        alignas(Node) unsigned char storage[sizeof(Node)];
+    };
+
+    std::vector<std::unique_ptr<slot[]>> chunks;
+    slot *freelist = nullptr;
+    std::size_t chunk_size = 64;
+
+public:
+    node_pool() = default;
+    node_pool(node_pool &&other) noexcept
+        : chunks(std::move(other.chunks)), freelist(other.freelist), chunk_size(other.chunk_size)
+    {
+        other.freelist = nullptr;
+    }
+    node_pool &operator=(node_pool &&other) noexcept
+    {
+        std::swap(chunks, other.chunks);
+        std::swap(freelist, other.freelist);
+        std::swap(chunk_size, other.chunk_size);
+        return *this;
+    }
+
+    template <typename... Args>
+    Node *create(Args &&...args)
+    {
+        slot *s;
+
+        if (!freelist) {
+            /* Each chunk is as large as all before it, up to a limit. */
+            chunks.emplace_back(new slot[chunk_size]);
+            for (std::size_t i = 0; i < chunk_size; i++) {
+                chunks.back()[i].next = freelist;
+                freelist = &chunks.back()[i];
+            }
+            chunk_size = std::min<std::size_t>(2 * chunk_size, 65536);
+        }
+        s = freelist;
+        freelist = s->next;
+        try {
+            return new (s->storage) Node(std::forward<Args>(args)...);
+        } catch (...) {
+            s->next = freelist;
+            freelist = s;
+            throw;
+        }
+    }
+
+    void destroy(Node *p)
+    {
+        slot *s = reinterpret_cast<slot *>(p);
+
+        p->~Node();
+        s->next = freelist;
+        freelist = s;
+    }
+
+    /*
+     * Frees every chunk at once.  The nodes must have been destroyed,
+     * or need no destructor.
+     */
+    void clear()
+    {
+        chunks.clear();
+        freelist = nullptr;
+        chunk_size = 64;
+    }
+};
+
+} // namespace detail
+
+/*
+ * Sorted, singly linked list.  Adding, finding and removing an
+ * element are linear.
+ */
+template <typename T, typename Compare>
+class list_backend {
+    struct node {
+        T value;
+        node *next;
+
+        template <typename U>
+        node(U &&value, node *next) : value(std::forward<U>(value)), next(next) {}
+    };
+
+    node *head = nullptr;
+    std::size_t n = 0;
+    Compare cmp;
+    detail::node_pool<node> pool;
+
+    /*
+     * Returns the link that points to the first node whose value is
+     * not smaller than the given value.
+     */
+    node **lowerbound(const T &value)
+    {
+        node **link = &head;
+
+        while (*link && cmp((*link)->value, value))
+            link = &(*link)->next;
+        return link;
+    }
+
+public:
+    class const_iterator {
+        const node *current;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        explicit const_iterator(const node *current = nullptr) : current(current) {}
+        reference operator*() const { return current->value; }
+        pointer operator->() const { return &current->value; }
+        const_iterator &operator++() { current = current->next; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; ++*this; return old; }
+        bool operator==(const const_iterator &other) const { return current == other.current; }
+        bool operator!=(const const_iterator &other) const { return current != other.current; }
+    };
+
+    explicit list_backend(const Compare &cmp) : cmp(cmp) {}
+    list_backend(list_backend &&other) noexcept
+        : head(other.head), n(other.n), cmp(std::move(other.cmp)), pool(std::move(other.pool))
+    {
+        other.head = nullptr;
+        other.n = 0;
+    }
+    list_backend &operator=(list_backend &&other) noexcept
+    {
+        std::swap(head, other.head);
+        std::swap(n, other.n);
+        std::swap(cmp, other.cmp);
+        std::swap(pool, other.pool);
+        return *this;
+    }
+    ~list_backend() { clear(); }
+
+    const Compare &key_comp() const { return cmp; }
+    std::size_t size() const { return n; }
+    const_iterator begin() const { return const_iterator(head); }
+    const_iterator end() const { return const_iterator(); }
+
+    bool contains(const T &value) const
+    {
+        const node *p = head;
+
+        while (p && cmp(p->value, value))
+            p = p->next;
+        return p && !cmp(value, p->value);
+    }
+
+    template <typename U>
+    bool insert(U &&value)
+    {
+        node **link = lowerbound(value);
+
+        if (*link && !cmp(value, (*link)->value))
+            return false;
+        *link = pool.create(std::forward<U>(value), *link);
+        n++;
+        return true;
+    }
+
+    bool erase(const T &value)
+    {
+        node **link = lowerbound(value);
+        node *p = *link;
+
+        if (!p || cmp(value, p->value))
+            return false;
+        *link = p->next;
+        pool.destroy(p);
+        n--;
+        return true;
+    }
+
+    void clear()
+    {
+        while (head && !std::is_trivially_destructible<T>::value) {
+            node *next = head->next;
+            pool.destroy(head);
+            head = next;
+        }
+        head = nullptr;
+        n = 0;
+        pool.clear();
+    }
+
+    /*
+     * Replaces the elements with the given ones, which must be
+     * sorted and unique.
+     */
+    void assign_sorted(std::vector<T> &&elems)
+    {
+        node **link = &head;
+
+        clear();
+        for (T &value : elems) {
+            *link = pool.create(std::move(value), nullptr);
+            link = &(*link)->next;
+        }
+        n = elems.size();
+    }
+
+    /*
+     * Moves all elements out in ascending order, leaving the list empty.
+     */
+    std::vector<T> release()
+    {
+        std::vector<T> elems;
+
+        elems.reserve(n);
+        while (head) {
+            node *next = head->next;
+            elems.push_back(std::move(head->value));
+            pool.destroy(head);
+            head = next;
+        }
+        n = 0;
+        pool.clear();
+        return elems;
+    }
+};
+
+/*
+ * AVL tree.  Adding, finding and removing an element are O(log n),
+ * and iterators keep the path from the root on a stack, so the nodes
+ * need no parent pointers.
+ */
+template <typename T, typename Compare>
+class tree_backend {
+    struct node {
+        T value;
+        node *left = nullptr;
+        node *right = nullptr;
+        int height = 1;
+
+        template <typename U>
+        explicit node(U &&value) : value(std::forward<U>(value)) {}
+    };
+
+    node *root = nullptr;
+    std::size_t n = 0;
+    Compare cmp;
+    detail::node_pool<node> pool;
+
+    static int height(const node *p) { return p ? p->height : 0; }
+
+    static void update(node *p)
+    {
+        p->height = 1 + std::max(height(p->left), height(p->right));
+    }
+
+    static node *rotate_left(node *p)
+    {
+        node *r = p->right;
+
+        p->right = r->left;
+        r->left = p;
+        update(p);
+        update(r);
+        return r;
+    }
+
+    static node *rotate_right(node *p)
+    {
+        node *l = p->left;
+
+        p->left = l->right;
+        l->right = p;
+        update(p);
+        update(l);
+        return l;
+    }
+
+    /*
+     * Restores the AVL balance of p, whose subtrees differ in height
+     * by at most two, and returns the new root of the subtree.
+     */
+    static node *rebalance(node *p)
+    {
+        int balance = height(p->left) - height(p->right);
+
+        if (balance > 1) {
+            if (height(p->left->left) < height(p->left->right))
+                p->left = rotate_left(p->left);
+            return rotate_right(p);
+        }
+        if (balance < -1) {
+            if (height(p->right->right) < height(p->right->left))
+                p->right = rotate_right(p->right);
+            return rotate_left(p);
+        }
+        update(p);
+        return p;
+    }
+
+    template <typename U>
+    node *insert(node *p, U &&value, bool &added)
+    {
+        if (!p) {
+            added = true;
+            return pool.create(std::forward<U>(value));
+        }
+        if (cmp(value, p->value))
+            p->left = insert(p->left, std::forward<U>(value), added);
+        else if (cmp(p->value, value))
+            p->right = insert(p->right, std::forward<U>(value), added);
+        else
+            return p;
+        return rebalance(p);
+    }
+
+    /*
+     * Unlinks the smallest node of the subtree rooted at p, and
+     * returns the new root of the subtree.
+     */
+    static node *unlinkmin(node *p, node *&min)
+    {
+        if (!p->left) {
+            min = p;
+            return p->right;
+        }
+        p->left = unlinkmin(p->left, min);
+        return rebalance(p);
+    }
+
+    node *erase(node *p, const T &value, bool &removed)
+    {
+        if (!p)
+            return nullptr;
+        if (cmp(value, p->value)) {
+            p->left = erase(p->left, value, removed);
+        } else if (cmp(p->value, value)) {
+            p->right = erase(p->right, value, removed);
+        } else {
+            node *left = p->left, *right = p->right, *min;
+
+            pool.destroy(p);
+            removed = true;
+            if (!right)
+                return left;
+
+            /* Relink the successor in place of p, so no value is moved. */
+            right = unlinkmin(right, min);
+            min->left = left;
+            min->right = right;
+            p = min;
+        }
+        return rebalance(p);
+    }
+
+    node *build(T *elems, std::size_t n)
+    {
+        std::size_t mid = n / 2;
+        node *p;
+
+        if (n == 0)
+            return nullptr;
+        p = pool.create(std::move(elems[mid]));
+        p->left = build(elems, mid);
+        p->right = build(elems + mid + 1, n - mid - 1);
+        update(p);
+        return p;
+    }
+
+    void destroy(node *p)
+    {
+        if (p) {
+            destroy(p->left);
+            destroy(p->right);
+            pool.destroy(p);
+        }
+    }
+
+    void release(node *p, std::vector<T> &elems)
+    {
+        if (p) {
+            release(p->left, elems);
+            elems.push_back(std::move(p->value));
+            release(p->right, elems);
+            pool.destroy(p);
+        }
+    }
+
+public:
+    class const_iterator {
+        std::vector<const node *> stack;
+
+        void pushleft(const node *p)
+        {
+            for (; p; p = p->left)
+                stack.push_back(p);
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        const_iterator() = default;
+        explicit const_iterator(const node *root) { pushleft(root); }
+        reference operator*() const { return stack.back()->value; }
+        pointer operator->() const { return &stack.back()->value; }
+
+        const_iterator &operator++()
+        {
+            const node *p = stack.back();
+
+            stack.pop_back();
+            pushleft(p->right);
+            return *this;
+        }
+
+        const_iterator operator++(int) { const_iterator old = *this; ++*this; return old; }
+
+        bool operator==(const const_iterator &other) const
+        {
+            if (stack.empty() || other.stack.empty())
+                return stack.empty() == other.stack.empty();
+            return stack.back() == other.stack.back();
+        }
+
+        bool operator!=(const const_iterator &other) const { return !(*this == other); }
+    };
+
+    explicit tree_backend(const Compare &cmp) : cmp(cmp) {}
+    tree_backend(tree_backend &&other) noexcept
+        : root(other.root), n(other.n), cmp(std::move(other.cmp)), pool(std::move(other.pool))
+    {
+        other.root = nullptr;
+        other.n = 0;
+    }
+    tree_backend &operator=(tree_backend &&other) noexcept
+    {
+        std::swap(root, other.root);
+        std::swap(n, other.n);
+        std::swap(cmp, other.cmp);
+        std::swap(pool, other.pool);
+        return *this;
+    }
+    ~tree_backend() { clear(); }
+
+    const Compare &key_comp() const { return cmp; }
+    std::size_t size() const { return n; }
+    const_iterator begin() const { return const_iterator(root); }
+    const_iterator end() const { return const_iterator(); }
+
+    bool contains(const T &value) const
+    {
+        const node *p = root;
+
+        while (p) {
+            if (cmp(value, p->value))
+                p = p->left;
+            else if (cmp(p->value, value))
+                p = p->right;
+            else
+                return true;
+        }
+        return false;
+    }
+
+    template <typename U>
+    bool insert(U &&value)
+    {
+        bool added = false;
+
+        root = insert(root, std::forward<U>(value), added);
+        n += added;
+        return added;
+    }
+
+    bool erase(const T &value)
+    {
+        bool removed = false;
+
+        root = erase(root, value, removed);
+        n -= removed;
+        return removed;
+    }
+
+    void clear()
+    {
+        if (!std::is_trivially_destructible<T>::value)
+            destroy(root);
+        root = nullptr;
+        n = 0;
+        pool.clear();
+    }
+
+    /*
+     * Replaces the elements with the given ones, which must be
+     * sorted and unique, building a balanced tree in linear time.
+     */
+    void assign_sorted(std::vector<T> &&elems)
+    {
+        clear();
+        root = build(elems.data(), elems.size());
+        n = elems.size();
+    }
+
+    /*
+     * Moves all elements out in ascending order, leaving the tree empty.
+     */
+    std::vector<T> release()
+    {
+        std::vector<T> elems;
+
+        elems.reserve(n);
+        release(root, elems);
+        root = nullptr;
+        n = 0;
+        pool.clear();
+        return elems;
+    }
+};
+
+/*
+ * Sorted array.  Finding an element is a binary search, but adding
+ * or removing one shifts the elements after it.
+ */
+template <typename T, typename Compare>
+class array_backend {
+    std::vector<T> elems;
+    Compare cmp;
+
+public:
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    explicit array_backend(const Compare &cmp) : cmp(cmp) {}
+
+    const Compare &key_comp() const { return cmp; }
+    std::size_t size() const { return elems.size(); }
+    const_iterator begin() const { return elems.begin(); }
+    const_iterator end() const { return elems.end(); }
+
+    bool contains(const T &value) const
+    {
+        auto it = std::lower_bound(elems.begin(), elems.end(), value, cmp);
+
+        return it != elems.end() && !cmp(value, *it);
+    }
+
+    template <typename U>
+    bool insert(U &&value)
+    {
+        auto it = std::lower_bound(elems.begin(), elems.end(), value, cmp);
+
+        if (it != elems.end() && !cmp(value, *it))
+            return false;
+        elems.insert(it, std::forward<U>(value));
+        return true;
+    }
+
+    bool erase(const T &value)
+    {
+        auto it = std::lower_bound(elems.begin(), elems.end(), value, cmp);
+
+        if (it == elems.end() || cmp(value, *it))
+            return false;
+        elems.erase(it);
+        return true;
+    }
+
+    void clear() { elems.clear(); }
+
+    /*
+     * Replaces the elements with the given ones, which must be
+     * sorted and unique.
+     */
+    void assign_sorted(std::vector<T> &&sorted) { elems = std::move(sorted); }
+
+    /*
+     * Moves all elements out in ascending order, leaving the array empty.
+     */
+    std::vector<T> release()
+    {
+        std::vector<T> out = std::move(elems);
+
+        elems.clear();
+        return out;
+    }
+};
+
+/*
+ * The type of sets.
+ */
+template <typename T, typename Compare = std::less<T>,
+          template <typename, typename> class Backend = tree_backend>
+class Set {
+    Backend<T, Compare> backend;
+
+public:
+    using value_type = T;
+    using key_compare = Compare;
+    using const_iterator = typename Backend<T, Compare>::const_iterator;
+    using iterator = const_iterator;
+
+    /*
+     * Creates a new, empty set.
+     */
+    explicit Set(const Compare &cmp = Compare()) : backend(cmp) {}
+
+    /*
+     * Creates a new set holding the given elements, which must be
+     * sorted and unique, without comparing them.
+     */
+    static Set from_sorted(std::vector<T> elems, const Compare &cmp = Compare())
+    {
+        Set set(cmp);
+
+        set.backend.assign_sorted(std::move(elems));
+        return set;
+    }
+
+    Set(const Set &other) : backend(other.key_comp())
+    {
+        backend.assign_sorted(std::vector<T>(other.begin(), other.end()));
+    }
+
+    Set &operator=(const Set &other)
+    {
+        if (this != &other)
+            *this = Set(other);
+        return *this;
+    }
+
+    Set(Set &&other) = default;
+    Set &operator=(Set &&other) = default;
+
+    const Compare &key_comp() const { return backend.key_comp(); }
+
+    /*
+     * Returns the size (cardinality) of the set.
+     */
+    std::size_t size() const { return backend.size(); }
+    bool empty() const { return backend.size() == 0; }
+
+    /*
+     * Adds the given element to the set, copying or moving it.
+     * Returns true if it was added, false if an equal element was
+     * already there, in which case a moved element is left untouched.
+     */
+    bool insert(const T &value) { return backend.insert(value); }
+    bool insert(T &&value) { return backend.insert(std::move(value)); }
+
+    /*
+     * Removes the given element from the set.  Returns true if it
+     * was there.
+     */
+    bool erase(const T &value) { return backend.erase(value); }
+
+    /*
+     * Returns true if the given element is contained in the set.
+     */
+    bool contains(const T &value) const { return backend.contains(value); }
+
+    void clear() { backend.clear(); }
+
+    /*
+     * Iterates over the elements in ascending order.
+     */
+    const_iterator begin() const { return backend.begin(); }
+    const_iterator end() const { return backend.end(); }
+
+    /*
+     * Moves all elements out in ascending order, leaving the set empty.
+     */
+    std::vector<T> release() { return backend.release(); }
+};
+
+namespace detail {
+
+template <typename S>
+struct is_set : std::false_type {};
+
+template <typename T, typename Compare, template <typename, typename> class Backend>
+struct is_set<Set<T, Compare, Backend>> : std::true_type {};
+
+/*
+ * The elements of one operand of a set operation.  An lvalue set is
+ * read in place and its elements are copied, an rvalue set is
+ * emptied and its elements are moved.
+ */
+template <typename S, bool Move>
+class source {
+    const S &set;
+
+public:
+    explicit source(const S &set) : set(set) {}
+    typename S::const_iterator begin() const { return set.begin(); }
+    typename S::const_iterator end() const { return set.end(); }
+};
+
+template <typename S>
+class source<S, true> {
+    std::vector<typename S::value_type> elems;
+
+public:
+    explicit source(S &&set) : elems(set.release()) {}
+    auto begin() { return std::make_move_iterator(elems.begin()); }
+    auto end() { return std::make_move_iterator(elems.end()); }
+};
+
+template <typename A>
+using source_for = source<std::decay_t<A>, !std::is_lvalue_reference<A>::value>;
+
+template <typename A, typename B>
+using enable_if_sets = std::enable_if_t<is_set<std::decay_t<A>>::value &&
+                                        std::is_same<std::decay_t<A>, std::decay_t<B>>::value,
+                                        std::decay_t<A>>;
+
+/*
+ * Merges the two sorted operands into a sorted result.  keep_a,
+ * keep_b and keep_both choose which elements of the three kinds
+ * (only in a, only in b, in both) are kept; an element in both is
+ * taken from a.
+ */
+template <typename S, typename A, typename B>
+S merge(A &&a, B &&b, bool keep_a, bool keep_b, bool keep_both)
+{
+    auto cmp = a.key_comp();
+    source_for<A> ra(std::forward<A>(a));
+    source_for<B> rb(std::forward<B>(b));
+    auto ia = ra.begin(), ea = ra.end();
+    auto ib = rb.begin(), eb = rb.end();
+    std::vector<typename S::value_type> out;
+
+    while (ia != ea && ib != eb) {
+        if (cmp(*ia, *ib)) {
+            if (keep_a)
+                out.push_back(*ia);
+            ++ia;
+        } else if (cmp(*ib, *ia)) {
+            if (keep_b)
+                out.push_back(*ib);
+            ++ib;
+        } else {
+            if (keep_both)
+                out.push_back(*ia);
+            ++ia;
+            ++ib;
+        }
+    }
+    for (; keep_a && ia != ea; ++ia)
+        out.push_back(*ia);
+    for (; keep_b && ib != eb; ++ib)
+        out.push_back(*ib);
+
+    return S::from_sorted(std::move(out), cmp);
+}
+
+} // namespace detail
+
+/*
+ * Returns the union of the two given sets.  Operands passed as
+ * rvalues are left empty, their elements moved into the result.
+ */
+template <typename A, typename B>
+detail::enable_if_sets<A, B> set_union(A &&a, B &&b)
+{
+    return detail::merge<std::decay_t<A>>(std::forward<A>(a), std::forward<B>(b), true, true, true);
+}
+
+/*
+ * Returns the intersection of the two given sets, with the elements
+ * taken from a.
+ */
+template <typename A, typename B>
+detail::enable_if_sets<A, B> set_intersection(A &&a, B &&b)
+{
+    return detail::merge<std::decay_t<A>>(std::forward<A>(a), std::forward<B>(b), false, false, true);
+}
+
+/*
+ * Returns the elements of a that are not in b.
+ */
+template <typename A, typename B>
+detail::enable_if_sets<A, B> set_difference(A &&a, B &&b)
+{
+    return detail::merge<std::decay_t<A>>(std::forward<A>(a), std::forward<B>(b), true, false, false);
+}
+
+} // namespace sets
+
+#endif
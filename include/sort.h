@@ -0,0 +1,30 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include "common.h"
+
+/*
+ * Sorts the given array of n elements in ascending order, using the
+ * given comparison function, and removes duplicates, keeping the
+ * first of each run of equal elements.  Returns the number of
+ * elements left at the front of the array.
+ *
+ * Input that is already sorted is recognized in one pass, so it
+ * costs O(n); anything else is merge sorted in O(n log n).
+ */
+int sort_unique(void **elems, int n, cmpfunc_t cmpfunc);
+
+/*
+ * Removes duplicates from the given sorted array of n elements, in
+ * the same way as sort_unique().  Returns the number of elements left.
+ */
+int dedup_sorted(void **elems, int n, cmpfunc_t cmpfunc);
+
+/*
+ * Returns a newly allocated copy of the given array of *n elements,
+ * sorted and without duplicates as by sort_unique(), and stores the
+ * number of elements in the copy in *n.  The caller frees the copy.
+ */
+void **sorted_copy(void **elems, int *n, cmpfunc_t cmpfunc);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef WORDSCAN_H
+#define WORDSCAN_H
+
+#include <stddef.h>
+
+/*
+ * Words longer than this are split into pieces of this length.
+ */
+#define WORDSCAN_MAX_WORD 100
+
+/*
+ * The smallest number of words wordscan_next can be asked for.
+ */
+#define WORDSCAN_MIN_BATCH 64
+
+/*
+ * The type of word scanners.
+ *
+ * A word scanner finds the words in a buffer, where a word is a run
+ * of letters, digits, apostrophes and underscores, the same words as
+ * tokenize_file finds.  Depending on the CPU, the bytes are classified
+ * 32 at a time with AVX2, 16 at a time with SSE2, or one at a time.
+ */
+struct wordscan;
+typedef struct wordscan wordscan_t;
+
+/*
+ * Creates a scanner over the size bytes at data.  The bytes are not
+ * copied, and must be kept until the scanner is destroyed.
+ */
+wordscan_t *wordscan_create(const char *data, size_t size);
+
+/*
+ * Destroys the given scanner.
+ */
+void wordscan_destroy(wordscan_t *scan);
+
+/*
+ * Finds the next words of the buffer, in order, and stores the offset
+ * of the first byte of each word in starts and the offset just past
+ * its last byte in ends.  Writes at most max words, where max must be
+ * at least WORDSCAN_MIN_BATCH.  Returns the number of words written,
+ * which is 0 only once the whole buffer has been scanned.
+ */
+size_t wordscan_next(wordscan_t *scan, size_t *starts, size_t *ends, size_t max);
+
+/*
+ * Picks the implementation used by scanners created from now on:
+ * "scalar", "sse2" or "avx2".  Returns 1 if it is available on this
+ * CPU, and 0, leaving the choice unchanged, if not.  By default the
+ * fastest available implementation is used.
+ */
+int wordscan_select(const char *name);
+
+/*
+ * Returns the name of the implementation in use.
+ */
+const char *wordscan_impl(void);
+
+#endif
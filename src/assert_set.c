@@ -1,6 +1,16 @@
 /* Author: Magnus Stenhaug <magnus.stenhaug@uit.no> */
 #include "set.h"
+#include "intset.h"
+#include "frozenset.h"
+#include "intern.h"
+#include "list.h"
+#include "wordscan.h"
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
 #include "printing.h"
 
 /* 
@@ -19,6 +29,69 @@
 #define TEST_PRINT_SET 0
 #define TEST_RUNS 1000
 
+/*
+ * Parameters for the integer set test case:
+ * TEST_INTSET_RANGE is the range of the generated values, spanning
+ * several containers
+ * TEST_INTSET_RUNS number of times the test is run
+ */
+
+#define TEST_INTSET_RANGE ( 1 << 18 )
+#define TEST_INTSET_RUNS 20
+
+/*
+ * Parameters for the intern table test case:
+ * TEST_INTERN_WORDS is the number of distinct words, enough to make
+ * the table grow several times
+ * TEST_INTERN_RUNS number of times the test is run
+ */
+
+#define TEST_INTERN_WORDS 20000
+#define TEST_INTERN_RUNS 5
+
+/*
+ * Parameters for the removal test case:
+ * TEST_REMOVE_SIZE is the number of elements to add and then remove,
+ * enough to span many nodes in the tree backends
+ * TEST_REMOVE_RUNS number of times the test is run
+ */
+
+#define TEST_REMOVE_SIZE 2000
+#define TEST_REMOVE_RUNS 20
+
+/*
+ * Parameters for the range and seek test case:
+ * TEST_RANGE_SIZE is the number of elements to add, drawn from twice
+ * as many values so that the gaps get probed too
+ * TEST_RANGE_RUNS number of times the test is run
+ */
+
+#define TEST_RANGE_SIZE 2000
+#define TEST_RANGE_RUNS 20
+
+/*
+ * Parameters for the tokenizer test case:
+ * TEST_TOKENIZE_SIZE is the number of bytes in each generated file,
+ * small enough to fit in a pipe
+ * TEST_TOKENIZE_RUNS number of times the test is run
+ * TEST_WORDSCAN_RUNS number of times the word scanner test is run,
+ * the first 400 on buffers of every size from 0 up
+ */
+
+#define TEST_TOKENIZE_SIZE 16384
+#define TEST_TOKENIZE_RUNS 20
+#define TEST_WORDSCAN_RUNS 420
+
+/*
+ * Parameters for the directory walk test case:
+ * TEST_WALK_DEPTH is the number of nested directories, with names
+ * long enough that the deepest paths are longer than PATH_MAX
+ * TEST_WALK_FILES is the number of files in each directory
+ */
+
+#define TEST_WALK_DEPTH 48
+#define TEST_WALK_FILES 3
+
 int compare_ints(void *a, void *b)
 {
     int *ia = a;
@@ -27,6 +100,11 @@ int compare_ints(void *a, void *b)
     return (*ia)-(*ib);
 }
 
+unsigned long hash_ints(void *a)
+{
+    return (unsigned long)*(int *)a;
+}
+
 static void *newint(int i)
 {
     int *p = malloc(sizeof(int));
@@ -43,7 +121,7 @@ set_t *generate_set(unsigned int seed, int num)
 	set_t *a;
 	int i;
 	
-	a = set_create(compare_ints);
+	a = set_create_hashed(compare_ints, hash_ints);
 	
 	/* Adding random numbers based on the seed value */
 	for(i = 0; i < num; i++)
@@ -293,8 +371,8 @@ void validate_set_operations(unsigned int seed)
 
 	/* Generate test set */
 	testset = generate_set(seed, TEST_SET_SIZE);
-	a = set_create(compare_ints);
-	b = set_create(compare_ints);
+	a = set_create_hashed(compare_ints, hash_ints);
+	b = set_create_hashed(compare_ints, hash_ints);
 	
 	split_set(testset, a, b);
 	
@@ -349,6 +427,1276 @@ void validate_set_operations(unsigned int seed)
 	delete_generated_set(testset);
 }
 
+/*
+ * Validates the in-place set operations against the ones that
+ * create new sets
+ */
+
+int same_set(set_t *a, set_t *b)
+{
+	set_iter_t *iter;
+	int same = set_size(a) == set_size(b);
+	
+	iter = set_createiter(a);
+	while(same && set_hasnext(iter))
+	{
+		if(!set_contains(b, set_next(iter)))
+			same = 0;
+	}
+	set_destroyiter(iter);
+	
+	return same;
+}
+
+void validate_inplace_operations(unsigned int seed)
+{
+	set_t *testset, *a, *b, *res_union, *res_inter;
+	
+	testset = generate_set(seed, TEST_SET_SIZE);
+	a = set_create_hashed(compare_ints, hash_ints);
+	b = set_create_hashed(compare_ints, hash_ints);
+	
+	split_set(testset, a, b);
+	
+	res_union = set_union(a, b);
+	res_inter = set_intersection(a, b);
+	
+	/* a becomes the intersection, and b the union */
+	set_intersect_into(a, b);
+	set_union_into(b, res_inter);
+	set_union_into(b, res_union);
+	
+	if(!check_set_integrity(a) || !same_set(a, res_inter))
+		ERROR_PRINT("In-place intersection is not correct");
+	if(!check_set_integrity(b) || !same_set(b, res_union))
+		ERROR_PRINT("In-place union is not correct");
+	
+	set_destroy(res_inter);
+	set_destroy(res_union);
+	set_destroy(a);
+	set_destroy(b);
+	
+	delete_generated_set(testset);
+}
+
+/*
+ * Validates set_add_all and set_from_sorted_array, by comparing the
+ * sets they build against one built with set_add
+ */
+
+void validate_bulk_load(unsigned int seed)
+{
+	set_t *ref, *a, *b, *c;
+	set_iter_t *iter;
+	void **elems, **sorted, **copy;
+	int i, n = TEST_SET_SIZE, m = 0;
+	
+	elems = malloc(n * sizeof(void *));
+	copy = malloc(n * sizeof(void *));
+	sorted = malloc(2 * n * sizeof(void *));
+	
+	ref = set_create_hashed(compare_ints, hash_ints);
+	for(i = 0; i < n; i++)
+	{
+		elems[i] = copy[i] = newint(rand_r(&seed) % TEST_MODULUS);
+		set_add(ref, elems[i]);
+	}
+	
+	/* Every element twice, to check that duplicates are skipped */
+	iter = set_createiter(ref);
+	while(set_hasnext(iter))
+	{
+		sorted[m] = sorted[m + 1] = set_next(iter);
+		m += 2;
+	}
+	set_destroyiter(iter);
+	
+	/* Into an empty set, and into one that holds the first half */
+	a = set_create_hashed(compare_ints, hash_ints);
+	set_add_all(a, elems, n);
+	b = set_create_hashed(compare_ints, hash_ints);
+	for(i = 0; i < n / 2; i++)
+		set_add(b, elems[i]);
+	set_add_all(b, elems + n / 4, n - n / 4);
+	c = set_from_sorted_array(compare_ints, hash_ints, sorted, m);
+	
+	for(i = 0; i < n; i++)
+	{
+		if(elems[i] != copy[i])
+			ERROR_PRINT("set_add_all changed its input array");
+	}
+	
+	if(!check_set_integrity(a) || !same_set(a, ref))
+		ERROR_PRINT("Invalid bulk load, check set_add_all on an empty set");
+	if(!check_set_integrity(b) || !same_set(b, ref))
+		ERROR_PRINT("Invalid bulk load, check set_add_all on a filled set");
+	if(!check_set_integrity(c) || !same_set(c, ref))
+		ERROR_PRINT("Invalid bulk load, check set_from_sorted_array");
+	
+	set_destroy(ref);
+	set_destroy(a);
+	set_destroy(b);
+	set_destroy(c);
+	
+	for(i = 0; i < n; i++)
+		free(elems[i]);
+	free(elems);
+	free(copy);
+	free(sorted);
+}
+
+/*
+ * Returns the smallest value in [from, TEST_RANGE_MAX) that is present
+ * in the reference array, or TEST_RANGE_MAX if there is none
+ */
+
+#define TEST_RANGE_MAX ( 2 * TEST_RANGE_SIZE )
+
+static int next_present(char *ref, int from)
+{
+	while(from < TEST_RANGE_MAX && !ref[from])
+		from++;
+	return from;
+}
+
+/*
+ * Checks union, in-place union and difference of a large set a and a
+ * small set, where ref marks the values in a
+ */
+
+static void check_small_large(set_t *a, set_t *small, int *values, char *ref)
+{
+	set_t *expect_union, *expect_diff, *expect_rdiff, *result;
+	int i;
+	
+	expect_union = set_create_hashed(compare_ints, hash_ints);
+	expect_diff = set_create_hashed(compare_ints, hash_ints);
+	expect_rdiff = set_create_hashed(compare_ints, hash_ints);
+	for(i = 0; i < TEST_RANGE_MAX; i++)
+	{
+		int in_small = set_contains(small, &values[i]);
+		
+		if(ref[i] || in_small)
+			set_add(expect_union, &values[i]);
+		if(ref[i] && !in_small)
+			set_add(expect_diff, &values[i]);
+		if(in_small && !ref[i])
+			set_add(expect_rdiff, &values[i]);
+	}
+	
+	result = set_union(a, small);
+	if(!check_set_integrity(result) || !same_set(result, expect_union))
+		ERROR_PRINT("Invalid union of a large and a small set");
+	set_destroy(result);
+	
+	result = set_union(small, a);
+	if(!check_set_integrity(result) || !same_set(result, expect_union))
+		ERROR_PRINT("Invalid union of a small and a large set");
+	set_destroy(result);
+	
+	result = set_difference(a, small);
+	if(!check_set_integrity(result) || !same_set(result, expect_diff))
+		ERROR_PRINT("Invalid difference of a large and a small set");
+	set_destroy(result);
+	
+	result = set_difference(small, a);
+	if(!check_set_integrity(result) || !same_set(result, expect_rdiff))
+		ERROR_PRINT("Invalid difference of a small and a large set");
+	set_destroy(result);
+	
+	result = set_copy(a);
+	set_union_into(result, small);
+	if(!check_set_integrity(result) || !same_set(result, expect_union))
+		ERROR_PRINT("Invalid in-place union of a large and a small set");
+	set_destroy(result);
+	
+	set_destroy(expect_union);
+	set_destroy(expect_diff);
+	set_destroy(expect_rdiff);
+}
+
+/*
+ * Validates range iterators and seeking against a reference array,
+ * and the intersection of a small set with a much larger one, which
+ * the tree backends do by seeking
+ */
+
+void validate_range_and_seek(unsigned int seed)
+{
+	set_t *a, *small, *inter;
+	set_iter_t *iter;
+	int *values, *elem;
+	char *ref;
+	int i, j, lo, hi, expect, key;
+	
+	values = malloc(TEST_RANGE_MAX * sizeof(int));
+	ref = calloc(TEST_RANGE_MAX, 1);
+	for(i = 0; i < TEST_RANGE_MAX; i++)
+		values[i] = i;
+	
+	a = set_create_hashed(compare_ints, hash_ints);
+	small = set_create_hashed(compare_ints, hash_ints);
+	for(i = 0; i < TEST_RANGE_SIZE; i++)
+	{
+		j = rand_r(&seed) % TEST_RANGE_MAX;
+		set_add(a, &values[j]);
+		ref[j] = 1;
+	}
+	
+	for(i = 0; i < 100; i++)
+	{
+		/* Value -1 stands for an open end */
+		lo = rand_r(&seed) % (TEST_RANGE_MAX + 1) - 1;
+		hi = rand_r(&seed) % (TEST_RANGE_MAX + 1) - 1;
+		iter = set_createiter_range(a, lo < 0 ? NULL : &values[lo],
+					    hi < 0 ? NULL : &values[hi]);
+		if(hi < 0)
+			hi = TEST_RANGE_MAX;
+		
+		expect = next_present(ref, lo < 0 ? 0 : lo);
+		while(expect < hi)
+		{
+			/* Every now and then, seek ahead instead of stepping */
+			if(rand_r(&seed) % 4 == 0)
+			{
+				key = expect + rand_r(&seed) % 64 - 8;
+				if(key >= 0 && key < TEST_RANGE_MAX)
+				{
+					set_iter_seek(iter, &values[key]);
+					if(key > expect)
+						expect = next_present(ref, key);
+					if(expect >= hi)
+						break;
+				}
+			}
+			
+			elem = set_next(iter);
+			if(!elem || *elem != expect)
+				ERROR_PRINT("Invalid range iterator, check set_createiter_range and set_iter_seek");
+			expect = next_present(ref, expect + 1);
+		}
+		
+		if(set_hasnext(iter) || set_next(iter) != NULL)
+			ERROR_PRINT("Range iterator went past the end of its range");
+		set_destroyiter(iter);
+	}
+	
+	/* Intersect a few values with the large set, both ways around */
+	for(i = 0; i < 20; i++)
+		set_add(small, &values[rand_r(&seed) % TEST_RANGE_MAX]);
+	
+	for(i = 0; i < 2; i++)
+	{
+		inter = i ? set_intersection(a, small) : set_intersection(small, a);
+		if(!check_set_integrity(inter))
+			ERROR_PRINT("Invalid intersection of a small and a large set");
+		
+		iter = set_createiter(small);
+		j = 0;
+		while(set_hasnext(iter))
+		{
+			elem = set_next(iter);
+			if(ref[*elem] != set_contains(inter, elem))
+				ERROR_PRINT("Invalid intersection of a small and a large set");
+			j += ref[*elem];
+		}
+		set_destroyiter(iter);
+		
+		if(set_size(inter) != j)
+			ERROR_PRINT("Invalid intersection of a small and a large set");
+		set_destroy(inter);
+	}
+	
+	/* Union and difference of the two, checked against sets built from scratch */
+	check_small_large(a, small, values, ref);
+	
+	set_destroy(a);
+	set_destroy(small);
+	free(values);
+	free(ref);
+}
+
+/*
+ * Checks set_rank for every value and set_select for every position
+ * of the given set against a reference array
+ */
+
+static int check_rank_select(set_t *set, int *values, char *ref)
+{
+	int i, rank = 0;
+	int *elem;
+	
+	for(i = 0; i < TEST_RANGE_MAX; i++)
+	{
+		if(set_rank(set, &values[i]) != rank)
+			return 0;
+		if(ref[i])
+		{
+			elem = set_select(set, rank);
+			if(!elem || *elem != i)
+				return 0;
+			rank++;
+		}
+	}
+	
+	return rank == set_size(set) && set_select(set, rank) == NULL &&
+	       set_select(set, -1) == NULL;
+}
+
+/*
+ * Validates rank and select, and that they stay right through adding,
+ * removing and copying
+ */
+
+void validate_rank_select(unsigned int seed)
+{
+	set_t *a, *copy;
+	int *values;
+	char *ref;
+	int i, j;
+	
+	values = malloc(TEST_RANGE_MAX * sizeof(int));
+	ref = calloc(TEST_RANGE_MAX, 1);
+	for(i = 0; i < TEST_RANGE_MAX; i++)
+		values[i] = i;
+	
+	a = set_create_hashed(compare_ints, hash_ints);
+	for(i = 0; i < TEST_RANGE_SIZE; i++)
+	{
+		j = rand_r(&seed) % TEST_RANGE_MAX;
+		set_add(a, &values[j]);
+		ref[j] = 1;
+	}
+	if(!check_rank_select(a, values, ref))
+		ERROR_PRINT("Invalid rank or select, check set_rank and set_select");
+	
+	copy = set_copy(a);
+	if(!check_rank_select(copy, values, ref))
+		ERROR_PRINT("Invalid rank or select, check set_copy");
+	
+	/* Remove about half the elements, and add a few back */
+	for(i = 0; i < TEST_RANGE_SIZE; i++)
+	{
+		j = rand_r(&seed) % TEST_RANGE_MAX;
+		if(i % 4 == 0)
+		{
+			set_add(a, &values[j]);
+			ref[j] = 1;
+		}
+		else
+		{
+			set_remove(a, &values[j]);
+			ref[j] = 0;
+		}
+	}
+	if(!check_rank_select(a, values, ref))
+		ERROR_PRINT("Invalid rank or select after set_add and set_remove");
+	
+	set_destroy(a);
+	set_destroy(copy);
+	free(values);
+	free(ref);
+}
+
+/*
+ * Checks the bitmap and count from a batched lookup of elems[0..n)
+ * against set_contains
+ */
+
+static int check_found(set_t *set, void **elems, int n, unsigned char *found, int count)
+{
+	int i, expected = 0;
+	
+	for(i = 0; i < n; i++)
+	{
+		if(((found[i / 8] >> (i % 8)) & 1) != set_contains(set, elems[i]))
+			return 0;
+		expected += set_contains(set, elems[i]);
+	}
+	
+	return count == expected;
+}
+
+/*
+ * Validates batched lookups, with batch sizes that are not a multiple
+ * of any group size and a bitmap that starts out full of ones
+ */
+
+void validate_contains_many(unsigned int seed)
+{
+	set_t *a;
+	void **elems;
+	unsigned char *found;
+	int *values;
+	int i, n, count;
+	
+	values = malloc(TEST_RANGE_MAX * sizeof(int));
+	elems = malloc(TEST_RANGE_MAX * sizeof(void *));
+	found = malloc(TEST_RANGE_MAX / 8 + 1);
+	for(i = 0; i < TEST_RANGE_MAX; i++)
+		values[i] = i;
+	
+	a = set_create_hashed(compare_ints, hash_ints);
+	n = seed % 3 == 0 ? 0 : TEST_RANGE_SIZE;
+	for(i = 0; i < n; i++)
+		set_add(a, &values[rand_r(&seed) % TEST_RANGE_MAX]);
+	
+	n = TEST_RANGE_MAX - seed % 17;
+	for(i = 0; i < n; i++)
+		elems[i] = &values[rand_r(&seed) % TEST_RANGE_MAX];
+	
+	memset(found, 0xff, TEST_RANGE_MAX / 8 + 1);
+	count = set_contains_many(a, elems, n, found);
+	if(!check_found(a, elems, n, found, count))
+		ERROR_PRINT("Invalid batched lookup, check set_contains_many");
+	
+	if(set_contains_many(a, elems, 0, found) != 0)
+		ERROR_PRINT("Empty batch found elements, check set_contains_many");
+	
+	set_destroy(a);
+	free(values);
+	free(elems);
+	free(found);
+}
+
+/*
+ * Validates that a frozen set holds the same elements as the set it
+ * was made from, both for lookups and for iteration
+ */
+
+void validate_freeze(unsigned int seed)
+{
+	set_t *a;
+	frozenset_t *frozen;
+	frozenset_iter_t *fit;
+	set_iter_t *it;
+	void **elems;
+	unsigned char *found;
+	int *values;
+	int i, size;
+	
+	values = malloc(TEST_RANGE_MAX * sizeof(int));
+	for(i = 0; i < TEST_RANGE_MAX; i++)
+		values[i] = i;
+	
+	/* Vary the size, so every shape of the last level is covered */
+	size = seed % TEST_SET_SIZE + (seed % 2) * TEST_RANGE_SIZE;
+	a = set_create_hashed(compare_ints, hash_ints);
+	for(i = 0; i < size; i++)
+		set_add(a, &values[rand_r(&seed) % TEST_RANGE_MAX]);
+	
+	frozen = set_freeze(a, compare_ints);
+	if(frozenset_size(frozen) != set_size(a))
+		ERROR_PRINT("Invalid size, check set_freeze");
+	
+	for(i = 0; i < TEST_RANGE_MAX; i++)
+	{
+		if(frozenset_contains(frozen, &values[i]) != set_contains(a, &values[i]))
+			ERROR_PRINT("Invalid lookup, check frozenset_contains");
+	}
+	
+	elems = malloc(TEST_RANGE_MAX * sizeof(void *));
+	found = malloc(TEST_RANGE_MAX / 8 + 1);
+	memset(found, 0xff, TEST_RANGE_MAX / 8 + 1);
+	for(i = 0; i < TEST_RANGE_MAX - 5; i++)
+		elems[i] = &values[rand_r(&seed) % TEST_RANGE_MAX];
+	i = frozenset_contains_many(frozen, elems, TEST_RANGE_MAX - 5, found);
+	if(!check_found(a, elems, TEST_RANGE_MAX - 5, found, i))
+		ERROR_PRINT("Invalid batched lookup, check frozenset_contains_many");
+	free(elems);
+	free(found);
+	
+	it = set_createiter(a);
+	fit = frozenset_createiter(frozen);
+	while(set_hasnext(it))
+	{
+		if(!frozenset_hasnext(fit) || frozenset_next(fit) != set_next(it))
+			ERROR_PRINT("Invalid iteration order, check frozenset_next");
+	}
+	if(frozenset_hasnext(fit))
+		ERROR_PRINT("Iterator continues past the end, check frozenset_hasnext");
+	set_destroyiter(it);
+	frozenset_destroyiter(fit);
+	
+	frozenset_destroy(frozen);
+	set_destroy(a);
+	free(values);
+}
+
+/*
+ * Validates that copies are independent: changing a set after copying
+ * it must not change the copy, nor the other way around
+ */
+
+void validate_copy_independence(unsigned int seed)
+{
+	set_t *sets[3];
+	char *refs[3];
+	int *values;
+	int i, j, k, which;
+	
+	values = malloc(TEST_RANGE_MAX * sizeof(int));
+	for(i = 0; i < TEST_RANGE_MAX; i++)
+		values[i] = i;
+	for(k = 0; k < 3; k++)
+		refs[k] = calloc(TEST_RANGE_MAX, 1);
+	
+	sets[0] = set_create_hashed(compare_ints, hash_ints);
+	for(i = 0; i < TEST_RANGE_SIZE; i++)
+	{
+		j = rand_r(&seed) % TEST_RANGE_MAX;
+		set_add(sets[0], &values[j]);
+		refs[0][j] = 1;
+	}
+	
+	/* A copy, and a copy of the copy */
+	for(k = 1; k < 3; k++)
+	{
+		sets[k] = set_copy(sets[k - 1]);
+		memcpy(refs[k], refs[k - 1], TEST_RANGE_MAX);
+	}
+	
+	for(i = 0; i < TEST_RANGE_SIZE; i++)
+	{
+		which = rand_r(&seed) % 3;
+		j = rand_r(&seed) % TEST_RANGE_MAX;
+		if(rand_r(&seed) % 2)
+		{
+			set_add(sets[which], &values[j]);
+			refs[which][j] = 1;
+		}
+		else
+		{
+			set_remove(sets[which], &values[j]);
+			refs[which][j] = 0;
+		}
+	}
+	
+	for(k = 0; k < 3; k++)
+	{
+		if(!check_set_integrity(sets[k]) || !check_rank_select(sets[k], values, refs[k]))
+			ERROR_PRINT("Changing a set changed a copy of it, check set_copy");
+	}
+	
+	/* Destroy the original first, the copies must survive it */
+	set_destroy(sets[0]);
+	if(!check_rank_select(sets[2], values, refs[2]))
+		ERROR_PRINT("Destroying a set changed a copy of it, check set_copy");
+	set_destroy(sets[2]);
+	if(!check_rank_select(sets[1], values, refs[1]))
+		ERROR_PRINT("Destroying a set changed a copy of it, check set_copy");
+	set_destroy(sets[1]);
+	
+	for(k = 0; k < 3; k++)
+		free(refs[k]);
+	free(values);
+}
+
+/*
+ * Validates removal, by removing the elements of a set one by one
+ * in random order
+ */
+
+void validate_removal(unsigned int seed)
+{
+	set_t *a;
+	set_iter_t *iter;
+	void **elems;
+	int i, j, n, missing;
+	
+	a = set_create_hashed(compare_ints, hash_ints);
+	for(i = 0; i < TEST_REMOVE_SIZE; i++)
+	{
+		set_add(a, newint(rand_r(&seed) % (4 * TEST_REMOVE_SIZE)));
+	}
+	
+	/* Keep the stored elements, so they can be freed afterwards */
+	n = set_size(a);
+	elems = malloc(n * sizeof(void *));
+	iter = set_createiter(a);
+	for(i = 0; i < n; i++)
+		elems[i] = set_next(iter);
+	set_destroyiter(iter);
+	
+	/* Shuffle the removal order */
+	for(i = n - 1; i > 0; i--)
+	{
+		void *tmp;
+		
+		j = rand_r(&seed) % (i + 1);
+		tmp = elems[i];
+		elems[i] = elems[j];
+		elems[j] = tmp;
+	}
+	
+	missing = -1;
+	if(set_remove(a, &missing))
+		ERROR_PRINT("Invalid removal, check set_remove on missing elements");
+	
+	for(i = 0; i < n; i++)
+	{
+		if(!set_remove(a, elems[i]) || set_contains(a, elems[i]))
+			ERROR_PRINT("Invalid removal, check set_remove");
+		if(set_remove(a, elems[i]))
+			ERROR_PRINT("Invalid removal, removed an element twice");
+	
+		/* Every now and then, check the rest of the set */
+		if(i % 97 == 0)
+		{
+			if(!check_set_integrity(a) || set_size(a) != n - i - 1)
+				ERROR_PRINT("Set is invalid after set_remove");
+			for(j = i + 1; j < n; j++)
+			{
+				if(!set_contains(a, elems[j]))
+					ERROR_PRINT("Invalid removal, removed the wrong element");
+			}
+		}
+	
+		/* Put some elements back in, to mix adding and removing */
+		if(i % 5 == 0)
+		{
+			set_add(a, elems[i]);
+			if(!set_remove(a, elems[i]))
+				ERROR_PRINT("Invalid removal, check set_add after set_remove");
+		}
+	}
+	
+	if(set_size(a) != 0 || !check_set_integrity(a))
+		ERROR_PRINT("Set is not empty after removing every element");
+	
+	for(i = 0; i < n; i++)
+		free(elems[i]);
+	free(elems);
+	set_destroy(a);
+}
+
+/*
+ * Generates an integer set from a seed value, and marks its values
+ * in the reference array ref.  The density varies with the seed, so
+ * that some containers become arrays and others bitmaps.
+ */
+
+intset_t *generate_intset(unsigned int seed, char *ref)
+{
+	intset_t *a;
+	int i, num, val;
+	
+	a = intset_create();
+	num = TEST_INTSET_RANGE / (1 + seed % 8);
+	
+	for(i = 0; i < num; i++)
+	{
+		val = rand_r(&seed) % TEST_INTSET_RANGE;
+		intset_add(a, val);
+		ref[val] = 1;
+	}
+	
+	/* Add a long stretch of consecutive values, suitable for runs */
+	for(i = 0; i < 10000; i++)
+	{
+		intset_add(a, 70000 + i);
+		ref[70000 + i] = 1;
+	}
+	
+	return a;
+}
+
+/*
+ * Checks that an integer set holds exactly the values marked in ref
+ */
+
+int check_intset(intset_t *a, char *ref)
+{
+	intset_iter_t *iter;
+	int i, size, prev, curr;
+	
+	size = 0;
+	for(i = 0; i < TEST_INTSET_RANGE; i++)
+	{
+		if(intset_contains(a, i) != ref[i])
+			return 0;
+		size += ref[i];
+	}
+	
+	if(intset_size(a) != size)
+		return 0;
+	
+	iter = intset_createiter(a);
+	prev = -1;
+	while(intset_hasnext(iter))
+	{
+		curr = intset_next(iter);
+		if(curr <= prev || !ref[curr])
+		{
+			intset_destroyiter(iter);
+			return 0;
+		}
+		prev = curr;
+		size--;
+	}
+	intset_destroyiter(iter);
+	
+	return size == 0;
+}
+
+/*
+ * Validates the integer sets, and their conversion from sets
+ */
+
+void validate_intset(unsigned int seed)
+{
+	set_t *set;
+	intset_t *a, *b, *res;
+	char *ref_a, *ref_b, *ref;
+	int i, pass;
+	
+	/* Conversion from a set */
+	set = generate_set(seed, TEST_SET_SIZE);
+	a = intset_from_set(set);
+	if(intset_size(a) != set_size(set))
+		ERROR_PRINT("Invalid conversion, check intset_from_set");
+	for(i = 0; i < TEST_MODULUS; i++)
+	{
+		if(intset_contains(a, i) != set_contains(set, &i))
+			ERROR_PRINT("Invalid conversion, check intset_from_set");
+	}
+	intset_destroy(a);
+	delete_generated_set(set);
+	
+	ref_a = calloc(TEST_INTSET_RANGE, 1);
+	ref_b = calloc(TEST_INTSET_RANGE, 1);
+	ref = malloc(TEST_INTSET_RANGE);
+	
+	a = generate_intset(seed, ref_a);
+	b = generate_intset(seed * 7 + 1, ref_b);
+	
+	/* Run every operation before and after converting to runs */
+	for(pass = 0; pass < 2; pass++)
+	{
+		if(!check_intset(a, ref_a) || !check_intset(b, ref_b))
+			ERROR_PRINT("Invalid integer set, check intset_add and intset_optimize");
+		
+		res = intset_union(a, b);
+		for(i = 0; i < TEST_INTSET_RANGE; i++)
+			ref[i] = ref_a[i] | ref_b[i];
+		if(!check_intset(res, ref))
+			ERROR_PRINT("Integer set union is not correct");
+		intset_destroy(res);
+		
+		res = intset_intersection(a, b);
+		for(i = 0; i < TEST_INTSET_RANGE; i++)
+			ref[i] = ref_a[i] & ref_b[i];
+		if(!check_intset(res, ref))
+			ERROR_PRINT("Integer set intersection is not correct");
+		intset_destroy(res);
+		
+		res = intset_difference(a, b);
+		for(i = 0; i < TEST_INTSET_RANGE; i++)
+			ref[i] = ref_a[i] & !ref_b[i];
+		if(!check_intset(res, ref))
+			ERROR_PRINT("Integer set difference is not correct");
+		intset_destroy(res);
+		
+		res = intset_copy(a);
+		if(!check_intset(res, ref_a))
+			ERROR_PRINT("Invalid copy, check intset_copy");
+		intset_destroy(res);
+		
+		intset_optimize(a);
+		intset_optimize(b);
+	}
+	
+	/* Adding to run containers turns them back into arrays or bitmaps */
+	for(i = 0; i < TEST_INTSET_RANGE; i += 3)
+	{
+		intset_add(a, i);
+		ref_a[i] = 1;
+	}
+	if(!check_intset(a, ref_a))
+		ERROR_PRINT("Invalid integer set, check intset_add on runs");
+	
+	intset_destroy(a);
+	intset_destroy(b);
+	free(ref_a);
+	free(ref_b);
+	free(ref);
+}
+
+/*
+ * Writes the word for number i into buf, with the case of each
+ * letter picked at random
+ */
+
+static void make_word(char *buf, int i, unsigned int *seed)
+{
+	char *p;
+	
+	sprintf(buf, "word%d'x_y", i);
+	for(p = buf; *p; p++)
+	{
+		if(rand_r(seed) % 2)
+			*p = toupper((unsigned char)*p);
+	}
+}
+
+/*
+ * Validates that the intern table gives every word one dense ID,
+ * whatever its case, and gives the word back from the ID
+ */
+
+void validate_intern(unsigned int seed)
+{
+	intern_t *table;
+	char buf[64], lower[64], *longword;
+	int i, j;
+	
+	table = intern_create();
+	if(intern_lookup(table, 0) != NULL || intern_lookup(table, 1) != NULL)
+		ERROR_PRINT("Lookup in an empty table, check intern_lookup");
+	
+	/* New words get the IDs 1, 2, 3... in order */
+	for(i = 0; i < TEST_INTERN_WORDS; i++)
+	{
+		make_word(buf, i, &seed);
+		if(intern_word(table, buf) != (uint32_t)i + 1)
+			ERROR_PRINT("New word got the wrong ID, check intern_word");
+	}
+	if(intern_count(table) != TEST_INTERN_WORDS)
+		ERROR_PRINT("Invalid count, check intern_count");
+	
+	/* Seen words, in any case, keep their ID */
+	for(i = 0; i < TEST_INTERN_WORDS; i++)
+	{
+		j = rand_r(&seed) % TEST_INTERN_WORDS;
+		make_word(buf, j, &seed);
+		if(intern_word(table, buf) != (uint32_t)j + 1)
+			ERROR_PRINT("Seen word got a new ID, check intern_word");
+		
+		sprintf(lower, "word%d'x_y", j);
+		if(strcmp(intern_lookup(table, j + 1), lower) != 0)
+			ERROR_PRINT("Lookup is not the folded word, check intern_lookup");
+	}
+	if(intern_count(table) != TEST_INTERN_WORDS ||
+	   intern_lookup(table, TEST_INTERN_WORDS + 1) != NULL)
+		ERROR_PRINT("Seen words were counted again, check intern_word");
+	
+	/* A prefix of a word is a different word */
+	if(intern_word(table, "word1") == intern_word(table, "word1'x_y"))
+		ERROR_PRINT("Prefix got the same ID, check intern_word");
+	
+	/* Words longer than a block of storage */
+	longword = malloc(100001);
+	memset(longword, 'A', 100000);
+	longword[100000] = 0;
+	i = intern_word(table, longword);
+	longword[0] = 'a';
+	if(intern_word(table, longword) != (uint32_t)i ||
+	   strlen(intern_lookup(table, i)) != 100000)
+		ERROR_PRINT("Invalid long word, check intern_word");
+	free(longword);
+	
+	intern_destroy(table);
+}
+
+/*
+ * The tokenizer tokenize_file used to be, kept as the reference the
+ * current one must agree with
+ */
+
+static void reference_tokenize(FILE *file, list_t *list)
+{
+	char buf[101];
+	
+	while(!feof(file))
+	{
+		if(fscanf(file, "%*[^a-zA-Z0-9'_]") < 0)
+			break;
+		if(fscanf(file, "%100[a-zA-Z0-9'_]", buf) == 1)
+			list_addlast(list, strdup(buf));
+	}
+}
+
+/*
+ * Checks that two lists of words are equal, and empties them
+ */
+
+static int same_words(list_t *got, list_t *want)
+{
+	char *a, *b;
+	int same = list_size(got) == list_size(want);
+	
+	while(list_size(want) > 0)
+	{
+		a = list_size(got) > 0 ? list_popfirst(got) : NULL;
+		b = list_popfirst(want);
+		if(a == NULL || strcmp(a, b) != 0)
+			same = 0;
+		free(a);
+		free(b);
+	}
+	while(list_size(got) > 0)
+	{
+		free(list_popfirst(got));
+		same = 0;
+	}
+	return same;
+}
+
+/*
+ * Fills data with size random bytes, mostly word characters and
+ * separators, with long runs that must be split at 100 characters,
+ * and some bytes of any value
+ */
+
+static void make_text(char *data, int size, unsigned int *seed)
+{
+	static const char alphabet[] = "aZ9'_ .,!-\n";
+	int i, j, run;
+	
+	for(i = 0; i < size; i += run)
+	{
+		run = 1 + rand_r(seed) % (rand_r(seed) % 8 == 0 ? 250 : 12);
+		for(j = i; j < i + run && j < size; j++)
+		{
+			if(rand_r(seed) % 16 == 0)
+				data[j] = (char)(rand_r(seed) % 256);
+			else if(run > 12)
+				data[j] = alphabet[rand_r(seed) % 5];
+			else
+				data[j] = alphabet[rand_r(seed) % (sizeof(alphabet) - 1)];
+		}
+	}
+}
+
+/*
+ * Returns a pipe that holds the given bytes, to be read as a FILE
+ */
+
+static FILE *pipe_of(char *data, int size)
+{
+	int fds[2];
+	
+	if(pipe(fds) != 0 || write(fds[1], data, size) != size)
+		ERROR_PRINT("Could not fill a pipe for the tokenizer test");
+	close(fds[1]);
+	return fdopen(fds[0], "r");
+}
+
+/*
+ * Copies the words of a tokenized file into a list, checking on the
+ * way that compare_spans and hash_spans agree with strcmp
+ */
+
+static void copy_spans(tokens_t *tokens, list_t *list)
+{
+	span_t *span, *prev = NULL;
+	char *word, *prevword = NULL;
+	int i, cmp;
+	
+	for(i = 0; i < tokens_size(tokens); i++)
+	{
+		span = tokens_get(tokens, i);
+		word = strndup(span->data, span->len);
+		if(prev != NULL)
+		{
+			cmp = strcmp(prevword, word);
+			if((compare_spans(prev, span) > 0) != (cmp > 0) ||
+			   (compare_spans(prev, span) < 0) != (cmp < 0))
+				ERROR_PRINT("Spans compare unlike strings, check compare_spans");
+			if(cmp == 0 && hash_spans(prev) != hash_spans(span))
+				ERROR_PRINT("Equal spans hash differently, check hash_spans");
+		}
+		list_addlast(list, word);
+		prev = span;
+		prevword = word;
+	}
+}
+
+/*
+ * Tokenizes file with the fscanf tokenizer (0), tokenize_file (1) or
+ * tokenize_file_spans (2), adding the words to list
+ */
+
+static void tokenize_with(int tokenizer, FILE *file, list_t *list)
+{
+	tokens_t *tokens;
+	
+	if(tokenizer == 0)
+		reference_tokenize(file, list);
+	else if(tokenizer == 1)
+		tokenize_file(file, list);
+	else
+	{
+		tokens = tokenize_file_spans(file);
+		copy_spans(tokens, list);
+		tokens_destroy(tokens);
+	}
+}
+
+/*
+ * Validates that tokenize_file_into_set adds the words in want to a
+ * set of strings, copying each one once, and empties want
+ */
+
+static void validate_into_set(FILE *file, list_t *want)
+{
+	set_t *got = set_create(compare_strings);
+	set_t *distinct = set_create(compare_strings);
+	set_iter_t *it;
+	char *word, **words;
+	int i, n;
+	
+	tokenize_file_into_set(file, got, NULL, NULL);
+	while(list_size(want) > 0)
+	{
+		word = list_popfirst(want);
+		if(!set_contains(got, word))
+			ERROR_PRINT("Word missing from set, check tokenize_file_into_set");
+		if(set_contains(distinct, word))
+			free(word);
+		else
+			set_add(distinct, word);
+	}
+	if(set_size(got) != set_size(distinct))
+		ERROR_PRINT("Invalid set size, check tokenize_file_into_set");
+	
+	/* Free the words of both sets once the sets are gone */
+	n = set_size(got) + set_size(distinct);
+	words = malloc(n * sizeof(char *));
+	i = 0;
+	it = set_createiter(got);
+	while(set_hasnext(it))
+		words[i++] = set_next(it);
+	set_destroyiter(it);
+	it = set_createiter(distinct);
+	while(set_hasnext(it))
+		words[i++] = set_next(it);
+	set_destroyiter(it);
+	set_destroy(got);
+	set_destroy(distinct);
+	for(i = 0; i < n; i++)
+		free(words[i]);
+	free(words);
+}
+
+/*
+ * Validates that tokenize_file and tokenize_file_spans find the same
+ * words as the fscanf tokenizer, both in a regular file, which is
+ * mapped, and in a pipe, which is read, and that tokenize_file_into_set
+ * finds the same distinct words
+ */
+
+void validate_tokenize(unsigned int seed)
+{
+	char *data;
+	list_t *got, *want;
+	FILE *file;
+	int i;
+	
+	data = malloc(TEST_TOKENIZE_SIZE);
+	make_text(data, TEST_TOKENIZE_SIZE, &seed);
+	
+	got = list_create(compare_strings);
+	want = list_create(compare_strings);
+	
+	for(i = 1; i <= 2; i++)
+	{
+		/* A regular file, starting part way in */
+		file = tmpfile();
+		fwrite(data, 1, TEST_TOKENIZE_SIZE, file);
+		fseek(file, seed % 100, SEEK_SET);
+		tokenize_with(0, file, want);
+		fseek(file, seed % 100, SEEK_SET);
+		tokenize_with(i, file, got);
+		fclose(file);
+		if(!same_words(got, want))
+			ERROR_PRINT("Invalid words in a file, check tokenizer %d", i);
+		
+		/* A pipe, with a fresh one for each tokenizer */
+		tokenize_with(0, file = pipe_of(data, TEST_TOKENIZE_SIZE), want);
+		fclose(file);
+		tokenize_with(i, file = pipe_of(data, TEST_TOKENIZE_SIZE), got);
+		fclose(file);
+		if(!same_words(got, want))
+			ERROR_PRINT("Invalid words in a pipe, check tokenizer %d", i);
+	}
+	
+	/* Into a set, which must get each distinct word once */
+	file = tmpfile();
+	fwrite(data, 1, TEST_TOKENIZE_SIZE, file);
+	rewind(file);
+	tokenize_with(0, file, want);
+	rewind(file);
+	validate_into_set(file, want);
+	fclose(file);
+	
+	list_destroy(got);
+	list_destroy(want);
+	free(data);
+}
+
+/*
+ * Scans data with the current word scanner, taking batches of random
+ * sizes. Returns the number of words, and their bounds in starts and ends
+ */
+
+static size_t scan_words(char *data, size_t size, size_t *starts, size_t *ends, unsigned int *seed)
+{
+	wordscan_t *scan = wordscan_create(data, size);
+	size_t n = 0, got;
+	
+	do
+	{
+		got = wordscan_next(scan, starts + n, ends + n, WORDSCAN_MIN_BATCH + rand_r(seed) % 200);
+		n += got;
+	} while(got > 0);
+	wordscan_destroy(scan);
+	return n;
+}
+
+/*
+ * Validates that every word scanner the CPU supports finds the same
+ * words as the scalar one, in buffers of all sizes around the 64 byte
+ * blocks the vector scanners work on
+ */
+
+void validate_wordscan(unsigned int seed)
+{
+	static const char *names[] = { "scalar", "sse2", "avx2" };
+	const char *fastest = wordscan_impl();
+	size_t size, i, n, want, *starts, *ends, *wantstarts, *wantends;
+	char *data;
+	int k;
+	
+	/* Every size up to a few blocks, and a run of long buffers */
+	size = seed < 400 ? seed : TEST_TOKENIZE_SIZE + seed % 64;
+	data = malloc(size + 1);
+	starts = malloc((size + 1) * sizeof(size_t));
+	ends = malloc((size + 1) * sizeof(size_t));
+	wantstarts = malloc((size + 1) * sizeof(size_t));
+	wantends = malloc((size + 1) * sizeof(size_t));
+	make_text(data, size, &seed);
+	
+	wordscan_select("scalar");
+	want = scan_words(data, size, wantstarts, wantends, &seed);
+	
+	for(k = 0; k < 3; k++)
+	{
+		if(!wordscan_select(names[k]))
+			continue;
+		n = scan_words(data, size, starts, ends, &seed);
+		if(n != want)
+			ERROR_PRINT("Wrong number of words, check wordscan_next");
+		for(i = 0; i < n; i++)
+		{
+			if(starts[i] != wantstarts[i] || ends[i] != wantends[i])
+				ERROR_PRINT("Wrong word bounds, check wordscan_next");
+		}
+	}
+	wordscan_select(fastest);
+	
+	free(data);
+	free(starts);
+	free(ends);
+	free(wantstarts);
+	free(wantends);
+}
+
+/*
+ * Counts the paths found by walk_files, and checks that each one
+ * starts with the root and names one of the test files
+ */
+
+typedef struct walk_state
+{
+	char *root;
+	int count;
+	size_t longest;
+} walk_state_t;
+
+static void count_path(char *path, void *arg)
+{
+	walk_state_t *state = arg;
+	char *name = strrchr(path, '/');
+	
+	if(strncmp(path, state->root, strlen(state->root)) != 0 || name == NULL ||
+	   (strncmp(name, "/file", 5) != 0 && strcmp(name, "/loop") != 0))
+		ERROR_PRINT("Invalid path %s, check walk_files", path);
+	state->count++;
+	if(strlen(path) > state->longest)
+		state->longest = strlen(path);
+}
+
+/*
+ * Validates that walk_files finds every file in a tree deeper than
+ * PATH_MAX, reports a symbolic link to a directory as a file instead
+ * of following it, and reports a root that is a file by itself
+ */
+
+void validate_walk()
+{
+	char root[] = "/tmp/assert_walkXXXXXX", name[128], *command;
+	walk_state_t state = { root, 0, 0 };
+	int i, j, dirfd, fd;
+	
+	if(mkdtemp(root) == NULL)
+		ERROR_PRINT("Could not create a directory for the walk test");
+	
+	/* Create the tree one directory at a time, relative to the last */
+	dirfd = open(root, O_RDONLY | O_DIRECTORY);
+	memset(name, 'd', 100);
+	name[100] = 0;
+	for(i = 0; i <= TEST_WALK_DEPTH; i++)
+	{
+		for(j = 0; j < TEST_WALK_FILES; j++)
+		{
+			sprintf(name + 100, "file%d", j);
+			fd = openat(dirfd, name + 100, O_WRONLY | O_CREAT, 0600);
+			if(fd < 0)
+				ERROR_PRINT("Could not create a file for the walk test");
+			close(fd);
+		}
+		name[100] = 0;
+		if(i == TEST_WALK_DEPTH)
+			break;
+		if(mkdirat(dirfd, name, 0700) != 0 || (fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY)) < 0)
+			ERROR_PRINT("Could not create a directory for the walk test");
+		close(dirfd);
+		dirfd = fd;
+	}
+	close(dirfd);
+	
+	/* A link back to the root, which must not be followed */
+	command = malloc(strlen(root) + 16);
+	sprintf(command, "%s/loop", root);
+	if(symlink(root, command) != 0)
+		ERROR_PRINT("Could not create a link for the walk test");
+	
+	if(walk_files(root, count_path, &state) != state.count ||
+	   state.count != (TEST_WALK_DEPTH + 1) * TEST_WALK_FILES + 1)
+		ERROR_PRINT("Wrong number of files, check walk_files");
+	if(state.longest <= PATH_MAX)
+		ERROR_PRINT("Deepest files not found, check walk_files");
+	
+	/* A root that is a file */
+	sprintf(command, "%s/file0", root);
+	state.count = 0;
+	state.root = command;
+	if(walk_files(command, count_path, &state) != 1 || state.count != 1)
+		ERROR_PRINT("Root file not found, check walk_files");
+	
+	/* A root that is a link to a directory, which must not be followed */
+	sprintf(command, "%s/loop", root);
+	state.count = 0;
+	if(walk_files(command, count_path, &state) != 1 || state.count != 1)
+		ERROR_PRINT("Root link followed, check walk_files");
+	
+	sprintf(command, "rm -rf %s", root);
+	if(system(command) != 0)
+		ERROR_PRINT("Could not remove the walk test directory");
+	free(command);
+}
+
 int main(int argc, char **argv)
 {
 	int i;
@@ -376,6 +1724,70 @@ int main(int argc, char **argv)
 	for(i = 0; i < TEST_RUNS; i++)
 		validate_set_operations(i);
 	
+	/* Validating in-place set operations */
+	DEBUG_PRINT("Validating in-place set operations...\n");
+	for(i = 0; i < TEST_RUNS; i++)
+		validate_inplace_operations(i);
+	
+	/* Validating bulk loading */
+	DEBUG_PRINT("Validating bulk loading...\n");
+	for(i = 0; i < TEST_RUNS; i++)
+		validate_bulk_load(i);
+	
+	/* Validating range iterators and seeking */
+	DEBUG_PRINT("Validating range iterators and seeking...\n");
+	for(i = 0; i < TEST_RANGE_RUNS; i++)
+		validate_range_and_seek(i);
+	
+	/* Validating rank and select */
+	DEBUG_PRINT("Validating rank and select...\n");
+	for(i = 0; i < TEST_RANGE_RUNS; i++)
+		validate_rank_select(i);
+	
+	/* Validating batched lookups */
+	DEBUG_PRINT("Validating batched lookups...\n");
+	for(i = 0; i < TEST_RANGE_RUNS; i++)
+		validate_contains_many(i);
+	
+	/* Validating frozen sets */
+	DEBUG_PRINT("Validating frozen sets...\n");
+	for(i = 0; i < TEST_RUNS; i++)
+		validate_freeze(i);
+	
+	/* Validating that copies are independent */
+	DEBUG_PRINT("Validating copy independence...\n");
+	for(i = 0; i < TEST_RANGE_RUNS; i++)
+		validate_copy_independence(i);
+	
+	/* Validating removal */
+	DEBUG_PRINT("Validating set removal...\n");
+	for(i = 0; i < TEST_REMOVE_RUNS; i++)
+		validate_removal(i);
+	
+	/* Validating intern tables */
+	DEBUG_PRINT("Validating intern tables...\n");
+	for(i = 0; i < TEST_INTERN_RUNS; i++)
+		validate_intern(i);
+	
+	/* Validating the tokenizer */
+	DEBUG_PRINT("Validating the tokenizer...\n");
+	for(i = 0; i < TEST_TOKENIZE_RUNS; i++)
+		validate_tokenize(i);
+	
+	/* Validating the word scanners */
+	DEBUG_PRINT("Validating the word scanners (%s)...\n", wordscan_impl());
+	for(i = 0; i < TEST_WORDSCAN_RUNS; i++)
+		validate_wordscan(i);
+	
+	/* Validating the directory walk */
+	DEBUG_PRINT("Validating the directory walk...\n");
+	validate_walk();
+	
+	/* Validating integer sets */
+	DEBUG_PRINT("Validating integer sets...\n");
+	for(i = 0; i < TEST_INTSET_RUNS; i++)
+		validate_intset(i);
+	
 	return 0;
 }
 
@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <time.h>
 #include "set.h"
+#include "intset.h"
+#include "frozenset.h"
+#include "wordscan.h"
 #include "printing.h"
 
 static int compare_ints(void *a, void *b)
@@ -12,6 +15,11 @@ static int compare_ints(void *a, void *b)
     return (*ia)-(*ib);
 }
 
+static unsigned long hash_ints(void *a)
+{
+    return (unsigned long)*(int *)a;
+}
+
 static void *newint(int i)
 {
     int *p = malloc(sizeof(int));
@@ -25,43 +33,409 @@ static double timesince(clock_t start)
     return (double) (clock() - start) / CLOCKS_PER_SEC;
 }
 
+/*
+ * Times set_createiter right after an element has been added, and
+ * again on the same, unchanged set.  Backends that sort lazily only
+ * pay for sorting in the first column.
+ */
+static void benchmark_iter(int n, int **nums)
+{
+    set_t *set = set_create_hashed(compare_ints, hash_ints);
+    set_iter_t *iter;
+    clock_t start;
+    int i;
+
+    printf("n,createiter,createiter_unchanged\n");
+
+    for (i = 0; i < n; i++) {
+	set_add(set, nums[rand() % n]);
+
+	start = clock();
+	iter = set_createiter(set);
+	printf("%d,%lf,", i, timesince(start));
+	set_destroyiter(iter);
+
+	start = clock();
+	iter = set_createiter(set);
+	printf("%lf\n", timesince(start));
+	set_destroyiter(iter);
+    }
+
+    set_destroy(set);
+}
+
+/*
+ * Times adding n elements in random order to an empty set, and then
+ * looking up n random elements.  Meant for large n, to see how well
+ * each backend copes once the set no longer fits in cache.
+ */
+static void benchmark_lookup(int n, int **nums)
+{
+    set_t *set = set_create_hashed(compare_ints, hash_ints);
+    clock_t start;
+    double add;
+    int i, found = 0;
+
+    printf("n,add,contains\n");
+
+    start = clock();
+    for (i = 0; i < n; i++) {
+	set_add(set, nums[i]);
+    }
+    add = timesince(start);
+
+    start = clock();
+    for (i = 0; i < n; i++) {
+	found += set_contains(set, nums[rand() % n]);
+    }
+    printf("%d,%lf,%lf\n", n, add, timesince(start));
+
+    DEBUG_PRINT("benchmark_lookup: found %d of %d\n", found, n);
+    set_destroy(set);
+}
+
+/*
+ * Times n random lookups in a set of n elements, first with
+ * set_contains on the set itself and then with frozenset_contains on
+ * a frozen copy of it.  Freezing is done before the clock starts.
+ */
+static void benchmark_frozen(int n, int **nums)
+{
+    set_t *set = set_create_hashed(compare_ints, hash_ints);
+    frozenset_t *frozen;
+    clock_t start;
+    int i, found = 0, frozenfound = 0;
+    int *probes = malloc(sizeof(int) * n);
+
+    printf("n,contains,frozen_contains\n");
+
+    for (i = 0; i < n; i++) {
+	set_add(set, nums[i]);
+	probes[i] = rand() % n;
+    }
+    frozen = set_freeze(set, compare_ints);
+
+    start = clock();
+    for (i = 0; i < n; i++) {
+	found += set_contains(set, nums[probes[i]]);
+    }
+    printf("%d,%lf,", n, timesince(start));
+
+    start = clock();
+    for (i = 0; i < n; i++) {
+	frozenfound += frozenset_contains(frozen, nums[probes[i]]);
+    }
+    printf("%lf\n", timesince(start));
+
+    if (found != frozenfound)
+	ERROR_PRINT("benchmark_frozen: found %d, but %d when frozen\n", found, frozenfound);
+
+    free(probes);
+    frozenset_destroy(frozen);
+    set_destroy(set);
+}
+
+/*
+ * Looks up n random elements, half of them in the set, one at a time
+ * with set_contains and in batches of 1024 with set_contains_many,
+ * and the same for a frozen copy of the set.  Prints the number of
+ * probes per second for each.
+ */
+static void benchmark_many(int n, int **nums)
+{
+    set_t *set = set_create_hashed(compare_ints, hash_ints);
+    frozenset_t *frozen;
+    void **probes = malloc(sizeof(void *) * n);
+    unsigned char *found = malloc(n / 8 + 1);
+    clock_t start;
+    int i, batch = 1024, hits[4] = { 0, 0, 0, 0 };
+    double t[4];
+
+    for (i = 0; i < n; i++) {
+	set_add(set, nums[i]);
+	/* nums holds values below n, so n + i is never in the set. */
+	probes[i] = rand() % 2 ? nums[rand() % n] : newint(n + i);
+    }
+    frozen = set_freeze(set, compare_ints);
+
+    printf("n,contains,contains_many,frozen_contains,frozen_contains_many\n");
+
+    start = clock();
+    for (i = 0; i < n; i++)
+	hits[0] += set_contains(set, probes[i]);
+    t[0] = timesince(start);
+
+    start = clock();
+    for (i = 0; i < n; i += batch)
+	hits[1] += set_contains_many(set, probes + i, n - i < batch ? n - i : batch, found);
+    t[1] = timesince(start);
+
+    start = clock();
+    for (i = 0; i < n; i++)
+	hits[2] += frozenset_contains(frozen, probes[i]);
+    t[2] = timesince(start);
+
+    start = clock();
+    for (i = 0; i < n; i += batch)
+	hits[3] += frozenset_contains_many(frozen, probes + i, n - i < batch ? n - i : batch, found);
+    t[3] = timesince(start);
+
+    if (hits[1] != hits[0] || hits[2] != hits[0] || hits[3] != hits[0])
+	ERROR_PRINT("benchmark_many: found %d, %d, %d and %d\n", hits[0], hits[1], hits[2], hits[3]);
+
+    printf("%d", n);
+    for (i = 0; i < 4; i++)
+	printf(",%.0lf", n / t[i]);
+    printf("\n");
+
+    for (i = 0; i < n; i++) {
+	if (*(int *)probes[i] >= n)
+	    free(probes[i]);
+    }
+    free(probes);
+    free(found);
+    frozenset_destroy(frozen);
+    set_destroy(set);
+}
+
+static int compare_intptrs(const void *a, const void *b)
+{
+    return compare_ints(*(void **)a, *(void **)b);
+}
+
+/*
+ * Times three ways of filling an empty set with the same n elements:
+ * one set_add per element, one set_add_all call, and building the set
+ * with set_from_sorted_array from input that is already sorted.  The
+ * sorting for the last column is done before the clock starts.
+ */
+static void benchmark_bulk(int n, int **nums)
+{
+    set_t *set;
+    void **sorted = malloc(sizeof(void *) * (n + 1));
+    clock_t start;
+    int i;
+
+    printf("n,add,add_all,from_sorted_array\n");
+    printf("%d", n);
+
+    set = set_create_hashed(compare_ints, hash_ints);
+    start = clock();
+    for (i = 0; i < n; i++) {
+	set_add(set, nums[i]);
+    }
+    printf(",%lf", timesince(start));
+    set_destroy(set);
+
+    set = set_create_hashed(compare_ints, hash_ints);
+    start = clock();
+    set_add_all(set, (void **)nums, n);
+    printf(",%lf", timesince(start));
+    set_destroy(set);
+
+    for (i = 0; i < n; i++) {
+	sorted[i] = nums[i];
+    }
+    qsort(sorted, n, sizeof(void *), compare_intptrs);
+
+    start = clock();
+    set = set_from_sorted_array(compare_ints, hash_ints, sorted, n);
+    printf(",%lf\n", timesince(start));
+    set_destroy(set);
+
+    free(sorted);
+}
+
+/*
+ * Times union, intersection and difference of the multiples of 2 and
+ * the multiples of 3 below n, first as sets and then as integer sets
+ * converted from them.  Each time is the average of 10 runs.
+ */
+static void benchmark_intset(int n)
+{
+    set_t *a = set_create_hashed(compare_ints, hash_ints);
+    set_t *b = set_create_hashed(compare_ints, hash_ints);
+    set_t *(*opers[])(set_t *, set_t *) = { set_union, set_intersection, set_difference };
+    intset_t *(*intopers[])(intset_t *, intset_t *) = { intset_union, intset_intersection, intset_difference };
+    intset_t *ia, *ib;
+    int *values = malloc(sizeof(int) * n);
+    clock_t start;
+    int i, j, runs = 10;
+
+    for (i = 0; i < n; i++) {
+	values[i] = i;
+	if (i % 2 == 0)
+	    set_add(a, &values[i]);
+	if (i % 3 == 0)
+	    set_add(b, &values[i]);
+    }
+
+    ia = intset_from_set(a);
+    ib = intset_from_set(b);
+
+    printf("n,union,intset_union,intersection,intset_intersection,difference,intset_difference\n");
+    printf("%d", n);
+
+    for (i = 0; i < 3; i++) {
+	start = clock();
+	for (j = 0; j < runs; j++)
+	    set_destroy(opers[i](a, b));
+	printf(",%lf", timesince(start) / runs);
+
+	start = clock();
+	for (j = 0; j < runs; j++)
+	    intset_destroy(intopers[i](ia, ib));
+	printf(",%lf", timesince(start) / runs);
+    }
+    printf("\n");
+
+    intset_destroy(ia);
+    intset_destroy(ib);
+    set_destroy(a);
+    set_destroy(b);
+    free(values);
+}
+
+/*
+ * Fills buf with n bytes that look like mail: lines of words of 1 to
+ * 12 letters, some of them capitalised or numbers, with punctuation,
+ * and now and then a 76 character base64 line.
+ */
+static void make_mail(char *buf, int n)
+{
+    static const char *seps[] = { " ", " ", " ", " ", ", ", ". ", "\n", "! " };
+    static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    int i = 0, j, len;
+
+    while (i < n) {
+	if (rand() % 50 == 0) {
+	    for (j = 0; j < 76 && i < n; j++)
+		buf[i++] = base64[rand() % 64];
+	    if (i < n)
+		buf[i++] = '\n';
+	    continue;
+	}
+	len = 1 + rand() % 12;
+	for (j = 0; j < len && i < n; j++) {
+	    if (rand() % 20 == 0)
+		buf[i++] = '0' + rand() % 10;
+	    else
+		buf[i++] = (j == 0 && rand() % 8 == 0 ? 'A' : 'a') + rand() % 26;
+	}
+	for (j = 0, len = rand() % 8; seps[len][j] && i < n; j++)
+	    buf[i++] = seps[len][j];
+    }
+}
+
+/*
+ * Times each word scanner the CPU supports on n bytes of generated
+ * mail.  Prints the throughput in MB/s, the average of 5 runs, and
+ * the number of words found, which must be the same for all.
+ */
+static void benchmark_scan(int n)
+{
+    static const char *names[] = { "scalar", "sse2", "avx2" };
+    char *buf = malloc(n);
+    size_t starts[256], ends[256], words, got;
+    wordscan_t *scan;
+    clock_t start;
+    double t;
+    int i, j, runs = 5;
+
+    make_mail(buf, n);
+    printf("impl,mb_per_sec,words\n");
+
+    for (i = 0; i < 3; i++) {
+	if (!wordscan_select(names[i]))
+	    continue;
+	words = 0;
+	start = clock();
+	for (j = 0; j < runs; j++) {
+	    scan = wordscan_create(buf, n);
+	    while ((got = wordscan_next(scan, starts, ends, 256)) > 0)
+		words += got;
+	    wordscan_destroy(scan);
+	}
+	t = timesince(start) / runs;
+	printf("%s,%.1lf,%zu\n", names[i], n / t / 1e6, words / runs);
+    }
+    free(buf);
+}
+
 int main(int argc, char **argv)
 {
-    if (argc != 2) {
-	ERROR_PRINT("Must provide exactly 1 argument!\nUsage: %s 100\n", argv[0]);
+    if (argc != 2 && argc != 3) {
+	ERROR_PRINT("Must provide 1 or 2 arguments!\nUsage: %s 100 [sorted|iter|lookup|bulk|frozen|many|intset|scan]\n", argv[0]);
     }
 
     set_t *set_a, *set_b, *union_set, *intersection_set, *difference_set;
     clock_t start;
     double cumsum = 0;
-    int i, n;
+    int i, n, sorted;
     int **nums;
 
     n = atol(argv[1]);
 
+    if (argc == 3 && strcmp(argv[2], "intset") == 0) {
+	benchmark_intset(n);
+	return 0;
+    }
+
+    if (argc == 3 && strcmp(argv[2], "scan") == 0) {
+	benchmark_scan(n);
+	return 0;
+    }
+
+    /*
+     * In sorted mode the elements are added in ascending order,
+     * which is the worst case for an unbalanced tree.
+     */
+    sorted = argc == 3 && strcmp(argv[2], "sorted") == 0;
+
     srand(time(NULL));
 
     /* Allocate numbers for different tests. */
     nums = (int **) malloc(sizeof(int*) * n);
 
     for (i = 0; i < n; i++) {
-	nums[i] = newint(rand() % n);
+	nums[i] = newint(sorted ? i : rand() % n);
+    }
+
+    if (argc == 3 && (strcmp(argv[2], "iter") == 0 || strcmp(argv[2], "lookup") == 0 ||
+		      strcmp(argv[2], "bulk") == 0 || strcmp(argv[2], "frozen") == 0 ||
+		      strcmp(argv[2], "many") == 0)) {
+	if (strcmp(argv[2], "iter") == 0)
+	    benchmark_iter(n, nums);
+	else if (strcmp(argv[2], "lookup") == 0)
+	    benchmark_lookup(n, nums);
+	else if (strcmp(argv[2], "frozen") == 0)
+	    benchmark_frozen(n, nums);
+	else if (strcmp(argv[2], "many") == 0)
+	    benchmark_many(n, nums);
+	else
+	    benchmark_bulk(n, nums);
+
+	for (i = 0; i < n; i++) {
+	    free(nums[i]);
+	}
+	free(nums);
+	return 0;
     }
 
-    set_a = set_create(compare_ints);
-    set_b = set_create(compare_ints);
+    set_a = set_create_hashed(compare_ints, hash_ints);
+    set_b = set_create_hashed(compare_ints, hash_ints);
 
     printf("n,add,union,difference,intersection\n");
 
     for (i = 0; i < n; i = i + 1) {
 	start = clock();
-	set_add(set_a, nums[rand() % n]);
+	set_add(set_a, nums[sorted ? i : rand() % n]);
 	// printf("%d,add,%lf\n", i, timesince(start));
 	cumsum += timesince(start);
 
 	printf("%d,%lf,", i, cumsum);
 
-	set_add(set_b, nums[rand() % n]);
+	set_add(set_b, nums[sorted ? i : rand() % n]);
 
 	start = clock();
 	union_set = set_union(set_a, set_b);
@@ -1,12 +1,27 @@
 /**
  * @file bst.c
  * @brief Implementation of binary search tree.
+ *
+ * The tree is right-threaded: a node without a right child instead
+ * points right to its in-order successor, with the lowest bit of the
+ * pointer set to tell the two apart. The largest node points to a head
+ * node kept in the tree itself, whose left child is the root. Threads
+ * let iteration, copying and building run without parent pointers,
+ * recursion or a stack, so a degenerate tree is only slow, never deep
+ * enough to overflow the stack.
+ *
+ * Every node also counts the nodes in its subtree, itself included.
+ * That lets tree_rank and tree_select find the position of an element,
+ * or the element at a position, in one descent.
+ *
  * @author Christian Salomonsen
  */
 
 #include "bst.h"
 #include "common.h"
+#include "pool.h"
 #include "printing.h"
+#include <stdint.h>
 #include <stdlib.h>
 
 
@@ -19,67 +34,104 @@ struct node;
  */
 typedef struct node node_t;
 
-struct tree {
-	node_t *root;
-	size_t size;
-	cmpfunc_t cmp;
-};
-
 struct node {
 	void *elem;
 	node_t *left;
 	node_t *right;
-	node_t *parent;
+	size_t size;
 };
 
+/*
+ * The root is head.left. head.right points to head itself as a real
+ * child, so the thread out of the largest node always leads to a node
+ * that has a right child.
+ */
+struct tree {
+	node_t head;
+	size_t size;
+	cmpfunc_t cmp;
+	pool_t *pool;
+};
+
+/**
+ * @brief Number of searches tree_find_many runs side by side.
+ */
+#define FIND_GROUP 16
+
+/**
+ * @brief Tag bit set in node->right when it is a thread.
+ */
+#define THREAD ((uintptr_t)1)
+
+/**
+ * @brief Make a thread to the given node.
+ */
+static inline node_t *thread(node_t *node)
+{
+	return (node_t *)((uintptr_t)node | THREAD);
+}
+
+/**
+ * @brief Check if node->right is a thread rather than a right child.
+ */
+static inline int isthread(node_t *node)
+{
+	return ((uintptr_t)node->right & THREAD) != 0;
+}
+
+/**
+ * @brief Get the node node->right points to, child or thread.
+ */
+static inline node_t *rightlink(node_t *node)
+{
+	return (node_t *)((uintptr_t)node->right & ~THREAD);
+}
+
+/**
+ * @brief Get the right child of a node.
+ *
+ * @param node
+ * @return right child | NULL (node->right is a thread)
+ */
+static inline node_t *rightchild(node_t *node)
+{
+	return isthread(node) ? NULL : node->right;
+}
+
 /**
  * @brief Create a new node.
  *
+ * @param tree tree whose pool the node is allocated from.
  * @param elem 
  * @return node
  */
-static node_t *newnode(void *elem)
+static node_t *newnode(tree_t *tree, void *elem)
 {
-	node_t *node = malloc(sizeof(node_t));
+	node_t *node = pool_alloc(tree->pool);
 
 	if (!node)
-		ERROR_PRINT("newnode: Malloc failed!\n");
+		ERROR_PRINT("newnode: Pool allocation failed!\n");
 
 	node->elem = elem;
 	node->right = NULL;
-	node->left =NULL;
-	node->parent =NULL;
+	node->left = NULL;
+	node->size = 1;
 
 	return node;
 }
 
-
 /**
- * @brief Delete a node.
+ * @brief Get the number of nodes in the subtree below node.
  *
- * @param root 
+ * @param node
+ * @return size | 0 (node is NULL)
  */
-static void deletenode(node_t *root)
+static inline size_t nodesize(node_t *node)
 {
-	if (!root) {
-		INFO_PRINT("deletenode: Not a node...\n");
-		return;
-	}
-
-	if (root->left) {
-		INFO_PRINT("deletenode: Enter root->left...\n");
-		deletenode(root->left);
-	}
-
-	if (root->right) {
-		INFO_PRINT("deletenode: Enter root->right...\n");
-		deletenode(root->right);
-	}
-
-	INFO_PRINT("deletenode: Freeing node\n");
-	free(root);
+	return node ? node->size : 0;
 }
 
+
 /**
  * @brief Create a binary search tree.
  *
@@ -93,8 +145,16 @@ tree_t *tree_create(cmpfunc_t cmpfunc)
 	if (!tree)
 		ERROR_PRINT("bst_create: Malloc failed!\n");
 
+	// Every node of the tree is allocated from its own pool.
+	tree->pool = pool_create(sizeof(node_t));
+
+	if (!tree->pool)
+		ERROR_PRINT("bst_create: Pool creation failed!\n");
+
 	tree->cmp = cmpfunc;
-	tree->root = NULL;
+	tree->head.elem = NULL;
+	tree->head.left = NULL;
+	tree->head.right = &tree->head;
 	tree->size = 0;
 
 	return tree;
@@ -107,9 +167,8 @@ tree_t *tree_create(cmpfunc_t cmpfunc)
  */
 void tree_destroy(tree_t *tree)
 {
-	// Recursively destroy all nodes beneath root.
-	if (tree->root)
-		deletenode(tree->root);
+	// Every node lives in the pool, so there is no need to visit them.
+	pool_destroy(tree->pool);
 
 	INFO_PRINT("tree_destroy: All subnodes destroyed.\n");
 	free(tree);
@@ -136,7 +195,7 @@ size_t tree_size(tree_t *tree)
  */
 int tree_find(tree_t *tree, void *elem)
 {
-	node_t *curr = tree->root;
+	node_t *curr = tree->head.left;
 
 	int cmpval;
 
@@ -155,7 +214,7 @@ int tree_find(tree_t *tree, void *elem)
 		} 
 		if (cmpval < 0) {
 			INFO_PRINT("tree_find: Accessing right subtree.\n");
-			curr = curr->right;
+			curr = rightchild(curr);
 			continue;
 		}
 	}
@@ -163,6 +222,53 @@ int tree_find(tree_t *tree, void *elem)
 	return 0;
 }
 
+/**
+ * @brief Search the tree for a batch of elements at once. The searches
+ * take turns, one step each, and every step prefetches the node the
+ * search will look at next, so that up to FIND_GROUP nodes are loaded
+ * from memory at the same time.
+ *
+ * @param tree
+ * @param elems elements to search for.
+ * @param n number of elements.
+ * @param found bitmap where bit i is set if elems[i] is found. Other
+ * bits are left as they are.
+ * @return number of elements found.
+ */
+int tree_find_many(tree_t *tree, void **elems, int n, unsigned char *found)
+{
+	node_t *curr[FIND_GROUP];
+	int i, g, size, active, cmpval, count = 0;
+
+	for (g = 0; g < n; g += FIND_GROUP) {
+		size = n - g < FIND_GROUP ? n - g : FIND_GROUP;
+		for (i = 0; i < size; i++)
+			curr[i] = tree->head.left;
+		active = tree->head.left ? size : 0;
+
+		while (active > 0) {
+			for (i = 0; i < size; i++) {
+				if (!curr[i])
+					continue;
+
+				cmpval = tree->cmp(curr[i]->elem, elems[g + i]);
+				if (cmpval == 0) {
+					found[(g + i) / 8] |= 1 << ((g + i) % 8);
+					count++;
+					curr[i] = NULL;
+				} else {
+					curr[i] = cmpval > 0 ? curr[i]->left : rightchild(curr[i]);
+				}
+
+				if (curr[i])
+					__builtin_prefetch(curr[i]);
+				else
+					active--;
+			}
+		}
+	}
+	return count;
+}
 
 /**
  * @brief Add a element to the tree. The element must be a void *.
@@ -175,12 +281,14 @@ int tree_find(tree_t *tree, void *elem)
  */
 int tree_add(tree_t *tree, void *elem)
 {
-	node_t *curr = tree->root;
+	node_t *curr = tree->head.left, *node;
 	int cmpval;
 
 	// Handle case where tree does not have a root.
 	if (!curr) {
-		tree->root = newnode(elem);
+		node = newnode(tree, elem);
+		node->right = thread(&tree->head);
+		tree->head.left = node;
 		tree->size++;
 		return 1;
 	}
@@ -188,6 +296,9 @@ int tree_add(tree_t *tree, void *elem)
 	while (curr) {
 		cmpval = tree->cmp(curr->elem, elem);
 
+		// A new node ends up in the subtree of every node passed.
+		curr->size++;
+
 		// Indication to move to the left side of current node.
 		if (cmpval > 0) {
 
@@ -200,9 +311,11 @@ int tree_add(tree_t *tree, void *elem)
 			}
 
 			// If current node does not have a left node,
-			// assign value to a new node on its left.
-			curr->left = newnode(elem);
-			curr->left->parent = curr;
+			// assign value to a new node on its left. The
+			// new node comes right before curr.
+			node = newnode(tree, elem);
+			node->right = thread(curr);
+			curr->left = node;
 			tree->size++;
 			return 1;
 		}
@@ -210,7 +323,7 @@ int tree_add(tree_t *tree, void *elem)
 		// Indicate to move to the left side of the current node.
 		if (cmpval < 0) {
 
-			if (curr->right) {
+			if (!isthread(curr)) {
 
 				// Iterate from currents right node.
 				curr = curr->right; 
@@ -218,12 +331,21 @@ int tree_add(tree_t *tree, void *elem)
 			}
 
 			// create new node to curr's right if 
-			// it does not have one.
-			curr->right = newnode(elem);
-			curr->right->parent = curr;
+			// it does not have one. The new node takes
+			// over curr's thread to its successor.
+			node = newnode(tree, elem);
+			node->right = curr->right;
+			curr->right = node;
 			tree->size++;
 			return 1;
 		}
+		// Take back the sizes bumped on the way down to the duplicate.
+		for (node = tree->head.left; node != curr; ) {
+			node->size--;
+			node = tree->cmp(node->elem, elem) > 0 ? node->left : node->right;
+		}
+		curr->size--;
+
 		INFO_PRINT("tree_add: Element already exist.\n");
 		return 2;
 	}
@@ -232,31 +354,126 @@ int tree_add(tree_t *tree, void *elem)
 }
 
 /**
- * @brief Copies a nodes properties, including all links to
- * other nodes and the element stored in the respective nodes.
+ * @brief Unlink a node that has no left child from the tree. Its right
+ * child, or its thread if it has none, takes its place.
  *
  * Note: Static function.
  *
+ * @param parent parent of node (the head if node is the root).
  * @param node 
- * @return node_t *
  */
-static node_t *nodecopy(node_t *node, node_t *parent)
+static void unlinknode(node_t *parent, node_t *node)
 {
-	if (!node)
-		return NULL;
+	if (parent->left == node) {
+		// A thread from a left child leads to the parent, and is dropped.
+		parent->left = rightchild(node);
+	} else {
+		// A thread from a right child is passed on to the parent.
+		parent->right = node->right;
+	}
+}
 
-	node_t *copy = newnode(node->elem);
 
-	// Recursively set the right and left nodes.
-	copy->right = nodecopy(node->right, copy);
-	copy->left = nodecopy(node->left, copy);
+/**
+ * @brief Remove an element from the tree.
+ *
+ * A node with two children takes over the element of its successor,
+ * the leftmost node of its right subtree, and the successor is
+ * removed instead. A node with only a left child is replaced by it,
+ * and the largest node of that left subtree, whose thread led to the
+ * removed node, gets the removed node's thread.
+ *
+ * @param tree 
+ * @param elem 
+ * @return 1 if the element was removed. 0 if it was not in the tree.
+ */
+int tree_remove(tree_t *tree, void *elem)
+{
+	node_t *parent = &tree->head, *node = tree->head.left, *pred, *curr;
+	int cmpval;
 
-	// set parent
-	copy->parent = parent;
+	// Find the node, and keep track of its parent on the way down.
+	while (node) {
+		cmpval = tree->cmp(node->elem, elem);
 
-	return copy;
+		if (cmpval == 0)
+			break;
+
+		parent = node;
+		node = cmpval > 0 ? node->left : rightchild(node);
+	}
+
+	if (!node) {
+		INFO_PRINT("tree_remove: Element not found.\n");
+		return 0;
+	}
+
+	// Every node above the removed one loses one node below it.
+	for (curr = tree->head.left; curr != node; ) {
+		curr->size--;
+		curr = tree->cmp(curr->elem, elem) > 0 ? curr->left : curr->right;
+	}
+
+	if (node->left && !isthread(node)) {
+		// Two children, so remove the successor in its place.
+		node_t *succ = node->right, *succparent = node;
+
+		node->size--;
+		while (succ->left) {
+			succ->size--;
+			succparent = succ;
+			succ = succ->left;
+		}
+
+		node->elem = succ->elem;
+		unlinknode(succparent, succ);
+		node = succ;
+	} else if (node->left) {
+		pred = node->left;
+
+		while (!isthread(pred))
+			pred = pred->right;
+
+		pred->right = node->right;
+
+		if (parent->left == node)
+			parent->left = node->left;
+		else
+			parent->right = node->left;
+	} else {
+		unlinknode(parent, node);
+	}
+
+	pool_free(tree->pool, node);
+	tree->size--;
+
+	return 1;
 }
 
+/**
+ * @brief Get the node that follows node in preorder. Needs no stack:
+ * without a left child, follow threads up to the first node that has
+ * a right child that has not been visited yet.
+ *
+ * Note: Static function.
+ *
+ * @param node 
+ * @return node_t * (the head once the whole tree is visited)
+ */
+static node_t *node_preorder_next(node_t *node)
+{
+	if (node->left)
+		return node->left;
+
+	while (isthread(node))
+		node = rightlink(node);
+
+	return node->right;
+}
+
+
+/* tree_copy copies every node. */
+const int tree_cheap_copy = 0;
 
 /**
  * @brief Create a shallow copy of the tree, meaning
@@ -264,27 +481,168 @@ static node_t *nodecopy(node_t *node, node_t *parent)
  * are clones and essentially the same as in the
  * original.
  *
+ * Both trees are walked in preorder in lockstep, and every child of
+ * the original is mirrored in the copy before moving on, which keeps
+ * the threads of the copy correct along the way (Knuth, TAOCP 2.3.1,
+ * Algorithm C).
+ *
  * @param tree 
  * @return tree_t *
  */
 tree_t *tree_copy(tree_t *tree)
 {
 	tree_t *copy = tree_create(tree->cmp);
+	node_t *p = &tree->head, *q = &copy->head, *r;
+
+	// The heads have no elements, and their right child is themselves.
+	do {
+		if (p != &tree->head) {
+			q->elem = p->elem;
+			q->size = p->size;
+
+			if (!isthread(p)) {
+				r = newnode(copy, NULL);
+				r->right = q->right;
+				q->right = r;
+			}
+		}
+
+		if (p->left) {
+			r = newnode(copy, NULL);
+			r->right = thread(q);
+			q->left = r;
+		}
+
+		p = node_preorder_next(p);
+		q = node_preorder_next(q);
+	} while (p != &tree->head);
 
-	copy->root = nodecopy(tree->root, NULL);
 	copy->size = tree->size;
 
 	return copy;
 }
 
 
+/**
+ * @brief Build a perfectly balanced subtree from the sorted elements
+ * elems[0..n), by making the middle element the root and building
+ * both halves recursively.
+ *
+ * Note: Static function.
+ *
+ * The recursion is only as deep as the balanced tree, so O(log n).
+ *
+ * @param tree tree being built.
+ * @param elems 
+ * @param n 
+ * @param succ node that comes right after the subtree.
+ * @return node_t *
+ */
+static node_t *nodebuild(tree_t *tree, void **elems, size_t n, node_t *succ)
+{
+	if (n == 0)
+		return NULL;
+
+	size_t mid = n / 2;
+	node_t *node = newnode(tree, elems[mid]);
+
+	node->size = n;
+	node->left = nodebuild(tree, elems, mid, node);
+
+	if (n - mid - 1 > 0)
+		node->right = nodebuild(tree, elems + mid + 1, n - mid - 1, succ);
+	else
+		node->right = thread(succ);
+
+	return node;
+}
+
+
+/**
+ * @brief Create a tree from elements that are already sorted in
+ * ascending order and contain no duplicates. Every node is visited
+ * once, so this is O(n), and the tree has minimal height.
+ *
+ * @param cmpfunc comparison function used by the new tree.
+ * @param elems sorted array of elements.
+ * @param n number of elements.
+ * @return tree_t *
+ */
+tree_t *tree_build_sorted(cmpfunc_t cmpfunc, void **elems, size_t n)
+{
+	tree_t *tree = tree_create(cmpfunc);
+
+	tree->head.left = nodebuild(tree, elems, n, &tree->head);
+	tree->size = n;
+
+	return tree;
+}
+
+/**
+ * @brief Count the elements in the tree that are smaller than elem.
+ * Every step right skips the left subtree and the node itself, so this
+ * is one descent.
+ *
+ * @param tree
+ * @param elem
+ * @return number of smaller elements.
+ */
+size_t tree_rank(tree_t *tree, void *elem)
+{
+	node_t *curr = tree->head.left;
+	size_t rank = 0;
+
+	while (curr) {
+		if (tree->cmp(curr->elem, elem) < 0) {
+			rank += nodesize(curr->left) + 1;
+			curr = rightchild(curr);
+		} else {
+			curr = curr->left;
+		}
+	}
+
+	return rank;
+}
+
+/**
+ * @brief Get the element at position k of the tree in ascending
+ * order, counting from 0.
+ *
+ * @param tree
+ * @param k
+ * @return elem | NULL (k is not smaller than the size of the tree)
+ */
+void *tree_select(tree_t *tree, size_t k)
+{
+	node_t *curr = tree->head.left;
+	size_t left;
+
+	while (curr) {
+		left = nodesize(curr->left);
+
+		if (k == left)
+			return curr->elem;
+
+		if (k < left) {
+			curr = curr->left;
+		} else {
+			k -= left + 1;
+			curr = rightchild(curr);
+		}
+	}
+
+	return NULL;
+}
+
 /**
  * @typedef Datatype implementation of tree_iter_t.
  *
  */
 struct tree_iter
 {
+	tree_t *tree;
 	node_t *current;
+	node_t *end;
 };
 
 /**
@@ -307,64 +665,115 @@ static node_t *node_leftmost(node_t *root)
 /**
  * @brief Get the next node after the input node.
  *
+ * A thread leads straight to the successor. Otherwise the successor
+ * is the leftmost node of the right subtree. Each node is descended
+ * into once and threaded out of once over a full iteration, so this
+ * is O(1) amortized.
+ *
  * @param node 
- * @return node
+ * @return node (the head after the largest node)
  */
 static node_t *node_getnext(node_t *node)
 {
-	/*
-	 * The following implementation is a tricky one, but stay frosty...
-	 * To visit all elements in the tree in an ascending
-	 * order; the first call to this function must have
-	 * the leftmost node of the tree.
-	 *
-	 * The first conditional statement says that if the input
-	 * node has a right node then find the leftmost node of
-	 * the right node. This ensures that we always get the node
-	 * with the smallest element first.
-	 * 
-	 * The while loop says that if the node has a parent, i.e.
-	 * isn't the root node, and the current node is its own parents
-	 * right node then set move to the parent node.
-	 * This ensures that whenever we are in a subtree, the only way
-	 * to move up is if we are one the rightmost path w.r.t the subtree.
-	 *
-	 */
-	if (node->right)
-		return node_leftmost(node->right);
-
-	while (node->parent && node == node->parent->right)
-		node = node->parent;
-
-	return node->parent;
+	if (isthread(node))
+		return rightlink(node);
+
+	return node_leftmost(node->right);
+}
+
+/**
+ * @brief Find the first node whose element is not smaller than key.
+ *
+ * @param tree
+ * @param key
+ * @return node | the head (every element is smaller than key)
+ */
+static node_t *node_lowerbound(tree_t *tree, void *key)
+{
+	node_t *curr = tree->head.left, *bound = &tree->head;
+
+	while (curr) {
+		if (tree->cmp(curr->elem, key) < 0) {
+			curr = rightchild(curr);
+		} else {
+			bound = curr;
+			curr = curr->left;
+		}
+	}
+
+	return bound;
 }
 
 /**
  * @brief Create a iter to iterate over the input tree.
  *
  * @param tree 
- * @return iter | NULL (if tree is empty)
+ * @return iter
  */
 tree_iter_t *tree_createiter(tree_t *tree)
+{
+	return tree_createiter_range(tree, NULL, NULL);
+}
+
+/**
+ * @brief Create a iter over the elements in [lo, hi) of the input
+ * tree. Both ends are found by one descent each, and the iteration
+ * stops at the node of the upper one.
+ *
+ * @param tree
+ * @param lo smallest element to visit | NULL (from the start)
+ * @param hi bound past the largest element to visit | NULL (to the end)
+ * @return iter
+ */
+tree_iter_t *tree_createiter_range(tree_t *tree, void *lo, void *hi)
 {
 	tree_iter_t *iter = malloc(sizeof(tree_iter_t));
 
 	if (!iter)
 		ERROR_PRINT("tree_createiter: Malloc failed!\n");
 
-	// If the root of the tree is not defined, return an empty iterator.
-	if (!tree->root) {
-		iter->current = NULL;
-		return iter;
-	}
+	iter->tree = tree;
+	iter->end = hi ? node_lowerbound(tree, hi) : &tree->head;
 
-	// Start with the node that has the smallest value.
-	iter->current = node_leftmost(tree->root);
+	if (lo)
+		iter->current = node_lowerbound(tree, lo);
+	else
+		iter->current = tree->head.left ? node_leftmost(tree->head.left) : &tree->head;
+
+	// An empty range, or lo past hi, gives an empty iterator.
+	if (iter->current == iter->end || (lo && hi && tree->cmp(lo, hi) >= 0))
+		iter->current = NULL;
 
 	INFO_PRINT("tree_createiter: Tree iterator successfully created\n.");
 	return iter;
 }
 
+/**
+ * @brief Move the iter forward to the first element that is not
+ * smaller than key, by a fresh descent from the root.
+ *
+ * @param iter
+ * @param key
+ */
+void tree_iter_seek(tree_iter_t *iter, void *key)
+{
+	tree_t *tree = iter->tree;
+
+	if (!iter->current || tree->cmp(iter->current->elem, key) >= 0)
+		return;
+
+	// The end node holds the smallest element at or past hi.
+	if (iter->end != &tree->head && tree->cmp(key, iter->end->elem) >= 0) {
+		iter->current = NULL;
+		return;
+	}
+
+	iter->current = node_lowerbound(tree, key);
+
+	if (iter->current == iter->end)
+		iter->current = NULL;
+}
+
 /**
  * @brief Free the given iter.
  *
@@ -393,25 +802,24 @@ int tree_hasnext(tree_iter_t *iter)
  * @brief Returns the next element in the binary tree.
  *
  * @param iter 
- * @return elem
+ * @return elem | NULL (end of iterator)
  */
 void *tree_next(tree_iter_t *iter)
 {
 	// Store the current element to output from iter's current element.
 	node_t *used = iter->current;
 
+	// Like list_next, return NULL once the iterator is exhausted.
+	if (!used)
+		return NULL;
+
 	// Find the next element (will not be output in this iteration).
 	iter->current = node_getnext(used);
 
-	/*
-	 * Because node_getnext(rightmost node) returns itself,
-	 * we may use this as an indicator to stop the iteration
-	 * when the current has been used.
-	 */
-	if (iter->current == used) {
+	// The largest node threads to the head, which ends the iteration.
+	if (iter->current == iter->end) {
 		INFO_PRINT("tree_next: End of iterator\n.");
 		iter->current = NULL;
-		return NULL;
 	}
 
 	return used->elem;
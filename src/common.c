@@ -1,74 +1,340 @@
 /* Author: Steffen Viken Valvaag <steffenv@cs.uit.no> */
 #include "common.h"
 #include "list.h"
+#include "set.h"
 #include "printing.h"
+#include "wordscan.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
+/* The size of each read() when a file cannot be mapped. */
+#define READ_CHUNK 65536
+
+/* The number of words taken from the scanner at a time. */
+#define WORD_BATCH 256
+
+/* The number of spans a tokenized file starts out with room for. */
+#define INITIAL_SPANS 1024
+
+/*
+ * The contents of a file, either mapped into memory or read into a
+ * buffer.  mapped is the length of the mapping, or 0 if the contents
+ * were read.  Only the bytes from start on are left to tokenize.
+ */
+typedef struct {
+    char *data;
+    size_t size, start, mapped;
+} filedata_t;
+
+/*
+ * Reads the rest of the file into a growing buffer.  Used for pipes
+ * and other files that cannot be mapped.  Goes through fread, so any
+ * bytes stdio has already buffered are not lost.
+ */
+static void readfile(FILE *file, filedata_t *fd)
+{
+    size_t capacity = READ_CHUNK, n;
+
+    fd->data = malloc(capacity);
+    fd->size = fd->start = fd->mapped = 0;
+    if (fd->data == NULL)
+        ERROR_PRINT("out of memory");
+    while ((n = fread(fd->data + fd->size, 1, capacity - fd->size, file)) > 0) {
+        fd->size += n;
+        if (fd->size == capacity) {
+            capacity *= 2;
+            fd->data = realloc(fd->data, capacity);
+            if (fd->data == NULL)
+                ERROR_PRINT("out of memory");
+        }
+    }
+}
+
+/*
+ * Maps the file into memory if it is a regular file, and reads it
+ * otherwise.  Tokenizing starts at the current position of the file,
+ * as it did with fscanf.
+ */
+static void loadfile(FILE *file, filedata_t *fd)
+{
+    struct stat st;
+    off_t pos = ftello(file);
+    void *data;
+
+    if (pos >= 0 && fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > pos) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            fd->data = data;
+            fd->size = fd->mapped = st.st_size;
+            fd->start = pos;
+            /* Leave the file at its end, as reading it would have. */
+            fseeko(file, 0, SEEK_END);
+            return;
+        }
+    }
+    readfile(file, fd);
+}
+
+static void unloadfile(filedata_t *fd)
+{
+    if (fd->mapped)
+        munmap(fd->data, fd->mapped);
+    else
+        free(fd->data);
+}
+
 void tokenize_file(FILE *file, list_t *list)
 {
+    filedata_t fd;
+    wordscan_t *scan;
+    size_t starts[WORD_BATCH], ends[WORD_BATCH], n, j;
     char *word;
     int i = 0;
-    char buf[101];
-    buf[100] = 0;
-    
-    while (!feof(file)) {
-		/* Skip non-letters */
-		fscanf(file, "%*[^a-zA-Z0-9'_]");
-		/* Scan up to 100 letters */
-		if (fscanf(file, "%100[a-zA-Z0-9'_]", buf) == 1) {
-	    	word = strdup(buf);
-	    	if (word == NULL)
-				ERROR_PRINT("out of memory");
-                DEBUG_PRINT("tokenize i=%d: %s\n", i, word);
-	    	list_addlast(list, word);
-                i++; 
-		}
+
+    loadfile(file, &fd);
+    scan = wordscan_create(fd.data + fd.start, fd.size - fd.start);
+
+    while ((n = wordscan_next(scan, starts, ends, WORD_BATCH)) > 0) {
+        for (j = 0; j < n; j++) {
+            word = strndup(fd.data + fd.start + starts[j], ends[j] - starts[j]);
+            if (word == NULL)
+                ERROR_PRINT("out of memory");
+            DEBUG_PRINT("tokenize i=%d: %s\n", i, word);
+            list_addlast(list, word);
+            i++;
+        }
     }
+    wordscan_destroy(scan);
+    unloadfile(&fd);
 }
 
-struct list *find_files(char *root)
+void tokenize_file_into_set(FILE *file, set_t *set, wordfunc_t elemfunc, void *arg)
+{
+    filedata_t fd;
+    wordscan_t *scan;
+    size_t starts[WORD_BATCH], ends[WORD_BATCH], n, j, len;
+    char buf[WORDSCAN_MAX_WORD + 1], *word;
+    const char *data;
+
+    loadfile(file, &fd);
+    data = fd.data + fd.start;
+    scan = wordscan_create(data, fd.size - fd.start);
+
+    while ((n = wordscan_next(scan, starts, ends, WORD_BATCH)) > 0) {
+        for (j = 0; j < n; j++) {
+            /* Words are at most WORDSCAN_MAX_WORD long, so they fit in buf. */
+            len = ends[j] - starts[j];
+            memcpy(buf, data + starts[j], len);
+            buf[len] = 0;
+
+            if (elemfunc != NULL) {
+                set_add(set, elemfunc(buf, arg));
+            } else if (!set_contains(set, buf)) {
+                word = strdup(buf);
+                if (word == NULL)
+                    ERROR_PRINT("out of memory");
+                set_add(set, word);
+            }
+        }
+    }
+    wordscan_destroy(scan);
+    unloadfile(&fd);
+}
+
+struct tokens {
+    filedata_t fd;
+    span_t *spans;
+    int n, capacity;
+};
+
+tokens_t *tokenize_file_spans(FILE *file)
 {
-    list_t *files;
-    char *command;
-    FILE *f;
-    
-    files = list_create(compare_strings);
-    command = malloc(strlen(root) + 40);
-    if (command == NULL)
+    tokens_t *tokens = malloc(sizeof(tokens_t));
+    wordscan_t *scan;
+    size_t starts[WORD_BATCH], ends[WORD_BATCH], n, j;
+    const char *data;
+
+    if (tokens == NULL)
         ERROR_PRINT("out of memory");
-    sprintf(command, "/usr/bin/find %s -not -type d", root);
-    f = popen(command, "r");
-    if (f == NULL) {
-        perror("popen");
-        ERROR_PRINT("popen() failed");
+    loadfile(file, &tokens->fd);
+    tokens->n = 0;
+    tokens->capacity = INITIAL_SPANS;
+    tokens->spans = malloc(tokens->capacity * sizeof(span_t));
+    if (tokens->spans == NULL)
+        ERROR_PRINT("out of memory");
+
+    data = tokens->fd.data + tokens->fd.start;
+    scan = wordscan_create(data, tokens->fd.size - tokens->fd.start);
+    while ((n = wordscan_next(scan, starts, ends, WORD_BATCH)) > 0) {
+        if (tokens->n + (int)n > tokens->capacity) {
+            tokens->capacity *= 2;
+            tokens->spans = realloc(tokens->spans, tokens->capacity * sizeof(span_t));
+            if (tokens->spans == NULL)
+                ERROR_PRINT("out of memory");
+        }
+        for (j = 0; j < n; j++) {
+            tokens->spans[tokens->n].data = data + starts[j];
+            tokens->spans[tokens->n++].len = ends[j] - starts[j];
+        }
     }
-    while(!feof(f)) {
-        char line[300], *path, *p;
-        
-        /* Read one line of output from the find command */
-        if (fgets(line, sizeof(line), f) == NULL)
-            break;
-        
-        /* Strip trailing whitespace */
-        p = line+strlen(line)-1;
-        while (p >= line && isspace(*p))
-            *p-- = 0;
-            
-        /* Copy and add the path to the list */
-        path = strdup(line);
-        if (path == NULL)
+    wordscan_destroy(scan);
+    return tokens;
+}
+
+void tokens_destroy(tokens_t *tokens)
+{
+    unloadfile(&tokens->fd);
+    free(tokens->spans);
+    free(tokens);
+}
+
+int tokens_size(tokens_t *tokens)
+{
+    return tokens->n;
+}
+
+span_t *tokens_get(tokens_t *tokens, int i)
+{
+    return &tokens->spans[i];
+}
+
+/*
+ * A path that grows and shrinks as a walk goes into and out of
+ * directories.
+ */
+typedef struct {
+    char *buf;
+    size_t len, capacity;
+} pathbuf_t;
+
+/*
+ * Appends "/name" to the path, or just name if the path already ends
+ * with a slash.
+ */
+static void path_append(pathbuf_t *path, const char *name)
+{
+    size_t namelen = strlen(name);
+    int slash = path->len > 0 && path->buf[path->len - 1] != '/';
+
+    if (path->len + slash + namelen + 1 > path->capacity) {
+        while (path->len + slash + namelen + 1 > path->capacity)
+            path->capacity *= 2;
+        path->buf = realloc(path->buf, path->capacity);
+        if (path->buf == NULL)
             ERROR_PRINT("out of memory");
-        list_addlast(files, path);
     }
-    if (pclose(f) < 0) {
-        perror("pclose");
-        ERROR_PRINT("pclose() failed");
+    if (slash)
+        path->buf[path->len++] = '/';
+    memcpy(path->buf + path->len, name, namelen + 1);
+    path->len += namelen;
+}
+
+/*
+ * Walks the open directory dirfd, whose path is path, and closes it.
+ * Entries are opened relative to their directory, so the length of
+ * the path never matters to the kernel.
+ */
+static int walk_dir(int dirfd, pathbuf_t *path, filefunc_t func, void *arg)
+{
+    DIR *dir = fdopendir(dirfd);
+    struct dirent *entry;
+    struct stat st;
+    size_t len = path->len;
+    int fd, isdir, count = 0;
+
+    if (dir == NULL) {
+        perror(path->buf);
+        close(dirfd);
+        return 0;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        path_append(path, entry->d_name);
+
+        /* Most file systems give the type, so only stat when they do not. */
+        if (entry->d_type != DT_UNKNOWN)
+            isdir = entry->d_type == DT_DIR;
+        else
+            isdir = fstatat(dirfd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+
+        if (isdir) {
+            fd = openat(dirfd, entry->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd < 0)
+                perror(path->buf);
+            else
+                count += walk_dir(fd, path, func, arg);
+        } else {
+            func(path->buf, arg);
+            count++;
+        }
+        path->len = len;
+        path->buf[len] = 0;
+    }
+    closedir(dir);
+    return count;
+}
+
+int walk_files(char *root, filefunc_t func, void *arg)
+{
+    pathbuf_t path;
+    struct stat st;
+    int fd, count;
+
+    fd = open(root, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        /*
+         * A root that is a file, or a symbolic link to anything, is
+         * reported by itself, as find does without -H or -L.
+         */
+        if (errno == ENOTDIR ||
+            (errno == ELOOP && lstat(root, &st) == 0 && S_ISLNK(st.st_mode))) {
+            func(root, arg);
+            return 1;
+        }
+        perror(root);
+        return 0;
     }
-    free(command);    
+
+    path.len = strlen(root);
+    path.capacity = path.len + 256;
+    path.buf = malloc(path.capacity);
+    if (path.buf == NULL)
+        ERROR_PRINT("out of memory");
+    memcpy(path.buf, root, path.len + 1);
+
+    count = walk_dir(fd, &path, func, arg);
+    free(path.buf);
+    return count;
+}
+
+/*
+ * Adds a copy of the path to the list given as arg.
+ */
+static void add_path(char *path, void *list)
+{
+    char *copy = strdup(path);
+
+    if (copy == NULL)
+        ERROR_PRINT("out of memory");
+    list_addlast(list, copy);
+}
+
+struct list *find_files(char *root)
+{
+    list_t *files = list_create(compare_strings);
+
+    walk_files(root, add_path, files);
     return files;
 }
 
@@ -76,3 +342,29 @@ int compare_strings(void *a, void *b)
 {
     return strcmp(a, b);
 }
+
+int compare_spans(void *a, void *b)
+{
+    span_t *sa = a, *sb = b;
+    size_t len = sa->len < sb->len ? sa->len : sb->len;
+    int cmp = memcmp(sa->data, sb->data, len);
+
+    /* Words hold no NULs, so the shorter one sorts first, as with strcmp(). */
+    if (cmp != 0)
+        return cmp;
+    return (sa->len > sb->len) - (sa->len < sb->len);
+}
+
+unsigned long hash_spans(void *a)
+{
+    span_t *span = a;
+    unsigned long hash = 14695981039346656037ul;
+    size_t i;
+
+    /* FNV-1a */
+    for (i = 0; i < span->len; i++) {
+        hash ^= (unsigned char)span->data[i];
+        hash *= 1099511628211ul;
+    }
+    return hash;
+}
@@ -0,0 +1,248 @@
+/*
+ * Runs the same workloads on the C set.h backend chosen with
+ * IMPLEMENTATION= and on the C++ sets::Set backends from set.hpp.
+ * The C sets hold boxed ints compared through a function pointer,
+ * the C++ sets hold the ints themselves.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "set.hpp"
+
+/* printing.h defines a macro named reset, so it goes after the C++ headers. */
+extern "C" {
+#include "set.h"
+#include "printing.h"
+}
+
+#ifndef IMPLEMENTATION_NAME
+#define IMPLEMENTATION_NAME "c"
+#endif
+
+static int compare_ints(void *a, void *b)
+{
+    int ia = *(int *)a;
+    int ib = *(int *)b;
+
+    return (ia > ib) - (ia < ib);
+}
+
+static unsigned long hash_ints(void *a)
+{
+    return (unsigned long)*(int *)a;
+}
+
+static void *newint(int i)
+{
+    int *p = (int *)malloc(sizeof(int));
+    *p = i;
+    return p;
+}
+
+static double timesince(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/*
+ * The keys of one run: the elements of the two sets, and the values
+ * to look up in the first.  checksum adds up the results of every
+ * step, so the C and C++ rows can be checked against each other.
+ */
+struct workload {
+    std::vector<int> a, b, probes;
+};
+
+static void printrow(const char *name, const double *times, long checksum)
+{
+    printf("%s,%lf,%lf,%lf,%lf,%lf,%lf,%ld\n", name, times[0], times[1], times[2],
+           times[3], times[4], times[5], checksum);
+}
+
+static long setsum(set_t *set)
+{
+    set_iter_t *it = set_createiter(set);
+    long sum = 0;
+
+    while (set_hasnext(it))
+        sum += *(int *)set_next(it);
+    set_destroyiter(it);
+    return sum;
+}
+
+static void benchmark_c(const workload &w)
+{
+    std::vector<void *> values;
+    set_t *a = set_create_hashed(compare_ints, hash_ints);
+    set_t *b = set_create_hashed(compare_ints, hash_ints);
+    set_t *res;
+    double times[6];
+    long checksum = 0;
+    clock_t start;
+    size_t i;
+
+    /* Box every int, like numbers.c and benchmark.c do. */
+    for (int v : w.a)
+        values.push_back(newint(v));
+    for (int v : w.b)
+        values.push_back(newint(v));
+
+    start = clock();
+    for (i = 0; i < w.a.size(); i++)
+        set_add(a, values[i]);
+    for (i = 0; i < w.b.size(); i++)
+        set_add(b, values[w.a.size() + i]);
+    times[0] = timesince(start);
+
+    start = clock();
+    for (i = 0; i < w.probes.size(); i++) {
+        int key = w.probes[i];
+        checksum += set_contains(a, &key);
+    }
+    times[1] = timesince(start);
+
+    start = clock();
+    res = set_union(a, b);
+    times[2] = timesince(start);
+    checksum += set_size(res);
+    set_destroy(res);
+
+    start = clock();
+    res = set_intersection(a, b);
+    times[3] = timesince(start);
+    checksum += set_size(res);
+    set_destroy(res);
+
+    start = clock();
+    res = set_difference(a, b);
+    times[4] = timesince(start);
+    checksum += set_size(res);
+    set_destroy(res);
+
+    start = clock();
+    checksum += setsum(a);
+    times[5] = timesince(start);
+
+    printrow("c-" IMPLEMENTATION_NAME, times, checksum);
+    set_destroy(a);
+    set_destroy(b);
+    for (void *p : values)
+        free(p);
+}
+
+template <typename S>
+static void benchmark_cpp(const char *name, const workload &w)
+{
+    S a, b;
+    double times[6];
+    long checksum = 0, sum = 0;
+    clock_t start;
+
+    start = clock();
+    for (int v : w.a)
+        a.insert(v);
+    for (int v : w.b)
+        b.insert(v);
+    times[0] = timesince(start);
+
+    start = clock();
+    for (int key : w.probes)
+        checksum += a.contains(key);
+    times[1] = timesince(start);
+
+    start = clock();
+    checksum += set_union(a, b).size();
+    times[2] = timesince(start);
+
+    start = clock();
+    checksum += set_intersection(a, b).size();
+    times[3] = timesince(start);
+
+    start = clock();
+    checksum += set_difference(a, b).size();
+    times[4] = timesince(start);
+
+    start = clock();
+    for (int v : a)
+        sum += v;
+    times[5] = timesince(start);
+    checksum += sum;
+
+    printrow(name, times, checksum);
+}
+
+/*
+ * Times the union of two sets of long strings, once with the sets
+ * passed as lvalues, copying every string, and once passed as rvalues,
+ * moving them.  The results are destroyed after the clock stops.
+ */
+template <template <typename, typename> class Backend>
+static void benchmark_move(const char *name, const workload &w)
+{
+    using S = sets::Set<std::string, std::less<std::string>, Backend>;
+    const std::string suffix = ", and then long enough to be past any small string buffer";
+    S a, b;
+    clock_t start;
+    double copy, move;
+
+    for (int v : w.a)
+        a.insert(std::to_string(v) + suffix);
+    for (int v : w.b)
+        b.insert(std::to_string(v) + suffix);
+
+    start = clock();
+    S copied = set_union(a, b);
+    copy = timesince(start);
+
+    start = clock();
+    S moved = set_union(std::move(a), std::move(b));
+    move = timesince(start);
+
+    if (moved.size() != copied.size())
+        ERROR_PRINT("benchmark_move: union by move differs from union by copy\n");
+    printf("%s,%lf,%lf\n", name, copy, move);
+}
+
+int main(int argc, char **argv)
+{
+    workload w;
+    const char *only;
+    int i, n;
+
+    if (argc != 2 && argc != 3) {
+        ERROR_PRINT("Must provide 1 or 2 arguments!\nUsage: %s 100000 [list|tree|array]\n", argv[0]);
+    }
+    n = atoi(argv[1]);
+    only = argc == 3 ? argv[2] : NULL;
+
+    srand(1);
+    for (i = 0; i < n; i++) {
+        w.a.push_back(rand() % n);
+        w.b.push_back(rand() % n);
+        w.probes.push_back(rand() % n);
+    }
+
+    printf("impl,add,contains,union,intersection,difference,iterate,checksum\n");
+    benchmark_c(w);
+    if (!only || strcmp(only, "list") == 0)
+        benchmark_cpp<sets::Set<int, std::less<int>, sets::list_backend>>("cpp-list", w);
+    if (!only || strcmp(only, "tree") == 0)
+        benchmark_cpp<sets::Set<int, std::less<int>, sets::tree_backend>>("cpp-tree", w);
+    if (!only || strcmp(only, "array") == 0)
+        benchmark_cpp<sets::Set<int, std::less<int>, sets::array_backend>>("cpp-array", w);
+
+    printf("strings,union_copy,union_move\n");
+    if (!only || strcmp(only, "list") == 0)
+        benchmark_move<sets::list_backend>("cpp-list", w);
+    if (!only || strcmp(only, "tree") == 0)
+        benchmark_move<sets::tree_backend>("cpp-tree", w);
+    if (!only || strcmp(only, "array") == 0)
+        benchmark_move<sets::array_backend>("cpp-array", w);
+
+    return 0;
+}
@@ -0,0 +1,241 @@
+/**
+ * @file frozenset.c
+ * @brief Implementation of frozen sets as Eytzinger-ordered arrays.
+ *
+ * The elements are stored in elems[1..n] in the order of a breadth
+ * first walk of a complete binary search tree: the children of the
+ * element at index k are found at 2k and 2k + 1. A search only
+ * computes the next index from the result of a comparison, so the
+ * loop has no branch on the comparison, and the elements three levels
+ * further down lie next to each other and can be prefetched.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "frozenset.h"
+#include "printing.h"
+
+#define CACHE_LINE 64
+
+/*
+ * The descendants of k three levels down are the elements 8k to
+ * 8k + 7. With 8 byte pointers and the array aligned to a cache line,
+ * they fill exactly one line, which is fetched while the three levels
+ * above it are searched.
+ */
+#define PREFETCH_AHEAD 8
+
+/*
+ * Number of searches frozenset_contains_many runs side by side.
+ */
+#define SEARCH_GROUP 16
+
+struct frozenset {
+	void **elems;
+	size_t n;
+	cmpfunc_t cmpfunc;
+};
+
+struct frozenset_iter {
+	frozenset_t *set;
+	size_t k;
+};
+
+/**
+ * @brief Place the sorted elements into the subtree rooted at index
+ * k, in order.
+ *
+ * @param set frozen set being built.
+ * @param sorted elements in ascending order.
+ * @param i index of the next element of sorted to place.
+ * @param k index of the subtree root.
+ * @return index of the first element of sorted not yet placed.
+ */
+static size_t fill(frozenset_t *set, void **sorted, size_t i, size_t k)
+{
+	if (k <= set->n) {
+		i = fill(set, sorted, i, 2 * k);
+		set->elems[k] = sorted[i++];
+		i = fill(set, sorted, i, 2 * k + 1);
+	}
+	return i;
+}
+
+frozenset_t *set_freeze(set_t *set, cmpfunc_t cmpfunc)
+{
+	frozenset_t *frozen = malloc(sizeof(frozenset_t));
+	set_iter_t *iter;
+	void **sorted;
+	size_t i, bytes;
+
+	if (!frozen)
+		ERROR_PRINT("set_freeze: Malloc failed!\n");
+
+	frozen->n = set_size(set);
+	frozen->cmpfunc = cmpfunc;
+
+	/* Index 0 is unused, and aligned_alloc wants whole lines. */
+	bytes = (frozen->n + 1) * sizeof(void *);
+	bytes = (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+	frozen->elems = aligned_alloc(CACHE_LINE, bytes);
+	sorted = malloc((frozen->n + 1) * sizeof(void *));
+	if (!frozen->elems || !sorted)
+		ERROR_PRINT("set_freeze: Malloc failed!\n");
+
+	i = 0;
+	iter = set_createiter(set);
+	while (set_hasnext(iter))
+		sorted[i++] = set_next(iter);
+	set_destroyiter(iter);
+
+	frozen->elems[0] = NULL;
+	fill(frozen, sorted, 0, 1);
+	free(sorted);
+
+	return frozen;
+}
+
+void frozenset_destroy(frozenset_t *set)
+{
+	free(set->elems);
+	free(set);
+}
+
+int frozenset_size(frozenset_t *set)
+{
+	return set->n;
+}
+
+int frozenset_contains(frozenset_t *set, void *elem)
+{
+	void **elems = set->elems;
+	size_t n = set->n;
+	size_t k = 1;
+
+	/*
+	 * Descend to a leaf, going right whenever elems[k] is smaller.
+	 * The prefetch may point past the end of the array, which is
+	 * harmless since prefetches never fault.
+	 */
+	while (k <= n) {
+		__builtin_prefetch((char *)elems + PREFETCH_AHEAD * k * sizeof(void *));
+		k = 2 * k + (set->cmpfunc(elems[k], elem) < 0);
+	}
+
+	/*
+	 * The path ends with the right turns taken after the last left
+	 * turn, and the element where that left turn was taken is the
+	 * smallest one not smaller than elem. Drop those right turns and
+	 * the left turn to get back to it.
+	 */
+	k >>= __builtin_ffsl(~k);
+
+	return k != 0 && set->cmpfunc(elems[k], elem) == 0;
+}
+
+/*
+ * Searches in a group take turns, one level each. A search prefetches
+ * the node it moves to as well as the line three levels further down,
+ * so the loads of the whole group are in flight together.
+ */
+int frozenset_contains_many(frozenset_t *set, void **elems, int n, unsigned char *found)
+{
+	size_t k[SEARCH_GROUP];
+	int j, g, size, active, count = 0;
+
+	memset(found, 0, (n + 7) / 8);
+
+	for (g = 0; g < n; g += SEARCH_GROUP) {
+		size = n - g < SEARCH_GROUP ? n - g : SEARCH_GROUP;
+
+		for (j = 0; j < size; j++)
+			k[j] = 1;
+
+		do {
+			active = 0;
+			for (j = 0; j < size; j++) {
+				if (k[j] > set->n)
+					continue;
+				k[j] = 2 * k[j] + (set->cmpfunc(set->elems[k[j]], elems[g + j]) < 0);
+				__builtin_prefetch((char *)set->elems + k[j] * sizeof(void *));
+				__builtin_prefetch((char *)set->elems + PREFETCH_AHEAD * k[j] * sizeof(void *));
+				active = 1;
+			}
+		} while (active);
+
+		for (j = 0; j < size; j++) {
+			k[j] >>= __builtin_ffsl(~k[j]);
+			if (k[j] != 0 && set->cmpfunc(set->elems[k[j]], elems[g + j]) == 0) {
+				found[(g + j) / 8] |= 1 << ((g + j) % 8);
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+/**
+ * @brief Find the leftmost index of the subtree rooted at k.
+ *
+ * @param set frozen set.
+ * @param k index of the subtree root, at most n.
+ * @return index of the smallest element of the subtree.
+ */
+static size_t leftmost(frozenset_t *set, size_t k)
+{
+	while (2 * k <= set->n)
+		k *= 2;
+	return k;
+}
+
+frozenset_iter_t *frozenset_createiter(frozenset_t *set)
+{
+	frozenset_iter_t *iter = malloc(sizeof(frozenset_iter_t));
+
+	if (!iter)
+		ERROR_PRINT("frozenset_createiter: Malloc failed!\n");
+
+	iter->set = set;
+	iter->k = set->n > 0 ? leftmost(set, 1) : 0;
+
+	return iter;
+}
+
+void frozenset_destroyiter(frozenset_iter_t *iter)
+{
+	free(iter);
+}
+
+int frozenset_hasnext(frozenset_iter_t *iter)
+{
+	return iter->k != 0;
+}
+
+void *frozenset_next(frozenset_iter_t *iter)
+{
+	frozenset_t *set = iter->set;
+	size_t k = iter->k;
+	void *elem;
+
+	if (k == 0)
+		return NULL;
+	elem = set->elems[k];
+
+	/*
+	 * The in-order successor is the leftmost element of the right
+	 * subtree, or else the first ancestor reached from its left child.
+	 */
+	if (2 * k + 1 <= set->n) {
+		k = leftmost(set, 2 * k + 1);
+	} else {
+		while (k & 1)
+			k >>= 1;
+		k >>= 1;
+	}
+	iter->k = k;
+
+	return elem;
+}
@@ -0,0 +1,214 @@
+/**
+ * @file intern.c
+ * @brief Implementation of intern tables for words.
+ *
+ * Words are found through an open addressing hash table with linear
+ * probing, whose slots hold word IDs. The case-folded words are kept
+ * in words[id], and copied into large blocks of memory rather than
+ * allocated one by one. The hash of every word is kept in hashes[id],
+ * so most mismatches are rejected without comparing strings, and the
+ * table can grow without hashing the words again.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "printing.h"
+
+#define INITIAL_SLOTS 1024
+#define INITIAL_WORDS 512
+#define BLOCK_SIZE 65536
+
+typedef struct block block_t;
+
+struct block {
+	block_t *next;
+	char data[];
+};
+
+struct intern {
+	uint32_t *slots;
+	size_t mask;
+	char **words;
+	uint32_t *hashes;
+	uint32_t n;
+	uint32_t capacity;
+	block_t *blocks;
+	size_t used;
+};
+
+intern_t *intern_create(void)
+{
+	intern_t *table = malloc(sizeof(intern_t));
+
+	if (!table)
+		ERROR_PRINT("intern_create: Malloc failed!\n");
+
+	table->slots = calloc(INITIAL_SLOTS, sizeof(uint32_t));
+	table->mask = INITIAL_SLOTS - 1;
+	table->words = malloc(INITIAL_WORDS * sizeof(char *));
+	table->hashes = malloc(INITIAL_WORDS * sizeof(uint32_t));
+	if (!table->slots || !table->words || !table->hashes)
+		ERROR_PRINT("intern_create: Malloc failed!\n");
+
+	/* ID 0 is never handed out. */
+	table->words[0] = NULL;
+	table->hashes[0] = 0;
+	table->n = 0;
+	table->capacity = INITIAL_WORDS;
+	table->blocks = NULL;
+	table->used = BLOCK_SIZE;
+
+	return table;
+}
+
+void intern_destroy(intern_t *table)
+{
+	block_t *block, *next;
+
+	for (block = table->blocks; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+	free(table->slots);
+	free(table->words);
+	free(table->hashes);
+	free(table);
+}
+
+int intern_count(intern_t *table)
+{
+	return table->n;
+}
+
+/**
+ * @brief Case-insensitive FNV-1a hash, folding each character the
+ * same way the stored words are folded.
+ *
+ * @param word word to hash.
+ * @param len set to the length of the word.
+ * @return hash
+ */
+static uint32_t hashword(const char *word, size_t *len)
+{
+	const unsigned char *p = (const unsigned char *)word;
+	uint32_t hash = 2166136261u;
+
+	while (*p) {
+		hash ^= (uint32_t)tolower(*p++);
+		hash *= 16777619u;
+	}
+	*len = p - (const unsigned char *)word;
+	return hash;
+}
+
+/**
+ * @brief Compare a stored, case-folded word with a word that may
+ * not be folded.
+ *
+ * @return 1 if they are equal, ignoring case, 0 otherwise.
+ */
+static int samefolded(const char *folded, const char *word)
+{
+	while (*folded && *folded == tolower((unsigned char)*word)) {
+		folded++;
+		word++;
+	}
+	return *folded == 0 && *word == 0;
+}
+
+/**
+ * @brief Copy the case-folded word into the current block, starting
+ * a new block if it does not fit.
+ *
+ * @return the stored copy.
+ */
+static char *storeword(intern_t *table, const char *word, size_t len)
+{
+	block_t *block;
+	char *copy;
+	size_t i, size = len + 1;
+
+	if (table->used + size > BLOCK_SIZE) {
+		/* Words longer than a block get a block of their own. */
+		block = malloc(sizeof(block_t) + (size > BLOCK_SIZE ? size : BLOCK_SIZE));
+		if (!block)
+			ERROR_PRINT("intern_word: Malloc failed!\n");
+		block->next = table->blocks;
+		table->blocks = block;
+		table->used = 0;
+	}
+
+	copy = table->blocks->data + table->used;
+	for (i = 0; i < len; i++)
+		copy[i] = tolower((unsigned char)word[i]);
+	copy[len] = 0;
+	table->used += size;
+
+	return copy;
+}
+
+/**
+ * @brief Double the number of slots, and place every ID again using
+ * its stored hash.
+ */
+static void grow(intern_t *table)
+{
+	size_t i, mask = 2 * table->mask + 1;
+	uint32_t id, *slots = calloc(mask + 1, sizeof(uint32_t));
+
+	if (!slots)
+		ERROR_PRINT("intern_word: Malloc failed!\n");
+
+	for (id = 1; id <= table->n; id++) {
+		i = table->hashes[id] & mask;
+		while (slots[i])
+			i = (i + 1) & mask;
+		slots[i] = id;
+	}
+
+	free(table->slots);
+	table->slots = slots;
+	table->mask = mask;
+}
+
+uint32_t intern_word(intern_t *table, const char *word)
+{
+	size_t i, len;
+	uint32_t id, hash = hashword(word, &len);
+
+	for (i = hash & table->mask; (id = table->slots[i]); i = (i + 1) & table->mask) {
+		if (table->hashes[id] == hash && samefolded(table->words[id], word))
+			return id;
+	}
+
+	/* A new word. Make room for its ID, and keep the slots half empty. */
+	id = table->n + 1;
+	if (id == table->capacity) {
+		table->capacity *= 2;
+		table->words = realloc(table->words, table->capacity * sizeof(char *));
+		table->hashes = realloc(table->hashes, table->capacity * sizeof(uint32_t));
+		if (!table->words || !table->hashes)
+			ERROR_PRINT("intern_word: Realloc failed!\n");
+	}
+	table->words[id] = storeword(table, word, len);
+	table->hashes[id] = hash;
+	table->n = id;
+	table->slots[i] = id;
+
+	if (2 * (size_t)table->n > table->mask)
+		grow(table);
+
+	return id;
+}
+
+const char *intern_lookup(intern_t *table, uint32_t id)
+{
+	if (id == 0 || id > table->n)
+		return NULL;
+	return table->words[id];
+}
@@ -0,0 +1,922 @@
+/**
+ * @file intset.c
+ * @brief Implementation of integer sets as Roaring-style bitmaps.
+ *
+ * A value is split into a 16 bit key (its upper half) and a 16 bit
+ * low part. The set keeps a sorted array of keys, and for every key a
+ * container holding the low parts:
+ *  - ARRAY:  sorted uint16_t values, used up to ARRAY_MAX values.
+ *  - BITMAP: 1024 64-bit words, one bit per possible low part.
+ *  - RUN:    sorted runs of consecutive values, made by intset_optimize.
+ * Set operations between bitmaps are done a word at a time. Run
+ * containers are expanded to an array or bitmap before an operation,
+ * since they are meant for compact storage of finished sets.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "intset.h"
+#include "printing.h"
+
+#define ARRAY_MAX 4096
+#define BITMAP_WORDS 1024
+
+#define ARRAY 0
+#define BITMAP 1
+#define RUN 2
+
+typedef struct run run_t;
+
+struct run {
+	uint16_t start;
+	uint16_t last;
+};
+
+typedef struct container container_t;
+
+struct container {
+	int type;
+	int card;
+	int n;
+	int capacity;
+	uint16_t *array;
+	uint64_t *bitmap;
+	run_t *runs;
+};
+
+struct intset {
+	uint16_t *keys;
+	container_t **containers;
+	int n;
+	int capacity;
+};
+
+/**
+ * @brief Create an empty container of the given type.
+ *
+ * @param type ARRAY or BITMAP.
+ * @param capacity number of values to make room for in an array.
+ * @return container
+ */
+static container_t *newcontainer(int type, int capacity)
+{
+	container_t *c = malloc(sizeof(container_t));
+
+	if (!c)
+		ERROR_PRINT("newcontainer: Malloc failed!\n");
+
+	c->type = type;
+	c->card = 0;
+	c->n = 0;
+	c->capacity = 0;
+	c->array = NULL;
+	c->bitmap = NULL;
+	c->runs = NULL;
+
+	if (type == BITMAP) {
+		c->bitmap = calloc(BITMAP_WORDS, sizeof(uint64_t));
+		if (!c->bitmap)
+			ERROR_PRINT("newcontainer: Calloc failed!\n");
+	} else {
+		c->capacity = capacity < 4 ? 4 : capacity;
+		c->array = malloc(c->capacity * sizeof(uint16_t));
+		if (!c->array)
+			ERROR_PRINT("newcontainer: Malloc failed!\n");
+	}
+
+	return c;
+}
+
+static void deletecontainer(container_t *c)
+{
+	free(c->array);
+	free(c->bitmap);
+	free(c->runs);
+	free(c);
+}
+
+static int bitmap_contains(uint64_t *bitmap, uint16_t low)
+{
+	return (bitmap[low >> 6] >> (low & 63)) & 1;
+}
+
+/**
+ * @brief Count the set bits of a bitmap.
+ */
+static int bitmap_card(uint64_t *bitmap)
+{
+	int i, card = 0;
+
+	for (i = 0; i < BITMAP_WORDS; i++)
+		card += __builtin_popcountll(bitmap[i]);
+
+	return card;
+}
+
+/**
+ * @brief Find the first position in array[0..n) not smaller than low.
+ */
+static int array_lowerbound(uint16_t *array, int n, uint16_t low)
+{
+	int lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (array[mid] < low)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * @brief Turn an array container into a bitmap container in place.
+ */
+static void array_to_bitmap(container_t *c)
+{
+	int i;
+
+	c->bitmap = calloc(BITMAP_WORDS, sizeof(uint64_t));
+	if (!c->bitmap)
+		ERROR_PRINT("array_to_bitmap: Calloc failed!\n");
+
+	for (i = 0; i < c->card; i++)
+		c->bitmap[c->array[i] >> 6] |= (uint64_t)1 << (c->array[i] & 63);
+
+	free(c->array);
+	c->array = NULL;
+	c->capacity = 0;
+	c->type = BITMAP;
+}
+
+/**
+ * @brief Turn a bitmap container into an array container in place.
+ * The caller makes sure the cardinality is at most ARRAY_MAX.
+ */
+static void bitmap_to_array(container_t *c)
+{
+	uint64_t word;
+	int i, n = 0;
+
+	c->capacity = c->card < 4 ? 4 : c->card;
+	c->array = malloc(c->capacity * sizeof(uint16_t));
+	if (!c->array)
+		ERROR_PRINT("bitmap_to_array: Malloc failed!\n");
+
+	for (i = 0; i < BITMAP_WORDS; i++) {
+		// Peel off the lowest set bit until the word is empty.
+		for (word = c->bitmap[i]; word; word &= word - 1)
+			c->array[n++] = (uint16_t)(i * 64 + __builtin_ctzll(word));
+	}
+
+	free(c->bitmap);
+	c->bitmap = NULL;
+	c->type = ARRAY;
+}
+
+/**
+ * @brief Choose the cheaper of array and bitmap after an operation
+ * changed the cardinality of a bitmap container.
+ */
+static void bitmap_shrink(container_t *c)
+{
+	if (c->type == BITMAP && c->card <= ARRAY_MAX)
+		bitmap_to_array(c);
+}
+
+/**
+ * @brief Expand a run container into an array or bitmap in place.
+ */
+static void run_expand(container_t *c)
+{
+	run_t *runs = c->runs;
+	int i, v, n = c->n;
+
+	c->runs = NULL;
+	c->n = 0;
+
+	if (c->card > ARRAY_MAX) {
+		c->type = BITMAP;
+		c->bitmap = calloc(BITMAP_WORDS, sizeof(uint64_t));
+		if (!c->bitmap)
+			ERROR_PRINT("run_expand: Calloc failed!\n");
+
+		for (i = 0; i < n; i++) {
+			for (v = runs[i].start; v <= runs[i].last; v++)
+				c->bitmap[v >> 6] |= (uint64_t)1 << (v & 63);
+		}
+	} else {
+		c->type = ARRAY;
+		c->capacity = c->card < 4 ? 4 : c->card;
+		c->array = malloc(c->capacity * sizeof(uint16_t));
+		if (!c->array)
+			ERROR_PRINT("run_expand: Malloc failed!\n");
+
+		for (i = 0; i < n; i++) {
+			for (v = runs[i].start; v <= runs[i].last; v++)
+				c->array[c->n++] = (uint16_t)v;
+		}
+	}
+
+	free(runs);
+}
+
+/**
+ * @brief Count the runs of consecutive values in a container.
+ */
+static int container_countruns(container_t *c)
+{
+	uint64_t word, prev = 0;
+	int i, runs = 0;
+
+	if (c->type == ARRAY) {
+		for (i = 0; i < c->card; i++) {
+			if (i == 0 || c->array[i] != c->array[i - 1] + 1)
+				runs++;
+		}
+		return runs;
+	}
+
+	/*
+	 * A run starts at every set bit whose lower neighbour is clear,
+	 * i.e. at the set bits of word & ~(word << 1), where the bit
+	 * shifted in at the bottom is the top bit of the previous word.
+	 */
+	for (i = 0; i < BITMAP_WORDS; i++) {
+		word = c->bitmap[i];
+		runs += __builtin_popcountll(word & ~((word << 1) | (prev >> 63)));
+		prev = word;
+	}
+	return runs;
+}
+
+/**
+ * @brief Convert a container to runs, given its number of runs.
+ */
+static void container_torun(container_t *c, int nruns)
+{
+	run_t *runs = malloc(nruns * sizeof(run_t));
+	int i, v, n = 0;
+
+	if (!runs)
+		ERROR_PRINT("container_torun: Malloc failed!\n");
+
+	for (v = 0, i = 0; v < 65536; v++) {
+		int present = c->type == ARRAY
+			? (i < c->card && c->array[i] == v)
+			: bitmap_contains(c->bitmap, (uint16_t)v);
+
+		if (!present)
+			continue;
+		if (c->type == ARRAY)
+			i++;
+
+		if (n > 0 && runs[n - 1].last + 1 == v)
+			runs[n - 1].last = (uint16_t)v;
+		else
+			runs[n++] = (run_t){ (uint16_t)v, (uint16_t)v };
+	}
+
+	free(c->array);
+	free(c->bitmap);
+	c->array = NULL;
+	c->bitmap = NULL;
+	c->capacity = 0;
+	c->runs = runs;
+	c->n = n;
+	c->type = RUN;
+}
+
+static int container_contains(container_t *c, uint16_t low)
+{
+	int lo, hi, mid;
+
+	switch (c->type) {
+	case ARRAY:
+		lo = array_lowerbound(c->array, c->card, low);
+		return lo < c->card && c->array[lo] == low;
+	case BITMAP:
+		return bitmap_contains(c->bitmap, low);
+	default:
+		// Binary search for the last run starting at or before low.
+		lo = 0;
+		hi = c->n;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (c->runs[mid].start <= low)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo > 0 && c->runs[lo - 1].last >= low;
+	}
+}
+
+/**
+ * @brief Add a low part to a container.
+ *
+ * @return 1 if it was added, 0 if it was already present.
+ */
+static int container_add(container_t *c, uint16_t low)
+{
+	int pos;
+
+	if (c->type == RUN) {
+		if (container_contains(c, low))
+			return 0;
+		run_expand(c);
+	}
+
+	if (c->type == BITMAP) {
+		if (bitmap_contains(c->bitmap, low))
+			return 0;
+		c->bitmap[low >> 6] |= (uint64_t)1 << (low & 63);
+		c->card++;
+		return 1;
+	}
+
+	pos = array_lowerbound(c->array, c->card, low);
+
+	if (pos < c->card && c->array[pos] == low)
+		return 0;
+
+	if (c->card == ARRAY_MAX) {
+		array_to_bitmap(c);
+		return container_add(c, low);
+	}
+
+	if (c->card == c->capacity) {
+		c->capacity *= 2;
+		c->array = realloc(c->array, c->capacity * sizeof(uint16_t));
+		if (!c->array)
+			ERROR_PRINT("container_add: Realloc failed!\n");
+	}
+
+	memmove(&c->array[pos + 1], &c->array[pos], (c->card - pos) * sizeof(uint16_t));
+	c->array[pos] = low;
+	c->card++;
+	c->n = c->card;
+	return 1;
+}
+
+static container_t *container_copy(container_t *c)
+{
+	container_t *copy = malloc(sizeof(container_t));
+
+	if (!copy)
+		ERROR_PRINT("container_copy: Malloc failed!\n");
+
+	*copy = *c;
+	copy->array = NULL;
+	copy->bitmap = NULL;
+	copy->runs = NULL;
+
+	if (c->array) {
+		copy->array = malloc(c->capacity * sizeof(uint16_t));
+		if (copy->array)
+			memcpy(copy->array, c->array, c->card * sizeof(uint16_t));
+	}
+	if (c->bitmap) {
+		copy->bitmap = malloc(BITMAP_WORDS * sizeof(uint64_t));
+		if (copy->bitmap)
+			memcpy(copy->bitmap, c->bitmap, BITMAP_WORDS * sizeof(uint64_t));
+	}
+	if (c->runs) {
+		copy->runs = malloc(c->n * sizeof(run_t));
+		if (copy->runs)
+			memcpy(copy->runs, c->runs, c->n * sizeof(run_t));
+	}
+
+	if ((c->array && !copy->array) || (c->bitmap && !copy->bitmap) ||
+	    (c->runs && !copy->runs))
+		ERROR_PRINT("container_copy: Malloc failed!\n");
+
+	return copy;
+}
+
+/**
+ * @brief Get a container that is an array or bitmap, copying and
+ * expanding c if it holds runs. Pair with releasecontainer.
+ */
+static container_t *usecontainer(container_t *c)
+{
+	if (c->type != RUN)
+		return c;
+
+	c = container_copy(c);
+	run_expand(c);
+	return c;
+}
+
+static void releasecontainer(container_t *used, container_t *orig)
+{
+	if (used != orig)
+		deletecontainer(used);
+}
+
+/**
+ * @brief Union of two containers.
+ */
+static container_t *container_or(container_t *a, container_t *b)
+{
+	container_t *c, *big, *small;
+	int i, j;
+
+	if (a->type == BITMAP && b->type == BITMAP) {
+		c = newcontainer(BITMAP, 0);
+		for (i = 0; i < BITMAP_WORDS; i++)
+			c->bitmap[i] = a->bitmap[i] | b->bitmap[i];
+		c->card = bitmap_card(c->bitmap);
+		return c;
+	}
+
+	if (a->type == BITMAP || b->type == BITMAP) {
+		big = a->type == BITMAP ? a : b;
+		small = big == a ? b : a;
+
+		c = container_copy(big);
+		for (i = 0; i < small->card; i++)
+			container_add(c, small->array[i]);
+		return c;
+	}
+
+	// Both are arrays: merge them, and switch to a bitmap if too large.
+	if (a->card + b->card > ARRAY_MAX) {
+		c = newcontainer(BITMAP, 0);
+		for (i = 0; i < a->card; i++)
+			c->bitmap[a->array[i] >> 6] |= (uint64_t)1 << (a->array[i] & 63);
+		for (i = 0; i < b->card; i++)
+			c->bitmap[b->array[i] >> 6] |= (uint64_t)1 << (b->array[i] & 63);
+		c->card = bitmap_card(c->bitmap);
+		bitmap_shrink(c);
+		return c;
+	}
+
+	c = newcontainer(ARRAY, a->card + b->card);
+	i = j = 0;
+	while (i < a->card && j < b->card) {
+		if (a->array[i] < b->array[j])
+			c->array[c->card++] = a->array[i++];
+		else if (a->array[i] > b->array[j])
+			c->array[c->card++] = b->array[j++];
+		else {
+			c->array[c->card++] = a->array[i++];
+			j++;
+		}
+	}
+	while (i < a->card)
+		c->array[c->card++] = a->array[i++];
+	while (j < b->card)
+		c->array[c->card++] = b->array[j++];
+	c->n = c->card;
+	return c;
+}
+
+/**
+ * @brief Intersection of two containers.
+ */
+static container_t *container_and(container_t *a, container_t *b)
+{
+	container_t *c, *big, *small;
+	int i, j;
+
+	if (a->type == BITMAP && b->type == BITMAP) {
+		c = newcontainer(BITMAP, 0);
+		for (i = 0; i < BITMAP_WORDS; i++)
+			c->bitmap[i] = a->bitmap[i] & b->bitmap[i];
+		c->card = bitmap_card(c->bitmap);
+		bitmap_shrink(c);
+		return c;
+	}
+
+	if (a->type == BITMAP || b->type == BITMAP) {
+		big = a->type == BITMAP ? a : b;
+		small = big == a ? b : a;
+
+		c = newcontainer(ARRAY, small->card);
+		for (i = 0; i < small->card; i++) {
+			if (bitmap_contains(big->bitmap, small->array[i]))
+				c->array[c->card++] = small->array[i];
+		}
+		c->n = c->card;
+		return c;
+	}
+
+	c = newcontainer(ARRAY, a->card < b->card ? a->card : b->card);
+	i = j = 0;
+	while (i < a->card && j < b->card) {
+		if (a->array[i] < b->array[j])
+			i++;
+		else if (a->array[i] > b->array[j])
+			j++;
+		else {
+			c->array[c->card++] = a->array[i++];
+			j++;
+		}
+	}
+	c->n = c->card;
+	return c;
+}
+
+/**
+ * @brief Difference of two containers, a minus b.
+ */
+static container_t *container_andnot(container_t *a, container_t *b)
+{
+	container_t *c;
+	int i, j;
+
+	if (a->type == BITMAP) {
+		if (b->type == BITMAP) {
+			c = newcontainer(BITMAP, 0);
+			for (i = 0; i < BITMAP_WORDS; i++)
+				c->bitmap[i] = a->bitmap[i] & ~b->bitmap[i];
+		} else {
+			c = container_copy(a);
+			for (i = 0; i < b->card; i++)
+				c->bitmap[b->array[i] >> 6] &= ~((uint64_t)1 << (b->array[i] & 63));
+		}
+		c->card = bitmap_card(c->bitmap);
+		bitmap_shrink(c);
+		return c;
+	}
+
+	c = newcontainer(ARRAY, a->card);
+
+	if (b->type == BITMAP) {
+		for (i = 0; i < a->card; i++) {
+			if (!bitmap_contains(b->bitmap, a->array[i]))
+				c->array[c->card++] = a->array[i];
+		}
+		c->n = c->card;
+		return c;
+	}
+
+	i = j = 0;
+	while (i < a->card && j < b->card) {
+		if (a->array[i] < b->array[j])
+			c->array[c->card++] = a->array[i++];
+		else if (a->array[i] > b->array[j])
+			j++;
+		else {
+			i++;
+			j++;
+		}
+	}
+	while (i < a->card)
+		c->array[c->card++] = a->array[i++];
+	c->n = c->card;
+	return c;
+}
+
+intset_t *intset_create(void)
+{
+	intset_t *set = malloc(sizeof(intset_t));
+
+	if (!set)
+		ERROR_PRINT("intset_create: Malloc failed!\n");
+
+	set->n = 0;
+	set->capacity = 4;
+	set->keys = malloc(set->capacity * sizeof(uint16_t));
+	set->containers = malloc(set->capacity * sizeof(container_t *));
+
+	if (!set->keys || !set->containers)
+		ERROR_PRINT("intset_create: Malloc failed!\n");
+
+	return set;
+}
+
+void intset_destroy(intset_t *set)
+{
+	int i;
+
+	for (i = 0; i < set->n; i++)
+		deletecontainer(set->containers[i]);
+
+	free(set->keys);
+	free(set->containers);
+	free(set);
+}
+
+int intset_size(intset_t *set)
+{
+	int i, size = 0;
+
+	for (i = 0; i < set->n; i++)
+		size += set->containers[i]->card;
+
+	return size;
+}
+
+/**
+ * @brief Insert a container for key at position pos of the key array.
+ */
+static void insertcontainer(intset_t *set, int pos, uint16_t key, container_t *c)
+{
+	if (set->n == set->capacity) {
+		set->capacity *= 2;
+		set->keys = realloc(set->keys, set->capacity * sizeof(uint16_t));
+		set->containers = realloc(set->containers, set->capacity * sizeof(container_t *));
+
+		if (!set->keys || !set->containers)
+			ERROR_PRINT("insertcontainer: Realloc failed!\n");
+	}
+
+	memmove(&set->keys[pos + 1], &set->keys[pos], (set->n - pos) * sizeof(uint16_t));
+	memmove(&set->containers[pos + 1], &set->containers[pos],
+		(set->n - pos) * sizeof(container_t *));
+
+	set->keys[pos] = key;
+	set->containers[pos] = c;
+	set->n++;
+}
+
+/**
+ * @brief Append a container, or drop it if it turned out empty.
+ * Containers must be appended in ascending key order.
+ */
+static void appendcontainer(intset_t *set, uint16_t key, container_t *c)
+{
+	if (c->card == 0) {
+		deletecontainer(c);
+		return;
+	}
+
+	insertcontainer(set, set->n, key, c);
+}
+
+void intset_add(intset_t *set, unsigned int value)
+{
+	uint16_t key = (uint16_t)(value >> 16);
+	int pos = array_lowerbound(set->keys, set->n, key);
+
+	if (pos == set->n || set->keys[pos] != key)
+		insertcontainer(set, pos, key, newcontainer(ARRAY, 4));
+
+	container_add(set->containers[pos], (uint16_t)value);
+}
+
+int intset_contains(intset_t *set, unsigned int value)
+{
+	uint16_t key = (uint16_t)(value >> 16);
+	int pos = array_lowerbound(set->keys, set->n, key);
+
+	if (pos == set->n || set->keys[pos] != key)
+		return 0;
+
+	return container_contains(set->containers[pos], (uint16_t)value);
+}
+
+intset_t *intset_from_set(set_t *set)
+{
+	intset_t *intset = intset_create();
+	set_iter_t *iter = set_createiter(set);
+	int value;
+
+	// The set iterator is sorted, so containers are appended in order.
+	while (set_hasnext(iter)) {
+		value = *(int *)set_next(iter);
+
+		if (value < 0)
+			ERROR_PRINT("intset_from_set: Negative value %d!\n", value);
+
+		intset_add(intset, (unsigned int)value);
+	}
+
+	set_destroyiter(iter);
+	return intset;
+}
+
+void intset_optimize(intset_t *set)
+{
+	container_t *c;
+	int i, runs, size;
+
+	for (i = 0; i < set->n; i++) {
+		c = set->containers[i];
+
+		if (c->type == RUN)
+			continue;
+
+		// Sizes in bytes of the current layout and of the run layout.
+		size = c->type == ARRAY ? 2 * c->card : 8 * BITMAP_WORDS;
+		runs = container_countruns(c);
+
+		if ((int)(runs * sizeof(run_t)) < size)
+			container_torun(c, runs);
+	}
+}
+
+/*
+ * The set operations walk the sorted key arrays of a and b in step,
+ * and combine the containers of keys they have in common.
+ */
+intset_t *intset_union(intset_t *a, intset_t *b)
+{
+	intset_t *set = intset_create();
+	container_t *ca, *cb;
+	int i = 0, j = 0;
+
+	while (i < a->n && j < b->n) {
+		if (a->keys[i] < b->keys[j]) {
+			appendcontainer(set, a->keys[i], container_copy(a->containers[i]));
+			i++;
+		} else if (a->keys[i] > b->keys[j]) {
+			appendcontainer(set, b->keys[j], container_copy(b->containers[j]));
+			j++;
+		} else {
+			ca = usecontainer(a->containers[i]);
+			cb = usecontainer(b->containers[j]);
+			appendcontainer(set, a->keys[i], container_or(ca, cb));
+			releasecontainer(ca, a->containers[i]);
+			releasecontainer(cb, b->containers[j]);
+			i++;
+			j++;
+		}
+	}
+
+	for (; i < a->n; i++)
+		appendcontainer(set, a->keys[i], container_copy(a->containers[i]));
+	for (; j < b->n; j++)
+		appendcontainer(set, b->keys[j], container_copy(b->containers[j]));
+
+	return set;
+}
+
+intset_t *intset_intersection(intset_t *a, intset_t *b)
+{
+	intset_t *set = intset_create();
+	container_t *ca, *cb;
+	int i = 0, j = 0;
+
+	while (i < a->n && j < b->n) {
+		if (a->keys[i] < b->keys[j]) {
+			i++;
+		} else if (a->keys[i] > b->keys[j]) {
+			j++;
+		} else {
+			ca = usecontainer(a->containers[i]);
+			cb = usecontainer(b->containers[j]);
+			appendcontainer(set, a->keys[i], container_and(ca, cb));
+			releasecontainer(ca, a->containers[i]);
+			releasecontainer(cb, b->containers[j]);
+			i++;
+			j++;
+		}
+	}
+
+	return set;
+}
+
+intset_t *intset_difference(intset_t *a, intset_t *b)
+{
+	intset_t *set = intset_create();
+	container_t *ca, *cb;
+	int i = 0, j = 0;
+
+	while (i < a->n && j < b->n) {
+		if (a->keys[i] < b->keys[j]) {
+			appendcontainer(set, a->keys[i], container_copy(a->containers[i]));
+			i++;
+		} else if (a->keys[i] > b->keys[j]) {
+			j++;
+		} else {
+			ca = usecontainer(a->containers[i]);
+			cb = usecontainer(b->containers[j]);
+			appendcontainer(set, a->keys[i], container_andnot(ca, cb));
+			releasecontainer(ca, a->containers[i]);
+			releasecontainer(cb, b->containers[j]);
+			i++;
+			j++;
+		}
+	}
+
+	for (; i < a->n; i++)
+		appendcontainer(set, a->keys[i], container_copy(a->containers[i]));
+
+	return set;
+}
+
+intset_t *intset_copy(intset_t *set)
+{
+	intset_t *copy = intset_create();
+	int i;
+
+	for (i = 0; i < set->n; i++)
+		appendcontainer(copy, set->keys[i], container_copy(set->containers[i]));
+
+	return copy;
+}
+
+
+struct intset_iter
+{
+	intset_t *set;
+	int container;
+	int pos;
+	int value;
+};
+
+/**
+ * @brief Move the iterator to the first value at or after its
+ * current position, moving on to the next container when needed.
+ * pos indexes the array (ARRAY), the bit (BITMAP) or the run (RUN),
+ * and value is the offset within the current run.
+ */
+static void iter_settle(intset_iter_t *iter)
+{
+	container_t *c;
+	uint64_t word;
+
+	while (iter->container < iter->set->n) {
+		c = iter->set->containers[iter->container];
+
+		if (c->type == ARRAY && iter->pos < c->card)
+			return;
+
+		if (c->type == RUN && iter->pos < c->n)
+			return;
+
+		if (c->type == BITMAP) {
+			while (iter->pos < 65536) {
+				// Mask away the bits below pos in the current word.
+				word = c->bitmap[iter->pos >> 6] & (~(uint64_t)0 << (iter->pos & 63));
+
+				if (word) {
+					iter->pos = (iter->pos & ~63) + __builtin_ctzll(word);
+					return;
+				}
+				iter->pos = (iter->pos & ~63) + 64;
+			}
+		}
+
+		iter->container++;
+		iter->pos = 0;
+		iter->value = 0;
+	}
+}
+
+intset_iter_t *intset_createiter(intset_t *set)
+{
+	intset_iter_t *iter = malloc(sizeof(intset_iter_t));
+
+	if (!iter)
+		ERROR_PRINT("intset_createiter: Malloc failed!\n");
+
+	iter->set = set;
+	iter->container = 0;
+	iter->pos = 0;
+	iter->value = 0;
+	iter_settle(iter);
+
+	return iter;
+}
+
+void intset_destroyiter(intset_iter_t *iter)
+{
+	free(iter);
+}
+
+int intset_hasnext(intset_iter_t *iter)
+{
+	return iter->container < iter->set->n;
+}
+
+unsigned int intset_next(intset_iter_t *iter)
+{
+	container_t *c;
+	unsigned int high, low;
+
+	if (!intset_hasnext(iter))
+		return 0;
+
+	c = iter->set->containers[iter->container];
+	high = (unsigned int)iter->set->keys[iter->container] << 16;
+
+	switch (c->type) {
+	case ARRAY:
+		low = c->array[iter->pos++];
+		break;
+	case BITMAP:
+		low = (unsigned int)iter->pos++;
+		break;
+	default:
+		low = c->runs[iter->pos].start + iter->value;
+		if (low == c->runs[iter->pos].last) {
+			iter->pos++;
+			iter->value = 0;
+		} else {
+			iter->value++;
+		}
+		break;
+	}
+
+	iter_settle(iter);
+	return high | low;
+}
@@ -1,5 +1,6 @@
 /* Author: Steffen Viken Valvaag <steffenv@cs.uit.no> */
 #include "list.h"
+#include "pool.h"
 
 #include <stdlib.h>
 
@@ -18,15 +19,16 @@ struct list {
     listnode_t *tail;
     int size;
     cmpfunc_t cmpfunc;
+    pool_t *pool;
 };
 
 struct list_iter {
     listnode_t *node;
 };
 
-static listnode_t *newnode(void *elem)
+static listnode_t *newnode(list_t *list, void *elem)
 {
-    listnode_t *node = malloc(sizeof(listnode_t));
+    listnode_t *node = pool_alloc(list->pool);
     if (node == NULL)
         return NULL;
     
@@ -42,6 +44,13 @@ list_t *list_create(cmpfunc_t cmpfunc)
     if (list == NULL)
 	    return NULL;
     
+    /* All nodes come from the list's own pool */
+    list->pool = pool_create(sizeof(listnode_t));
+    if (list->pool == NULL) {
+        free(list);
+        return NULL;
+    }
+
     list->head = NULL;
     list->tail = NULL;
     list->size = 0;
@@ -51,12 +60,8 @@ list_t *list_create(cmpfunc_t cmpfunc)
 
 void list_destroy(list_t *list)
 {
-    listnode_t *node = list->head;
-    while (node != NULL) {
-	    listnode_t *tmp = node;
-	    node = node->next;
-	    free(tmp);
-    }
+    /* Frees every node at once */
+    pool_destroy(list->pool);
     free(list);
 }
 
@@ -67,7 +72,7 @@ int list_size(list_t *list)
 
 int list_addfirst(list_t *list, void *elem)
 {
-    listnode_t *node = newnode(elem);
+    listnode_t *node = newnode(list, elem);
     if (node == NULL)
         return 0;
     
@@ -85,7 +90,7 @@ int list_addfirst(list_t *list, void *elem)
 
 int list_addlast(list_t *list, void *elem)
 {
-    listnode_t *node = newnode(elem);
+    listnode_t *node = newnode(list, elem);
     if (node == NULL)
         return 0;
     
@@ -117,7 +122,7 @@ void *list_popfirst(list_t *list)
 	        list->head->prev = NULL;
 	    }
 	    list->size--;
-	    free(tmp);
+	    pool_free(list->pool, tmp);
 	    return elem;
     }
 }
@@ -137,12 +142,34 @@ void *list_poplast(list_t *list)
 	    else {
 	        list->tail->next = NULL;
 	    }
-	    free(tmp);
+	    pool_free(list->pool, tmp);
 	    list->size--;
 	    return elem;
     }
 }
 
+int list_remove(list_t *list, void *elem)
+{
+    listnode_t *node = list->head;
+    while (node != NULL) {
+	    if (list->cmpfunc(elem, node->elem) == 0) {
+	        if (node->prev == NULL)
+		        list->head = node->next;
+	        else
+		        node->prev->next = node->next;
+	        if (node->next == NULL)
+		        list->tail = node->prev;
+	        else
+		        node->next->prev = node->prev;
+	        list->size--;
+	        pool_free(list->pool, node);
+	        return 1;
+	    }
+	    node = node->next;
+    }
+    return 0;
+}
+
 int list_contains(list_t *list, void *elem)
 {
     listnode_t *node = list->head;
@@ -12,6 +12,11 @@ static int compare_ints(void *a, void *b)
     return (*ia)-(*ib);
 }
 
+static unsigned long hash_ints(void *a)
+{
+    return (unsigned long)*(int *)a;
+}
+
 static void *newint(int i)
 {
     int *p = malloc(sizeof(int));
@@ -48,8 +53,8 @@ static void dumpset(char *prefix, set_t *set)
 int main(int argc, char **argv)
 {
     set_t *all, *evens, *odds, *nonprimes, *primes;
-    int i, j, n = 50;
-    int **numbers;
+    int i, j, n = 50, neven = 0, nodd = 0;
+    int **numbers, **evennums, **oddnums;
 
     /* Allocate numbers from 0 to n */
     numbers = (int **) malloc(sizeof(int*) * (n+1));
@@ -57,22 +62,27 @@ int main(int argc, char **argv)
 	    numbers[i] = newint(i);
     }
 
-    /* Create sets */
-    all = set_create(compare_ints);
-    evens = set_create(compare_ints);
-    odds = set_create(compare_ints);
-    nonprimes = set_create(compare_ints);
-    primes = set_create(compare_ints);
-
-    /* Initialize sets */
+    /* Split the numbers into evens and odds, both still in ascending order */
+    evennums = (int **) malloc(sizeof(int*) * (n+1));
+    oddnums = (int **) malloc(sizeof(int*) * (n+1));
     for (i = 0; i <= n; i++) {
-		set_add(all, numbers[i]);
 	    if (i % 2 == 0) {
-	        set_add(evens, numbers[i]);
+	        evennums[neven++] = numbers[i];
 	    }
 	    else {
-	        set_add(odds, numbers[i]);
+	        oddnums[nodd++] = numbers[i];
 	    }
+    }
+
+    /* Create sets, building the ones with known contents in one go */
+    all = set_from_sorted_array(compare_ints, hash_ints, (void **)numbers, n+1);
+    evens = set_from_sorted_array(compare_ints, hash_ints, (void **)evennums, neven);
+    odds = set_from_sorted_array(compare_ints, hash_ints, (void **)oddnums, nodd);
+    nonprimes = set_create_hashed(compare_ints, hash_ints);
+    primes = set_create_hashed(compare_ints, hash_ints);
+
+    /* Initialize sets */
+    for (i = 0; i <= n; i++) {
         if (i < 2) {
             set_add(nonprimes, numbers[i]);
         }
@@ -123,4 +133,6 @@ int main(int argc, char **argv)
 	    free(numbers[i]);
     }
     free(numbers);
+    free(evennums);
+    free(oddnums);
 }
@@ -0,0 +1,137 @@
+/**
+ * @file pool.c
+ * @brief Implementation of a fixed-size object pool.
+ *
+ * Objects are carved out of slabs in the order they are allocated, so
+ * nodes created one after another end up next to each other in memory.
+ * Each slab holds twice as many objects as the one before, up to
+ * SLAB_BYTES, so small lists and trees stay small and large ones need
+ * only about one malloc per SLAB_BYTES of nodes.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include <stdlib.h>
+#include "pool.h"
+
+#define FIRST_SLAB_OBJS 16
+#define SLAB_BYTES (64 * 1024)
+
+/**
+ * @typedef slab
+ * @brief Header of a slab, followed by the objects themselves.
+ *
+ * The union pads the header so that the objects after it are aligned
+ * for any type.
+ */
+typedef union slab {
+	union slab *next;
+	max_align_t align;
+} slab_t;
+
+/**
+ * @typedef freeobj
+ * @brief A freed object, linked into the free list through its own
+ * first bytes.
+ */
+typedef struct freeobj {
+	struct freeobj *next;
+} freeobj_t;
+
+struct pool {
+	size_t objsize;
+	size_t slabobjs;
+	slab_t *slabs;
+	char *cursor;
+	char *end;
+	freeobj_t *freelist;
+};
+
+pool_t *pool_create(size_t objsize)
+{
+	pool_t *pool = malloc(sizeof(pool_t));
+
+	if (!pool)
+		return NULL;
+
+	/*
+	 * Every object must fit a free list link. The size of a type is a
+	 * multiple of its alignment, so rounding up to a multiple of the
+	 * link size keeps both the objects and the links aligned, without
+	 * padding nodes that are already a whole number of pointers.
+	 */
+	objsize = (objsize + sizeof(freeobj_t) - 1) / sizeof(freeobj_t) * sizeof(freeobj_t);
+
+	pool->objsize = objsize;
+	pool->slabobjs = FIRST_SLAB_OBJS;
+	pool->slabs = NULL;
+	pool->cursor = NULL;
+	pool->end = NULL;
+	pool->freelist = NULL;
+
+	return pool;
+}
+
+void pool_destroy(pool_t *pool)
+{
+	slab_t *slab = pool->slabs, *next;
+
+	while (slab) {
+		next = slab->next;
+		free(slab);
+		slab = next;
+	}
+
+	free(pool);
+}
+
+/**
+ * @brief Allocate a new slab and make it the one objects are carved from.
+ *
+ * @param pool
+ * @return 1 on success, 0 if out of memory.
+ */
+static int newslab(pool_t *pool)
+{
+	slab_t *slab = malloc(sizeof(slab_t) + pool->slabobjs * pool->objsize);
+
+	if (!slab)
+		return 0;
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pool->cursor = (char *)(slab + 1);
+	pool->end = pool->cursor + pool->slabobjs * pool->objsize;
+
+	if (pool->slabobjs * pool->objsize * 2 <= SLAB_BYTES)
+		pool->slabobjs *= 2;
+
+	return 1;
+}
+
+void *pool_alloc(pool_t *pool)
+{
+	void *obj;
+
+	if (pool->freelist) {
+		obj = pool->freelist;
+		pool->freelist = pool->freelist->next;
+		return obj;
+	}
+
+	if (pool->cursor == pool->end && !newslab(pool))
+		return NULL;
+
+	obj = pool->cursor;
+	pool->cursor += pool->objsize;
+
+	return obj;
+}
+
+void pool_free(pool_t *pool, void *obj)
+{
+	freeobj_t *node = obj;
+
+	node->next = pool->freelist;
+	pool->freelist = node;
+}
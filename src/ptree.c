@@ -0,0 +1,807 @@
+/**
+ * @file ptree.c
+ * @brief Implementation of a persistent AVL tree, exposing the same
+ * interface as the plain binary search tree in bst.c.
+ *
+ * Trees share nodes. tree_copy hands out a new tree with the same root
+ * in O(1), and every node counts how many parents and trees point to
+ * it. A node that is pointed to more than once must not change, so
+ * tree_add and tree_remove copy each shared node on their path before
+ * writing to it (path copying). Nodes that only one tree can reach are
+ * changed in place, as in any other tree. Changing one of k copies of
+ * a tree therefore allocates O(log n) nodes, and leaves the other
+ * copies as they were.
+ *
+ * The tree is kept balanced as an AVL tree: the heights of the two
+ * subtrees of every node differ by at most one. Rebalancing is done
+ * on the way back up from a change, so it only touches nodes on the
+ * path, plus the sibling that a rotation pulls up.
+ *
+ * Every node also counts the nodes in its subtree, for tree_rank and
+ * tree_select.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include "bst.h"
+#include "common.h"
+#include "pool.h"
+#include "printing.h"
+#include <stdlib.h>
+
+/**
+ * @brief Largest possible height of the tree. An AVL tree of height h
+ * holds at least F(h + 2) - 1 nodes, so this is far more than any
+ * tree that fits in memory can reach.
+ */
+#define MAX_HEIGHT 96
+
+/**
+ * @brief Number of searches tree_find_many runs side by side.
+ */
+#define FIND_GROUP 16
+
+struct node;
+
+/**
+ * @typedef node
+ * @brief Node that stores elements within trees.
+ *
+ */
+typedef struct node node_t;
+
+struct node {
+	void *elem;
+	node_t *left;
+	node_t *right;
+	unsigned int size;
+	int height;
+	int refs;
+};
+
+/**
+ * @brief Pool shared by a tree and every copy made of it, since their
+ * nodes may end up in any of them. The last tree to go destroys it.
+ */
+typedef struct shared {
+	pool_t *pool;
+	int trees;
+} shared_t;
+
+struct tree {
+	node_t *root;
+	size_t size;
+	cmpfunc_t cmp;
+	shared_t *shared;
+};
+
+/**
+ * @brief Get the number of nodes in the subtree below node.
+ */
+static inline unsigned int nodesize(node_t *node)
+{
+	return node ? node->size : 0;
+}
+
+/**
+ * @brief Get the height of the subtree below node.
+ */
+static inline int nodeheight(node_t *node)
+{
+	return node ? node->height : 0;
+}
+
+/**
+ * @brief Recompute the size and height of node from its children.
+ */
+static void update(node_t *node)
+{
+	int lh = nodeheight(node->left), rh = nodeheight(node->right);
+
+	node->size = nodesize(node->left) + nodesize(node->right) + 1;
+	node->height = (lh > rh ? lh : rh) + 1;
+}
+
+/**
+ * @brief Create a new leaf node, referenced once.
+ *
+ * @param tree tree whose pool the node is allocated from.
+ * @param elem
+ * @return node
+ */
+static node_t *newnode(tree_t *tree, void *elem)
+{
+	node_t *node = pool_alloc(tree->shared->pool);
+
+	if (!node)
+		ERROR_PRINT("newnode: Pool allocation failed!\n");
+
+	node->elem = elem;
+	node->left = NULL;
+	node->right = NULL;
+	node->size = 1;
+	node->height = 1;
+	node->refs = 1;
+
+	return node;
+}
+
+/**
+ * @brief Drop one reference to node, and free it along with every
+ * node below it that is no longer referenced.
+ *
+ * @param tree
+ * @param node
+ */
+static void release(tree_t *tree, node_t *node)
+{
+	if (!node || --node->refs > 0)
+		return;
+
+	release(tree, node->left);
+	release(tree, node->right);
+	pool_free(tree->shared->pool, node);
+}
+
+/**
+ * @brief Get a version of node that may be written to, in place of
+ * the reference the caller holds to node.
+ *
+ * A node referenced only once belongs to the caller alone, and is
+ * returned as is. A shared node is copied instead; the copy points to
+ * the same children, which thereby become shared themselves, so the
+ * rest of the path down is copied in turn.
+ *
+ * @param tree
+ * @param node
+ * @return node | copy of node
+ */
+static node_t *writable(tree_t *tree, node_t *node)
+{
+	node_t *copy;
+
+	if (node->refs == 1)
+		return node;
+
+	copy = newnode(tree, node->elem);
+	copy->left = node->left;
+	copy->right = node->right;
+	copy->size = node->size;
+	copy->height = node->height;
+
+	if (copy->left)
+		copy->left->refs++;
+	if (copy->right)
+		copy->right->refs++;
+
+	node->refs--;
+	return copy;
+}
+
+/**
+ * @brief Create an empty tree, with a pool of its own.
+ *
+ * @param cmpfunc comparison function: int (*cmpfunc_t) (void*, void*)
+ * @return tree
+ */
+tree_t *tree_create(cmpfunc_t cmpfunc)
+{
+	tree_t *tree = malloc(sizeof(tree_t));
+
+	if (!tree)
+		ERROR_PRINT("tree_create: Malloc failed!\n");
+
+	tree->shared = malloc(sizeof(shared_t));
+
+	if (!tree->shared)
+		ERROR_PRINT("tree_create: Malloc failed!\n");
+
+	tree->shared->pool = pool_create(sizeof(node_t));
+	tree->shared->trees = 1;
+
+	if (!tree->shared->pool)
+		ERROR_PRINT("tree_create: Pool creation failed!\n");
+
+	tree->cmp = cmpfunc;
+	tree->root = NULL;
+	tree->size = 0;
+
+	return tree;
+}
+
+/**
+ * @brief Delete a tree, and the nodes no other tree shares.
+ *
+ * @param tree
+ */
+void tree_destroy(tree_t *tree)
+{
+	// The last tree of the pool owns every node left in it.
+	if (--tree->shared->trees == 0) {
+		pool_destroy(tree->shared->pool);
+		free(tree->shared);
+	} else {
+		release(tree, tree->root);
+	}
+
+	INFO_PRINT("tree_destroy: All subnodes destroyed.\n");
+	free(tree);
+}
+
+/**
+ * @brief Get the size (number of nodes) in the tree
+ *
+ * @param tree
+ * @return Number of elements in the tree.
+ */
+size_t tree_size(tree_t *tree)
+{
+	return tree->size;
+}
+
+/**
+ * @brief Search tree for a element.
+ *
+ * @param tree
+ * @param elem
+ * @return 1 if element found. 0 otherwise.
+ */
+int tree_find(tree_t *tree, void *elem)
+{
+	node_t *curr = tree->root;
+	int cmpval;
+
+	while (curr) {
+		cmpval = tree->cmp(curr->elem, elem);
+
+		if (cmpval == 0)
+			return 1;
+
+		curr = cmpval > 0 ? curr->left : curr->right;
+	}
+	return 0;
+}
+
+/**
+ * @brief Search the tree for a batch of elements at once. The searches
+ * take turns, one step each, and every step prefetches the node the
+ * search will look at next, so that up to FIND_GROUP nodes are loaded
+ * from memory at the same time.
+ *
+ * @param tree
+ * @param elems elements to search for.
+ * @param n number of elements.
+ * @param found bitmap where bit i is set if elems[i] is found. Other
+ * bits are left as they are.
+ * @return number of elements found.
+ */
+int tree_find_many(tree_t *tree, void **elems, int n, unsigned char *found)
+{
+	node_t *curr[FIND_GROUP];
+	int i, g, size, active, cmpval, count = 0;
+
+	for (g = 0; g < n; g += FIND_GROUP) {
+		size = n - g < FIND_GROUP ? n - g : FIND_GROUP;
+		for (i = 0; i < size; i++)
+			curr[i] = tree->root;
+		active = tree->root ? size : 0;
+
+		while (active > 0) {
+			for (i = 0; i < size; i++) {
+				if (!curr[i])
+					continue;
+
+				cmpval = tree->cmp(curr[i]->elem, elems[g + i]);
+				if (cmpval == 0) {
+					found[(g + i) / 8] |= 1 << ((g + i) % 8);
+					count++;
+					curr[i] = NULL;
+				} else {
+					curr[i] = cmpval > 0 ? curr[i]->left : curr[i]->right;
+				}
+
+				if (curr[i])
+					__builtin_prefetch(curr[i]);
+				else
+					active--;
+			}
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Rotate the subtree rooted at @param node to the left, so
+ * that its right child takes its place. node must be writable.
+ *
+ * @param tree
+ * @param node
+ * @return new root of the subtree
+ */
+static node_t *rotate_left(tree_t *tree, node_t *node)
+{
+	node_t *pivot = writable(tree, node->right);
+
+	node->right = pivot->left;
+	pivot->left = node;
+
+	update(node);
+	update(pivot);
+
+	return pivot;
+}
+
+/**
+ * @brief Rotate the subtree rooted at @param node to the right, so
+ * that its left child takes its place. node must be writable.
+ *
+ * @param tree
+ * @param node
+ * @return new root of the subtree
+ */
+static node_t *rotate_right(tree_t *tree, node_t *node)
+{
+	node_t *pivot = writable(tree, node->left);
+
+	node->left = pivot->right;
+	pivot->right = node;
+
+	update(node);
+	update(pivot);
+
+	return pivot;
+}
+
+/**
+ * @brief Restore the AVL invariant at a writable node whose subtrees
+ * differ in height by at most two, with one or two rotations.
+ *
+ * @param tree
+ * @param node
+ * @return new root of the subtree
+ */
+static node_t *rebalance(tree_t *tree, node_t *node)
+{
+	int balance = nodeheight(node->left) - nodeheight(node->right);
+
+	if (balance > 1) {
+		// Turn an inner left grandchild into an outer one.
+		if (nodeheight(node->left->left) < nodeheight(node->left->right))
+			node->left = rotate_left(tree, writable(tree, node->left));
+		return rotate_right(tree, node);
+	}
+
+	if (balance < -1) {
+		if (nodeheight(node->right->right) < nodeheight(node->right->left))
+			node->right = rotate_right(tree, writable(tree, node->right));
+		return rotate_left(tree, node);
+	}
+
+	update(node);
+	return node;
+}
+
+/**
+ * @brief Add an element that is not in the subtree below node.
+ *
+ * @param tree
+ * @param node
+ * @param elem
+ * @return new root of the subtree
+ */
+static node_t *insert(tree_t *tree, node_t *node, void *elem)
+{
+	if (!node)
+		return newnode(tree, elem);
+
+	node = writable(tree, node);
+
+	if (tree->cmp(node->elem, elem) > 0)
+		node->left = insert(tree, node->left, elem);
+	else
+		node->right = insert(tree, node->right, elem);
+
+	return rebalance(tree, node);
+}
+
+/**
+ * @brief Add a element to the tree. The element must be a void *.
+ *
+ * The tree is searched first, so adding an element that is already
+ * there copies nothing.
+ *
+ * @param tree
+ * @param elem
+ * @return 1 for success; element was added. 2 for element already exist;
+ * the implementation does not allow for duplicate entries.
+ */
+int tree_add(tree_t *tree, void *elem)
+{
+	if (tree_find(tree, elem)) {
+		INFO_PRINT("tree_add: Element already exist.\n");
+		return 2;
+	}
+
+	tree->root = insert(tree, tree->root, elem);
+	tree->size++;
+
+	return 1;
+}
+
+/**
+ * @brief Remove the smallest node of the subtree below node, and hand
+ * back its element.
+ *
+ * @param tree
+ * @param node
+ * @param elem where the element of the removed node is stored.
+ * @return new root of the subtree
+ */
+static node_t *removemin(tree_t *tree, node_t *node, void **elem)
+{
+	node_t *right;
+
+	node = writable(tree, node);
+
+	if (!node->left) {
+		// The parent takes over the reference to the right child.
+		*elem = node->elem;
+		right = node->right;
+		pool_free(tree->shared->pool, node);
+		return right;
+	}
+
+	node->left = removemin(tree, node->left, elem);
+	return rebalance(tree, node);
+}
+
+/**
+ * @brief Remove an element that is in the subtree below node. A node
+ * with two children takes over the element of its successor, which
+ * is removed instead.
+ *
+ * @param tree
+ * @param node
+ * @param elem
+ * @return new root of the subtree
+ */
+static node_t *removenode(tree_t *tree, node_t *node, void *elem)
+{
+	node_t *child;
+	int cmpval;
+
+	node = writable(tree, node);
+	cmpval = tree->cmp(node->elem, elem);
+
+	if (cmpval > 0) {
+		node->left = removenode(tree, node->left, elem);
+	} else if (cmpval < 0) {
+		node->right = removenode(tree, node->right, elem);
+	} else if (node->left && node->right) {
+		node->right = removemin(tree, node->right, &node->elem);
+	} else {
+		child = node->left ? node->left : node->right;
+		pool_free(tree->shared->pool, node);
+		return child;
+	}
+
+	return rebalance(tree, node);
+}
+
+/**
+ * @brief Remove an element from the tree.
+ *
+ * @param tree
+ * @param elem
+ * @return 1 if the element was removed. 0 if it was not in the tree.
+ */
+int tree_remove(tree_t *tree, void *elem)
+{
+	if (!tree_find(tree, elem)) {
+		INFO_PRINT("tree_remove: Element not found.\n");
+		return 0;
+	}
+
+	tree->root = removenode(tree, tree->root, elem);
+	tree->size--;
+
+	return 1;
+}
+
+/* tree_copy shares the nodes instead of copying them. */
+const int tree_cheap_copy = 1;
+
+/**
+ * @brief Create a copy of the tree that shares every node with the
+ * original, in O(1). Either tree copies the nodes it changes later.
+ *
+ * @param tree
+ * @return tree_t *
+ */
+tree_t *tree_copy(tree_t *tree)
+{
+	tree_t *copy = malloc(sizeof(tree_t));
+
+	if (!copy)
+		ERROR_PRINT("tree_copy: Malloc failed!\n");
+
+	copy->root = tree->root;
+	copy->size = tree->size;
+	copy->cmp = tree->cmp;
+	copy->shared = tree->shared;
+
+	if (copy->root)
+		copy->root->refs++;
+	copy->shared->trees++;
+
+	return copy;
+}
+
+/**
+ * @brief Build a perfectly balanced subtree from the sorted elements
+ * elems[0..n), by making the middle element the root and building
+ * both halves recursively.
+ *
+ * @param tree tree being built.
+ * @param elems
+ * @param n
+ * @return node_t *
+ */
+static node_t *nodebuild(tree_t *tree, void **elems, size_t n)
+{
+	if (n == 0)
+		return NULL;
+
+	size_t mid = n / 2;
+	node_t *node = newnode(tree, elems[mid]);
+
+	node->left = nodebuild(tree, elems, mid);
+	node->right = nodebuild(tree, elems + mid + 1, n - mid - 1);
+	update(node);
+
+	return node;
+}
+
+/**
+ * @brief Create a tree from elements that are already sorted in
+ * ascending order and contain no duplicates, in O(n).
+ *
+ * @param cmpfunc comparison function used by the new tree.
+ * @param elems sorted array of elements.
+ * @param n number of elements.
+ * @return tree_t *
+ */
+tree_t *tree_build_sorted(cmpfunc_t cmpfunc, void **elems, size_t n)
+{
+	tree_t *tree = tree_create(cmpfunc);
+
+	tree->root = nodebuild(tree, elems, n);
+	tree->size = n;
+
+	return tree;
+}
+
+/**
+ * @brief Count the elements in the tree that are smaller than elem.
+ *
+ * @param tree
+ * @param elem
+ * @return number of smaller elements.
+ */
+size_t tree_rank(tree_t *tree, void *elem)
+{
+	node_t *curr = tree->root;
+	size_t rank = 0;
+
+	while (curr) {
+		if (tree->cmp(curr->elem, elem) < 0) {
+			rank += nodesize(curr->left) + 1;
+			curr = curr->right;
+		} else {
+			curr = curr->left;
+		}
+	}
+
+	return rank;
+}
+
+/**
+ * @brief Get the element at position k of the tree in ascending
+ * order, counting from 0.
+ *
+ * @param tree
+ * @param k
+ * @return elem | NULL (k is not smaller than the size of the tree)
+ */
+void *tree_select(tree_t *tree, size_t k)
+{
+	node_t *curr = tree->root;
+	size_t left;
+
+	while (curr) {
+		left = nodesize(curr->left);
+
+		if (k == left)
+			return curr->elem;
+
+		if (k < left) {
+			curr = curr->left;
+		} else {
+			k -= left + 1;
+			curr = curr->right;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @typedef Datatype implementation of tree_iter_t.
+ *
+ * Nodes are shared and have no parent pointers, so the iterator keeps
+ * the path of nodes still to visit on a stack of its own. The top of
+ * the stack is the next node.
+ */
+struct tree_iter
+{
+	tree_t *tree;
+	node_t *stack[MAX_HEIGHT];
+	int depth;
+	node_t *end;
+};
+
+/**
+ * @brief Push node and the left spine below it onto the stack.
+ */
+static void pushleft(tree_iter_t *iter, node_t *node)
+{
+	for (; node; node = node->left)
+		iter->stack[iter->depth++] = node;
+}
+
+/**
+ * @brief Fill the stack with the path to the first node whose element
+ * is not smaller than key, keeping only the nodes still to visit.
+ */
+static void pushlowerbound(tree_iter_t *iter, void *key)
+{
+	node_t *curr = iter->tree->root;
+
+	iter->depth = 0;
+
+	while (curr) {
+		if (iter->tree->cmp(curr->elem, key) < 0) {
+			curr = curr->right;
+		} else {
+			iter->stack[iter->depth++] = curr;
+			curr = curr->left;
+		}
+	}
+}
+
+/**
+ * @brief Find the first node whose element is not smaller than key.
+ *
+ * @param tree
+ * @param key
+ * @return node | NULL (every element is smaller than key)
+ */
+static node_t *node_lowerbound(tree_t *tree, void *key)
+{
+	node_t *curr = tree->root, *bound = NULL;
+
+	while (curr) {
+		if (tree->cmp(curr->elem, key) < 0) {
+			curr = curr->right;
+		} else {
+			bound = curr;
+			curr = curr->left;
+		}
+	}
+
+	return bound;
+}
+
+/**
+ * @brief Create a iter to iterate over the input tree.
+ *
+ * @param tree
+ * @return iter
+ */
+tree_iter_t *tree_createiter(tree_t *tree)
+{
+	return tree_createiter_range(tree, NULL, NULL);
+}
+
+/**
+ * @brief Create a iter over the elements in [lo, hi) of the input
+ * tree. The iteration stops at the first node at or past hi.
+ *
+ * @param tree
+ * @param lo smallest element to visit | NULL (from the start)
+ * @param hi bound past the largest element to visit | NULL (to the end)
+ * @return iter
+ */
+tree_iter_t *tree_createiter_range(tree_t *tree, void *lo, void *hi)
+{
+	tree_iter_t *iter = malloc(sizeof(tree_iter_t));
+
+	if (!iter)
+		ERROR_PRINT("tree_createiter: Malloc failed!\n");
+
+	iter->tree = tree;
+	iter->depth = 0;
+	iter->end = hi ? node_lowerbound(tree, hi) : NULL;
+
+	if (lo)
+		pushlowerbound(iter, lo);
+	else
+		pushleft(iter, tree->root);
+
+	if (lo && hi && tree->cmp(lo, hi) >= 0)
+		iter->depth = 0;
+
+	return iter;
+}
+
+/**
+ * @brief Move the iter forward to the first element that is not
+ * smaller than key, by a fresh descent from the root.
+ *
+ * @param iter
+ * @param key
+ */
+void tree_iter_seek(tree_iter_t *iter, void *key)
+{
+	tree_t *tree = iter->tree;
+
+	if (!tree_hasnext(iter) || tree->cmp(iter->stack[iter->depth - 1]->elem, key) >= 0)
+		return;
+
+	if (iter->end && tree->cmp(key, iter->end->elem) >= 0) {
+		iter->depth = 0;
+		return;
+	}
+
+	pushlowerbound(iter, key);
+}
+
+/**
+ * @brief Free the given iter.
+ *
+ * @param iter
+ */
+void tree_destroyiter(tree_iter_t *iter)
+{
+	free(iter);
+}
+
+/**
+ * @brief Check if current iter has a next value.
+ *
+ * @param iter
+ * @return 0 (end of iterator) | 1 (next exist).
+ */
+int tree_hasnext(tree_iter_t *iter)
+{
+	return iter->depth > 0 && iter->stack[iter->depth - 1] != iter->end;
+}
+
+/**
+ * @brief Returns the next element in the tree.
+ *
+ * @param iter
+ * @return elem | NULL (end of iterator)
+ */
+void *tree_next(tree_iter_t *iter)
+{
+	node_t *used;
+
+	if (!tree_hasnext(iter))
+		return NULL;
+
+	used = iter->stack[--iter->depth];
+	pushleft(iter, used->right);
+
+	return used->elem;
+}
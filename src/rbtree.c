@@ -0,0 +1,882 @@
+/**
+ * @file rbtree.c
+ * @brief Implementation of a red-black tree, exposing the same
+ * interface as the plain binary search tree in bst.c.
+ *
+ * The tree is kept balanced by the usual red-black invariants:
+ *  1. Every node is either red or black.
+ *  2. The root is black.
+ *  3. A red node never has a red child.
+ *  4. Every path from a node down to a leaf passes through the
+ *     same number of black nodes.
+ * Together these guarantee a height of at most 2 log2(n + 1), so
+ * tree_add and tree_find stay O(log n) even for sorted input.
+ *
+ * Every node also counts the nodes in its subtree, itself included,
+ * for tree_rank and tree_select. Rotations only need to recompute the
+ * two nodes they move.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include "bst.h"
+#include "common.h"
+#include "pool.h"
+#include "printing.h"
+#include <stdlib.h>
+
+#define COLOR_RED 0
+#define COLOR_BLACK 1
+
+/**
+ * @brief Number of searches tree_find_many runs side by side.
+ */
+#define FIND_GROUP 16
+
+struct node;
+
+/**
+ * @typedef node
+ * @brief Node that stores elements within trees.
+ *
+ */
+typedef struct node node_t;
+
+struct tree {
+	node_t *root;
+	size_t size;
+	cmpfunc_t cmp;
+	pool_t *pool;
+};
+
+struct node {
+	void *elem;
+	node_t *left;
+	node_t *right;
+	node_t *parent;
+	int color;
+	// Fits beside color, so nodes stay the same size.
+	unsigned int size;
+};
+
+/**
+ * @brief Create a new red node.
+ *
+ * @param tree tree whose pool the node is allocated from.
+ * @param elem
+ * @return node
+ */
+static node_t *newnode(tree_t *tree, void *elem)
+{
+	node_t *node = pool_alloc(tree->pool);
+
+	if (!node)
+		ERROR_PRINT("newnode: Pool allocation failed!\n");
+
+	node->elem = elem;
+	node->right = NULL;
+	node->left = NULL;
+	node->parent = NULL;
+	node->color = COLOR_RED;
+	node->size = 1;
+
+	return node;
+}
+
+/**
+ * @brief Get the number of nodes in the subtree below node.
+ *
+ * @param node
+ * @return size | 0 (node is NULL)
+ */
+static inline unsigned int nodesize(node_t *node)
+{
+	return node ? node->size : 0;
+}
+
+/**
+ * @brief Create a red-black tree.
+ *
+ * @param cmpfunc comparison function: int (*cmpfunc_t) (void*, void*)
+ * @return tree
+ */
+tree_t *tree_create(cmpfunc_t cmpfunc)
+{
+	tree_t *tree = malloc(sizeof(tree_t));
+
+	if (!tree)
+		ERROR_PRINT("tree_create: Malloc failed!\n");
+
+	// Every node of the tree is allocated from its own pool.
+	tree->pool = pool_create(sizeof(node_t));
+
+	if (!tree->pool)
+		ERROR_PRINT("tree_create: Pool creation failed!\n");
+
+	tree->cmp = cmpfunc;
+	tree->root = NULL;
+	tree->size = 0;
+
+	return tree;
+}
+
+/**
+ * @brief Delete a tree and all its nodes.
+ *
+ * @param tree
+ */
+void tree_destroy(tree_t *tree)
+{
+	// Every node lives in the pool, so there is no need to visit them.
+	pool_destroy(tree->pool);
+
+	INFO_PRINT("tree_destroy: All subnodes destroyed.\n");
+	free(tree);
+}
+
+/**
+ * @brief Get the size (number of nodes) in the tree
+ *
+ * @param tree
+ * @return Number of elements in the tree.
+ */
+size_t tree_size(tree_t *tree)
+{
+	return tree->size;
+}
+
+/**
+ * @brief Search tree for a element.
+ *
+ * @param tree
+ * @param elem
+ * @return 1 if element found. 0 otherwise.
+ */
+int tree_find(tree_t *tree, void *elem)
+{
+	node_t *curr = tree->root;
+	int cmpval;
+
+	while (curr) {
+		cmpval = tree->cmp(curr->elem, elem);
+
+		if (cmpval == 0)
+			return 1;
+
+		curr = cmpval > 0 ? curr->left : curr->right;
+	}
+	return 0;
+}
+
+/**
+ * @brief Search the tree for a batch of elements at once. The searches
+ * take turns, one step each, and every step prefetches the node the
+ * search will look at next, so that up to FIND_GROUP nodes are loaded
+ * from memory at the same time.
+ *
+ * @param tree
+ * @param elems elements to search for.
+ * @param n number of elements.
+ * @param found bitmap where bit i is set if elems[i] is found. Other
+ * bits are left as they are.
+ * @return number of elements found.
+ */
+int tree_find_many(tree_t *tree, void **elems, int n, unsigned char *found)
+{
+	node_t *curr[FIND_GROUP];
+	int i, g, size, active, cmpval, count = 0;
+
+	for (g = 0; g < n; g += FIND_GROUP) {
+		size = n - g < FIND_GROUP ? n - g : FIND_GROUP;
+		for (i = 0; i < size; i++)
+			curr[i] = tree->root;
+		active = tree->root ? size : 0;
+
+		while (active > 0) {
+			for (i = 0; i < size; i++) {
+				if (!curr[i])
+					continue;
+
+				cmpval = tree->cmp(curr[i]->elem, elems[g + i]);
+				if (cmpval == 0) {
+					found[(g + i) / 8] |= 1 << ((g + i) % 8);
+					count++;
+					curr[i] = NULL;
+				} else {
+					curr[i] = cmpval > 0 ? curr[i]->left : curr[i]->right;
+				}
+
+				if (curr[i])
+					__builtin_prefetch(curr[i]);
+				else
+					active--;
+			}
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Rotate the subtree rooted at @param node to the left, so
+ * that its right child takes its place.
+ *
+ * @param tree
+ * @param node
+ */
+static void rotate_left(tree_t *tree, node_t *node)
+{
+	node_t *pivot = node->right;
+
+	node->right = pivot->left;
+	if (pivot->left)
+		pivot->left->parent = node;
+
+	pivot->parent = node->parent;
+	if (!node->parent)
+		tree->root = pivot;
+	else if (node == node->parent->left)
+		node->parent->left = pivot;
+	else
+		node->parent->right = pivot;
+
+	pivot->left = node;
+	node->parent = pivot;
+
+	// The pivot takes over the whole subtree.
+	pivot->size = node->size;
+	node->size = nodesize(node->left) + nodesize(node->right) + 1;
+}
+
+/**
+ * @brief Rotate the subtree rooted at @param node to the right, so
+ * that its left child takes its place.
+ *
+ * @param tree
+ * @param node
+ */
+static void rotate_right(tree_t *tree, node_t *node)
+{
+	node_t *pivot = node->left;
+
+	node->left = pivot->right;
+	if (pivot->right)
+		pivot->right->parent = node;
+
+	pivot->parent = node->parent;
+	if (!node->parent)
+		tree->root = pivot;
+	else if (node == node->parent->right)
+		node->parent->right = pivot;
+	else
+		node->parent->left = pivot;
+
+	pivot->right = node;
+	node->parent = pivot;
+
+	pivot->size = node->size;
+	node->size = nodesize(node->left) + nodesize(node->right) + 1;
+}
+
+/**
+ * @brief Restore the red-black invariants after @param node has
+ * been inserted as a red leaf.
+ *
+ * While the parent of node is red, invariant 3 is broken. If the
+ * uncle is also red the violation is pushed two levels up by
+ * recoloring; otherwise at most two rotations fix it for good.
+ *
+ * @param tree
+ * @param node
+ */
+static void insert_fixup(tree_t *tree, node_t *node)
+{
+	node_t *parent, *grandparent, *uncle;
+
+	while ((parent = node->parent) && parent->color == COLOR_RED) {
+		// A red parent is never the root, so the grandparent exists.
+		grandparent = parent->parent;
+
+		if (parent == grandparent->left) {
+			uncle = grandparent->right;
+
+			if (uncle && uncle->color == COLOR_RED) {
+				parent->color = COLOR_BLACK;
+				uncle->color = COLOR_BLACK;
+				grandparent->color = COLOR_RED;
+				node = grandparent;
+				continue;
+			}
+
+			// Turn the inner grandchild into an outer one.
+			if (node == parent->right) {
+				rotate_left(tree, parent);
+				node = parent;
+				parent = node->parent;
+			}
+
+			parent->color = COLOR_BLACK;
+			grandparent->color = COLOR_RED;
+			rotate_right(tree, grandparent);
+		} else {
+			uncle = grandparent->left;
+
+			if (uncle && uncle->color == COLOR_RED) {
+				parent->color = COLOR_BLACK;
+				uncle->color = COLOR_BLACK;
+				grandparent->color = COLOR_RED;
+				node = grandparent;
+				continue;
+			}
+
+			if (node == parent->left) {
+				rotate_right(tree, parent);
+				node = parent;
+				parent = node->parent;
+			}
+
+			parent->color = COLOR_BLACK;
+			grandparent->color = COLOR_RED;
+			rotate_left(tree, grandparent);
+		}
+	}
+
+	tree->root->color = COLOR_BLACK;
+}
+
+/**
+ * @brief Add a element to the tree. The element must be a void *.
+ *
+ * @param tree
+ * @param elem
+ * @return 1 for success; element was added. 2 for element already exist;
+ * the implementation does not allow for duplicate entries.
+ */
+int tree_add(tree_t *tree, void *elem)
+{
+	node_t *parent = NULL, *curr = tree->root, *node;
+	int cmpval = 0;
+
+	while (curr) {
+		cmpval = tree->cmp(curr->elem, elem);
+
+		if (cmpval == 0) {
+			INFO_PRINT("tree_add: Element already exist.\n");
+			return 2;
+		}
+
+		parent = curr;
+		curr = cmpval > 0 ? curr->left : curr->right;
+	}
+
+	node = newnode(tree, elem);
+	node->parent = parent;
+
+	if (!parent)
+		tree->root = node;
+	else if (cmpval > 0)
+		parent->left = node;
+	else
+		parent->right = node;
+
+	// Count the new node in every subtree above it, before rotating.
+	for (curr = parent; curr; curr = curr->parent)
+		curr->size++;
+
+	insert_fixup(tree, node);
+	tree->size++;
+
+	return 1;
+}
+
+/**
+ * @brief Get the color of a node, where the empty leaves are black.
+ */
+static int colorof(node_t *node)
+{
+	return node ? node->color : COLOR_BLACK;
+}
+
+/**
+ * @brief Restore the red-black invariants after a black node has been
+ * removed from beneath @param parent, leaving @param node (possibly
+ * empty) in its place.
+ *
+ * The paths through node are one black node short. A red node simply
+ * turns black. Otherwise the sibling is examined: if it and both its
+ * children are black, it turns red, and the shortage moves up to the
+ * parent; in the other cases at most three rotations settle it.
+ *
+ * @param tree
+ * @param node
+ * @param parent
+ */
+static void remove_fixup(tree_t *tree, node_t *node, node_t *parent)
+{
+	node_t *sibling;
+
+	while (node != tree->root && colorof(node) == COLOR_BLACK) {
+		if (node == parent->left) {
+			sibling = parent->right;
+
+			// Make the sibling black, so the cases below apply.
+			if (sibling->color == COLOR_RED) {
+				sibling->color = COLOR_BLACK;
+				parent->color = COLOR_RED;
+				rotate_left(tree, parent);
+				sibling = parent->right;
+			}
+
+			if (colorof(sibling->left) == COLOR_BLACK &&
+			    colorof(sibling->right) == COLOR_BLACK) {
+				sibling->color = COLOR_RED;
+				node = parent;
+				parent = node->parent;
+				continue;
+			}
+
+			// Turn a red inner nephew into a red outer one.
+			if (colorof(sibling->right) == COLOR_BLACK) {
+				sibling->left->color = COLOR_BLACK;
+				sibling->color = COLOR_RED;
+				rotate_right(tree, sibling);
+				sibling = parent->right;
+			}
+
+			sibling->color = parent->color;
+			parent->color = COLOR_BLACK;
+			sibling->right->color = COLOR_BLACK;
+			rotate_left(tree, parent);
+		} else {
+			sibling = parent->left;
+
+			if (sibling->color == COLOR_RED) {
+				sibling->color = COLOR_BLACK;
+				parent->color = COLOR_RED;
+				rotate_right(tree, parent);
+				sibling = parent->left;
+			}
+
+			if (colorof(sibling->left) == COLOR_BLACK &&
+			    colorof(sibling->right) == COLOR_BLACK) {
+				sibling->color = COLOR_RED;
+				node = parent;
+				parent = node->parent;
+				continue;
+			}
+
+			if (colorof(sibling->left) == COLOR_BLACK) {
+				sibling->right->color = COLOR_BLACK;
+				sibling->color = COLOR_RED;
+				rotate_left(tree, sibling);
+				sibling = parent->left;
+			}
+
+			sibling->color = parent->color;
+			parent->color = COLOR_BLACK;
+			sibling->left->color = COLOR_BLACK;
+			rotate_right(tree, parent);
+		}
+
+		break;
+	}
+
+	if (node)
+		node->color = COLOR_BLACK;
+}
+
+/**
+ * @brief Remove an element from the tree.
+ *
+ * A node with two children takes over the element of its successor,
+ * which has at most one child, and the successor is unlinked instead.
+ *
+ * @param tree
+ * @param elem
+ * @return 1 if the element was removed. 0 if it was not in the tree.
+ */
+int tree_remove(tree_t *tree, void *elem)
+{
+	node_t *node = tree->root, *child, *parent, *curr;
+	int cmpval;
+
+	while (node) {
+		cmpval = tree->cmp(node->elem, elem);
+
+		if (cmpval == 0)
+			break;
+
+		node = cmpval > 0 ? node->left : node->right;
+	}
+
+	if (!node)
+		return 0;
+
+	if (node->left && node->right) {
+		node_t *succ = node->right;
+
+		while (succ->left)
+			succ = succ->left;
+
+		node->elem = succ->elem;
+		node = succ;
+	}
+
+	child = node->left ? node->left : node->right;
+	parent = node->parent;
+
+	// The unlinked node leaves every subtree above it.
+	for (curr = parent; curr; curr = curr->parent)
+		curr->size--;
+
+	if (child)
+		child->parent = parent;
+
+	if (!parent)
+		tree->root = child;
+	else if (node == parent->left)
+		parent->left = child;
+	else
+		parent->right = child;
+
+	if (node->color == COLOR_BLACK)
+		remove_fixup(tree, child, parent);
+
+	pool_free(tree->pool, node);
+	tree->size--;
+
+	return 1;
+}
+
+/**
+ * @brief Copies a node and all nodes beneath it, including their
+ * colors, so the copy is balanced exactly like the original.
+ *
+ * @param tree tree the copy belongs to.
+ * @param node
+ * @param parent
+ * @return node_t *
+ */
+static node_t *nodecopy(tree_t *tree, node_t *node, node_t *parent)
+{
+	if (!node)
+		return NULL;
+
+	node_t *copy = newnode(tree, node->elem);
+
+	copy->color = node->color;
+	copy->size = node->size;
+	copy->parent = parent;
+	copy->left = nodecopy(tree, node->left, copy);
+	copy->right = nodecopy(tree, node->right, copy);
+
+	return copy;
+}
+
+/* tree_copy copies every node. */
+const int tree_cheap_copy = 0;
+
+/**
+ * @brief Create a shallow copy of the tree; the nodes are new, but
+ * the elements are shared with the original.
+ *
+ * @param tree
+ * @return tree_t *
+ */
+tree_t *tree_copy(tree_t *tree)
+{
+	tree_t *copy = tree_create(tree->cmp);
+
+	copy->root = nodecopy(copy, tree->root, NULL);
+	copy->size = tree->size;
+
+	return copy;
+}
+
+
+/**
+ * @brief Build a perfectly balanced subtree from the sorted elements
+ * elems[0..n), by making the middle element the root and building
+ * both halves recursively.
+ *
+ * Splitting at the middle fills every level except possibly the
+ * deepest one. Nodes on that level are colored red and all others
+ * black, which gives every path the same number of black nodes.
+ *
+ * @param tree tree being built.
+ * @param elems
+ * @param n
+ * @param parent
+ * @param depth depth of the node being built.
+ * @param reddepth depth of the incomplete level, if any.
+ * @return node_t *
+ */
+static node_t *nodebuild(tree_t *tree, void **elems, size_t n, node_t *parent,
+			 int depth, int reddepth)
+{
+	if (n == 0)
+		return NULL;
+
+	size_t mid = n / 2;
+	node_t *node = newnode(tree, elems[mid]);
+
+	node->color = depth == reddepth ? COLOR_RED : COLOR_BLACK;
+	node->size = n;
+	node->parent = parent;
+	node->left = nodebuild(tree, elems, mid, node, depth + 1, reddepth);
+	node->right = nodebuild(tree, elems + mid + 1, n - mid - 1, node,
+				depth + 1, reddepth);
+
+	return node;
+}
+
+/**
+ * @brief Create a tree from elements that are already sorted in
+ * ascending order and contain no duplicates, in O(n).
+ *
+ * @param cmpfunc comparison function used by the new tree.
+ * @param elems sorted array of elements.
+ * @param n number of elements.
+ * @return tree_t *
+ */
+tree_t *tree_build_sorted(cmpfunc_t cmpfunc, void **elems, size_t n)
+{
+	tree_t *tree = tree_create(cmpfunc);
+	int full = 0;
+
+	// Count the levels that are completely filled: floor(log2(n + 1)).
+	while (((size_t)2 << full) - 1 <= n)
+		full++;
+
+	tree->root = nodebuild(tree, elems, n, NULL, 0, full);
+	tree->size = n;
+
+	return tree;
+}
+
+/**
+ * @brief Count the elements in the tree that are smaller than elem.
+ *
+ * @param tree
+ * @param elem
+ * @return number of smaller elements.
+ */
+size_t tree_rank(tree_t *tree, void *elem)
+{
+	node_t *curr = tree->root;
+	size_t rank = 0;
+
+	while (curr) {
+		if (tree->cmp(curr->elem, elem) < 0) {
+			rank += nodesize(curr->left) + 1;
+			curr = curr->right;
+		} else {
+			curr = curr->left;
+		}
+	}
+
+	return rank;
+}
+
+/**
+ * @brief Get the element at position k of the tree in ascending
+ * order, counting from 0.
+ *
+ * @param tree
+ * @param k
+ * @return elem | NULL (k is not smaller than the size of the tree)
+ */
+void *tree_select(tree_t *tree, size_t k)
+{
+	node_t *curr = tree->root;
+	size_t left;
+
+	while (curr) {
+		left = nodesize(curr->left);
+
+		if (k == left)
+			return curr->elem;
+
+		if (k < left) {
+			curr = curr->left;
+		} else {
+			k -= left + 1;
+			curr = curr->right;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @typedef Datatype implementation of tree_iter_t.
+ *
+ */
+struct tree_iter
+{
+	tree_t *tree;
+	node_t *current;
+	node_t *end;
+};
+
+/**
+ * @brief Get the leftmost node beneath @param root.
+ *
+ * @param root
+ * @return leftmost node.
+ */
+static node_t *node_leftmost(node_t *root)
+{
+	while (root->left)
+		root = root->left;
+
+	return root;
+}
+
+/**
+ * @brief Get the in-order successor of the input node, or NULL if
+ * node is the rightmost node of the tree.
+ *
+ * @param node
+ * @return node
+ */
+static node_t *node_getnext(node_t *node)
+{
+	if (node->right)
+		return node_leftmost(node->right);
+
+	while (node->parent && node == node->parent->right)
+		node = node->parent;
+
+	return node->parent;
+}
+
+/**
+ * @brief Find the first node whose element is not smaller than key.
+ *
+ * @param tree
+ * @param key
+ * @return node | NULL (every element is smaller than key)
+ */
+static node_t *node_lowerbound(tree_t *tree, void *key)
+{
+	node_t *curr = tree->root, *bound = NULL;
+
+	while (curr) {
+		if (tree->cmp(curr->elem, key) < 0) {
+			curr = curr->right;
+		} else {
+			bound = curr;
+			curr = curr->left;
+		}
+	}
+
+	return bound;
+}
+
+/**
+ * @brief Create a iter to iterate over the input tree.
+ *
+ * @param tree
+ * @return iter
+ */
+tree_iter_t *tree_createiter(tree_t *tree)
+{
+	return tree_createiter_range(tree, NULL, NULL);
+}
+
+/**
+ * @brief Create a iter over the elements in [lo, hi) of the input
+ * tree. The iteration stops at the first node at or past hi.
+ *
+ * @param tree
+ * @param lo smallest element to visit | NULL (from the start)
+ * @param hi bound past the largest element to visit | NULL (to the end)
+ * @return iter
+ */
+tree_iter_t *tree_createiter_range(tree_t *tree, void *lo, void *hi)
+{
+	tree_iter_t *iter = malloc(sizeof(tree_iter_t));
+
+	if (!iter)
+		ERROR_PRINT("tree_createiter: Malloc failed!\n");
+
+	iter->tree = tree;
+	iter->end = hi ? node_lowerbound(tree, hi) : NULL;
+
+	if (lo)
+		iter->current = node_lowerbound(tree, lo);
+	else
+		iter->current = tree->root ? node_leftmost(tree->root) : NULL;
+
+	if (iter->current == iter->end || (lo && hi && tree->cmp(lo, hi) >= 0))
+		iter->current = NULL;
+
+	return iter;
+}
+
+/**
+ * @brief Move the iter forward to the first element that is not
+ * smaller than key, by a fresh descent from the root.
+ *
+ * @param iter
+ * @param key
+ */
+void tree_iter_seek(tree_iter_t *iter, void *key)
+{
+	tree_t *tree = iter->tree;
+
+	if (!iter->current || tree->cmp(iter->current->elem, key) >= 0)
+		return;
+
+	if (iter->end && tree->cmp(key, iter->end->elem) >= 0) {
+		iter->current = NULL;
+		return;
+	}
+
+	iter->current = node_lowerbound(tree, key);
+
+	if (iter->current == iter->end)
+		iter->current = NULL;
+}
+
+/**
+ * @brief Free the given iter.
+ *
+ * @param iter
+ */
+void tree_destroyiter(tree_iter_t *iter)
+{
+	free(iter);
+}
+
+/**
+ * @brief Check if current iter has a next value.
+ *
+ * @param iter
+ * @return 0 (end of iterator) | 1 (next exist).
+ */
+int tree_hasnext(tree_iter_t *iter)
+{
+	return iter->current != NULL;
+}
+
+/**
+ * @brief Returns the next element in the tree.
+ *
+ * @param iter
+ * @return elem | NULL (end of iterator)
+ */
+void *tree_next(tree_iter_t *iter)
+{
+	node_t *used = iter->current;
+
+	if (!used)
+		return NULL;
+
+	iter->current = node_getnext(used);
+
+	if (iter->current == iter->end)
+		iter->current = NULL;
+
+	return used->elem;
+}
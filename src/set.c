@@ -2,13 +2,22 @@
 #include "list.h"
 #include "printing.h"
 #include "common.h"
+#include "sort.h"
 
 #include <stdlib.h>
 
+/*
+ * The list is sorted lazily.  The set remembers whether the list is
+ * currently in ascending order, and its largest element.  As long as
+ * elements are added in ascending order the list stays sorted, and
+ * iterating over it needs no list_sort at all.
+ */
 struct set 
 {
     list_t *list;
     cmpfunc_t cmpfunc;
+    int sorted;
+    void *max;
 };
 
 set_t *set_create(cmpfunc_t cmpfunc) 
@@ -20,11 +29,22 @@ set_t *set_create(cmpfunc_t cmpfunc)
     set->list = list_create(cmpfunc);
     set->cmpfunc = cmpfunc;
 
+    /* The empty list is trivially sorted. */
+    set->sorted = 1;
+    set->max = NULL;
+
     INFO_PRINT("set_create: Success.\n");
 
     return set;
 }
 
+set_t *set_create_hashed(cmpfunc_t cmpfunc, hashfunc_t hashfunc)
+{
+    /* The list is searched linearly, so the hash function is of no use. */
+    (void)hashfunc;
+    return set_create(cmpfunc);
+}
+
 void set_destroy(set_t *set) 
 {
 
@@ -42,18 +62,87 @@ int set_size(set_t *set)
     return list_size(set->list);
 }
 
+/*
+ * Appends an element to the list of the set, and keeps track of
+ * whether the list is still sorted.
+ */
+static void set_append(set_t *set, void *elem)
+{
+    if (!list_addlast(set->list, elem)) 
+        ERROR_PRINT("set_add: Not able to insert elem to list!\n");
+
+    if (set->max == NULL || set->cmpfunc(elem, set->max) > 0)
+        set->max = elem;
+    else
+        set->sorted = 0;
+}
+
+set_t *set_from_sorted_array(cmpfunc_t cmpfunc, hashfunc_t hashfunc,
+                             void **elems, int n)
+{
+    set_t *set = set_create_hashed(cmpfunc, hashfunc);
+    int i;
+
+    /* Sorted input is appended as is, skipping repeats of the maximum. */
+    for (i = 0; i < n; i++) {
+        if (set->max == NULL || cmpfunc(elems[i], set->max) != 0)
+            set_append(set, elems[i]);
+    }
+
+    return set;
+}
+
 void set_add(set_t *set, void *elem) 
 {
 
     list_t *list = set->list;
 
-    if (list_contains(list, elem)) {
+    /*
+     * An element larger than the maximum cannot be in the set, so
+     * ascending input skips the linear search altogether.
+     */
+    if (set->max != NULL && set->cmpfunc(elem, set->max) <= 0 &&
+        list_contains(list, elem)) {
         INFO_PRINT("set_add: Elem already exist!\n");
         return;
     }
 
-    if (!list_addlast(list, elem)) 
-        ERROR_PRINT("set_add: Not able to insert elem to list!\n");
+    set_append(set, elem);
+}
+
+int set_remove(set_t *set, void *elem)
+{
+    list_iter_t *iter;
+    void *e;
+
+    if (!list_remove(set->list, elem))
+        return 0;
+
+    /* Removing keeps the list in order, but the maximum may be gone. */
+    if (set->cmpfunc(elem, set->max) == 0) {
+        set->max = NULL;
+
+        iter = list_createiter(set->list);
+        while ((e = list_next(iter)) != NULL) {
+            if (set->max == NULL || set->cmpfunc(e, set->max) > 0)
+                set->max = e;
+        }
+        list_destroyiter(iter);
+    }
+
+    return 1;
+}
+
+/*
+ * Sorts the list of the set, unless it is already sorted.
+ */
+static void set_sort(set_t *set)
+{
+    if (set->sorted)
+        return;
+
+    list_sort(set->list);
+    set->sorted = 1;
 }
 
 int set_contains(set_t *set, void *elem) 
@@ -66,21 +155,114 @@ int set_contains(set_t *set, void *elem)
     return 0;
 }
 
-set_t *set_union(set_t *a, set_t *b)
+/*
+ * Each lookup walks the list anyway, so there is nothing to gain by
+ * interleaving them.
+ */
+int set_contains_many(set_t *set, void **elems, int n, unsigned char *found)
 {
-    void *elem;
-    set_t *new_set = set_copy(a);
-    set_iter_t *iter = set_createiter(b);
+    int i, count = 0;
+
+    memset(found, 0, (n + 7) / 8);
+    for (i = 0; i < n; i++) {
+        if (list_contains(set->list, elems[i])) {
+            found[i / 8] |= 1 << (i % 8);
+            count++;
+        }
+    }
+    return count;
+}
 
-    // iterate over set b adding elements to the copy of a.
-    while (set_hasnext(iter)) {
-        elem = set_next(iter);
+/*
+ * The list has no index, so rank and select walk the sorted list
+ * from the front.
+ */
+int set_rank(set_t *set, void *elem)
+{
+    list_iter_t *iter;
+    void *e;
+    int rank = 0;
+
+    set_sort(set);
+
+    iter = list_createiter(set->list);
+    while ((e = list_next(iter)) != NULL && set->cmpfunc(e, elem) < 0)
+        rank++;
+    list_destroyiter(iter);
 
-        // Duplicates will not be added by default.
-        set_add(new_set, elem);
+    return rank;
+}
+
+void *set_select(set_t *set, int k)
+{
+    list_iter_t *iter;
+    void *e;
+
+    if (k < 0 || k >= set_size(set))
+        return NULL;
+
+    set_sort(set);
+
+    iter = list_createiter(set->list);
+    while ((e = list_next(iter)) != NULL && k-- > 0)
+        ;
+    list_destroyiter(iter);
+
+    return e;
+}
+
+/*
+ * The set operations below are two-finger merges over the sorted
+ * lists of a and b.  Both lists are sorted first, and the fingers
+ * advance past the smaller of the two current elements, so every
+ * operation is one linear pass.  The results are produced in
+ * ascending order, so they are appended without any further
+ * searching, and come out already sorted.
+ */
+set_t *set_union(set_t *a, set_t *b)
+{
+    set_t *new_set = set_create(a->cmpfunc);
+    list_iter_t *ia, *ib;
+    void *ea, *eb;
+    int cmpval;
+
+    set_sort(a);
+    set_sort(b);
+
+    ia = list_createiter(a->list);
+    ib = list_createiter(b->list);
+
+    /* list_next returns NULL once an iterator is exhausted. */
+    ea = list_next(ia);
+    eb = list_next(ib);
+
+    while (ea != NULL && eb != NULL) {
+        cmpval = a->cmpfunc(ea, eb);
+
+        if (cmpval < 0) {
+            set_append(new_set, ea);
+            ea = list_next(ia);
+        }
+        else if (cmpval > 0) {
+            set_append(new_set, eb);
+            eb = list_next(ib);
+        }
+        else {
+            /* Present in both, keep the element from a. */
+            set_append(new_set, ea);
+            ea = list_next(ia);
+            eb = list_next(ib);
+        }
     }
 
-    set_destroyiter(iter);
+    /* At most one of the lists has elements left. */
+    for (; ea != NULL; ea = list_next(ia))
+        set_append(new_set, ea);
+    for (; eb != NULL; eb = list_next(ib))
+        set_append(new_set, eb);
+
+    list_destroyiter(ia);
+    list_destroyiter(ib);
 
 	INFO_PRINT("set_union: Created a union set.\n");
     return new_set;
@@ -88,25 +270,39 @@ set_t *set_union(set_t *a, set_t *b)
 
 set_t *set_intersection(set_t *a, set_t *b) 
 {
-    /* Create a new set which will be the intersection set. */
     set_t *new_set = set_create(a->cmpfunc);
-
-    set_iter_t *iter = set_createiter(a);
-    void *elem;
-
-    /*
-     * As we want to find overlaps between a and b,
-     * we only need to iterate over one of them, 
-     * and see which elements from one is in the other. 
-     */
-    while (set_hasnext(iter)) {
-        elem = set_next(iter);
-
-        if (set_contains(b, elem))
-            set_add(new_set, elem);
+    list_iter_t *ia, *ib;
+    void *ea, *eb;
+    int cmpval;
+
+    set_sort(a);
+    set_sort(b);
+
+    ia = list_createiter(a->list);
+    ib = list_createiter(b->list);
+
+    ea = list_next(ia);
+    eb = list_next(ib);
+
+    /* Elements left over in either list cannot be in both. */
+    while (ea != NULL && eb != NULL) {
+        cmpval = a->cmpfunc(ea, eb);
+
+        if (cmpval < 0) {
+            ea = list_next(ia);
+        }
+        else if (cmpval > 0) {
+            eb = list_next(ib);
+        }
+        else {
+            set_append(new_set, ea);
+            ea = list_next(ia);
+            eb = list_next(ib);
+        }
     }
 
-    set_destroyiter(iter);
+    list_destroyiter(ia);
+    list_destroyiter(ib);
 
 	INFO_PRINT("set_intersection: Created a intersection set.\n");
     return new_set;
@@ -115,24 +311,88 @@ set_t *set_intersection(set_t *a, set_t *b)
 set_t *set_difference(set_t *a, set_t *b)
 {
     set_t *new_set = set_create(a->cmpfunc);
-
-    set_iter_t *iter = set_createiter(a);
-    void *elem;
-
-    while (set_hasnext(iter)) {
-        elem = set_next(iter);
-
-        /* Negated the logic from set_intersection. */
-        if (!set_contains(b, elem))
-            set_add(new_set, elem);
+    list_iter_t *ia, *ib;
+    void *ea, *eb;
+    int cmpval;
+
+    set_sort(a);
+    set_sort(b);
+
+    ia = list_createiter(a->list);
+    ib = list_createiter(b->list);
+
+    ea = list_next(ia);
+    eb = list_next(ib);
+
+    while (ea != NULL && eb != NULL) {
+        cmpval = a->cmpfunc(ea, eb);
+
+        if (cmpval < 0) {
+            set_append(new_set, ea);
+            ea = list_next(ia);
+        }
+        else if (cmpval > 0) {
+            eb = list_next(ib);
+        }
+        else {
+            /* Negated the logic from set_intersection. */
+            ea = list_next(ia);
+            eb = list_next(ib);
+        }
     }
 
-    set_destroyiter(iter);
+    /* Whatever is left of a is not in b. */
+    for (; ea != NULL; ea = list_next(ia))
+        set_append(new_set, ea);
+
+    list_destroyiter(ia);
+    list_destroyiter(ib);
 
     INFO_PRINT("set_difference: Created a difference set.\n");
     return new_set;
 }
 
+/*
+ * Moves the contents of other into set, and destroys other along
+ * with the old contents of set.
+ */
+static void set_replace(set_t *set, set_t *other)
+{
+    list_t *list = set->list;
+
+    set->list = other->list;
+    set->sorted = other->sorted;
+    set->max = other->max;
+
+    other->list = list;
+    set_destroy(other);
+}
+
+/*
+ * Removing from or inserting into the middle of a list means a linear
+ * search per element, so the in-place operations merge into a new list
+ * instead, and swap it in for the old one.
+ */
+void set_union_into(set_t *a, set_t *b)
+{
+    set_replace(a, set_union(a, b));
+}
+
+void set_intersect_into(set_t *a, set_t *b)
+{
+    set_replace(a, set_intersection(a, b));
+}
+
+void set_add_all(set_t *set, void **elems, int n)
+{
+    void **sorted = sorted_copy(elems, &n, set->cmpfunc);
+    set_t *other = set_from_sorted_array(set->cmpfunc, NULL, sorted, n);
+
+    set_replace(set, set_union(set, other));
+    set_destroy(other);
+    free(sorted);
+}
+
 set_t *set_copy(set_t *set)
 {
     set_t *copy = set_create(set->cmpfunc);
@@ -152,7 +412,7 @@ set_t *set_copy(set_t *set)
     void *elem;
     while (set_hasnext(iter)) {
         elem = set_next(iter);
-        list_addlast(copy->list, elem);
+        set_append(copy, elem);
     }
 
     set_destroyiter(iter);
@@ -163,17 +423,45 @@ set_t *set_copy(set_t *set)
 struct set_iter 
 {
     list_iter_t *list_iter;
+    cmpfunc_t cmpfunc;
+    void *next;     /* The element set_next returns next, or NULL. */
+    void *hi;
 };
 
+/*
+ * Steps the list iterator one element on, and ends the iteration at
+ * the upper bound of the range.
+ */
+static void set_advance(set_iter_t *iter)
+{
+    iter->next = list_next(iter->list_iter);
+
+    if (iter->next != NULL && iter->hi != NULL &&
+        iter->cmpfunc(iter->next, iter->hi) >= 0)
+        iter->next = NULL;
+}
+
 set_iter_t *set_createiter(set_t *set) 
+{
+    return set_createiter_range(set, NULL, NULL);
+}
+
+set_iter_t *set_createiter_range(set_t *set, void *lo, void *hi)
 {
     set_iter_t *iter = malloc(sizeof(set_iter_t));
     
     if (!iter) ERROR_PRINT("set_createiter: Malloc failed!\n");
     
-    list_sort(set->list);
+    set_sort(set);
 
     iter->list_iter = list_createiter(set->list);
+    iter->cmpfunc = set->cmpfunc;
+    iter->hi = hi;
+    set_advance(iter);
+
+    /* A list has no shortcut to the start of the range. */
+    if (lo != NULL)
+        set_iter_seek(iter, lo);
 
     INFO_PRINT("set_createiter: Success.\n");
     return iter;
@@ -188,12 +476,23 @@ void set_destroyiter(set_iter_t *iter)
 
 int set_hasnext(set_iter_t *iter) 
 {
-    return list_hasnext(iter->list_iter);
+    return iter->next != NULL;
 }
 
 void *set_next(set_iter_t *iter)
 {
-    return list_next(iter->list_iter);
+    void *elem = iter->next;
+
+    if (elem != NULL)
+        set_advance(iter);
+
+    return elem;
+}
+
+void set_iter_seek(set_iter_t *iter, void *key)
+{
+    while (iter->next != NULL && iter->cmpfunc(iter->next, key) < 0)
+        set_advance(iter);
 }
 
 static void printset(char *name, set_t *set) 
@@ -0,0 +1,493 @@
+/**
+ * @file set_array.c
+ * @brief Implementation of set as a sorted array of elements.
+ *
+ * All elements live in one contiguous array that is kept sorted at
+ * all times. set_contains is a binary search, and union, intersection
+ * and difference are single merge passes over both arrays, so they
+ * run in O(n + m) without allocating anything per element. set_add
+ * has to shift the tail of the array, which makes it O(n); this
+ * backend suits sets that are built once and queried many times.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include <stdlib.h>
+#include "common.h"
+#include "set.h"
+#include "sort.h"
+#include "printing.h"
+
+#define INITIAL_CAPACITY 16
+
+/*
+ * Number of binary searches set_contains_many runs side by side.
+ */
+#define SEARCH_GROUP 16
+
+struct set
+{
+	void **elems;
+	int size;
+	int capacity;
+	cmpfunc_t cmpfunc;
+};
+
+/**
+ * @brief Create an empty set with room for capacity elements.
+ *
+ * @param cmpfunc
+ * @param capacity
+ * @return set
+ */
+static set_t *newset(cmpfunc_t cmpfunc, int capacity)
+{
+	set_t *set = malloc(sizeof(set_t));
+
+	if (!set)
+		ERROR_PRINT("set_create: Malloc failed!\n");
+
+	if (capacity < INITIAL_CAPACITY)
+		capacity = INITIAL_CAPACITY;
+
+	set->elems = malloc(capacity * sizeof(void *));
+
+	if (!set->elems)
+		ERROR_PRINT("set_create: Malloc failed!\n");
+
+	set->size = 0;
+	set->capacity = capacity;
+	set->cmpfunc = cmpfunc;
+
+	return set;
+}
+
+/**
+ * @brief Find the position of the first element that is not smaller
+ * than elem, i.e. where elem is or would be inserted.
+ *
+ * @param set
+ * @param elem
+ * @return index in [0, size]
+ */
+static int lowerbound(set_t *set, void *elem)
+{
+	int lo = 0, hi = set->size, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (set->cmpfunc(set->elems[mid], elem) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * @brief Find the position of the first element at or after from that
+ * is not smaller than elem, by galloping: probe from + 1, from + 2,
+ * from + 4, ... until an element is not smaller, and binary search the
+ * last step. This costs O(log d) for a distance d, so skipping ahead
+ * in a large array is cheap however far the target is.
+ *
+ * @param set
+ * @param from
+ * @param elem
+ * @return index in [from, size]
+ */
+static int gallop(set_t *set, int from, void *elem)
+{
+	int lo = from, hi, mid, step = 1;
+
+	if (lo >= set->size || set->cmpfunc(set->elems[lo], elem) >= 0)
+		return lo;
+
+	// elems[lo] is smaller than elem throughout.
+	for (;;) {
+		hi = lo + step;
+
+		if (hi >= set->size) {
+			hi = set->size;
+			break;
+		}
+		if (set->cmpfunc(set->elems[hi], elem) >= 0)
+			break;
+
+		lo = hi;
+		step *= 2;
+	}
+
+	lo++;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (set->cmpfunc(set->elems[mid], elem) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * @brief Append an element that is larger than all elements in set.
+ *
+ * @param set
+ * @param elem
+ */
+static void append(set_t *set, void *elem)
+{
+	if (set->size == set->capacity) {
+		set->capacity *= 2;
+		set->elems = realloc(set->elems, set->capacity * sizeof(void *));
+
+		if (!set->elems)
+			ERROR_PRINT("append: Realloc failed!\n");
+	}
+
+	set->elems[set->size++] = elem;
+}
+
+set_t *set_create(cmpfunc_t cmpfunc)
+{
+	return newset(cmpfunc, INITIAL_CAPACITY);
+}
+
+set_t *set_create_hashed(cmpfunc_t cmpfunc, hashfunc_t hashfunc)
+{
+	// The array is ordered by comparisons only.
+	(void)hashfunc;
+	return set_create(cmpfunc);
+}
+
+set_t *set_from_sorted_array(cmpfunc_t cmpfunc, hashfunc_t hashfunc,
+                             void **elems, int n)
+{
+	set_t *set = newset(cmpfunc, n);
+	int i;
+
+	(void)hashfunc;
+
+	for (i = 0; i < n; i++) {
+		if (set->size == 0 || cmpfunc(set->elems[set->size - 1], elems[i]) != 0)
+			set->elems[set->size++] = elems[i];
+	}
+
+	return set;
+}
+
+void set_destroy(set_t *set)
+{
+	free(set->elems);
+	free(set);
+	INFO_PRINT("set_destroy: Set successfully destroyed.\n");
+}
+
+int set_size(set_t *set)
+{
+	return set->size;
+}
+
+void set_add(set_t *set, void *elem)
+{
+	int pos;
+
+	// Elements often arrive in ascending order; skip the search then.
+	if (set->size == 0 || set->cmpfunc(set->elems[set->size - 1], elem) < 0) {
+		append(set, elem);
+		return;
+	}
+
+	pos = lowerbound(set, elem);
+
+	if (set->cmpfunc(set->elems[pos], elem) == 0) {
+		INFO_PRINT("set_add: Elem already exist!\n");
+		return;
+	}
+
+	// Make room at the end, then shift the tail one step right.
+	append(set, NULL);
+	memmove(&set->elems[pos + 1], &set->elems[pos],
+		(set->size - 1 - pos) * sizeof(void *));
+	set->elems[pos] = elem;
+}
+
+int set_remove(set_t *set, void *elem)
+{
+	int pos = lowerbound(set, elem);
+
+	if (pos == set->size || set->cmpfunc(set->elems[pos], elem) != 0)
+		return 0;
+
+	// Shift the tail one step left over the removed element.
+	memmove(&set->elems[pos], &set->elems[pos + 1],
+		(set->size - 1 - pos) * sizeof(void *));
+	set->size--;
+
+	return 1;
+}
+
+int set_contains(set_t *set, void *elem)
+{
+	int pos = lowerbound(set, elem);
+
+	return pos < set->size && set->cmpfunc(set->elems[pos], elem) == 0;
+}
+
+/*
+ * Searches in a group run in lockstep. Every search over the same
+ * array halves the same lengths, so after each step the positions
+ * all searches probe next are known, and are prefetched before any
+ * search takes its next step.
+ */
+int set_contains_many(set_t *set, void **elems, int n, unsigned char *found)
+{
+	int base[SEARCH_GROUP];
+	int j, g, size, len, half, count = 0;
+
+	memset(found, 0, (n + 7) / 8);
+	if (set->size == 0)
+		return 0;
+
+	for (g = 0; g < n; g += SEARCH_GROUP) {
+		size = n - g < SEARCH_GROUP ? n - g : SEARCH_GROUP;
+
+		for (j = 0; j < size; j++)
+			base[j] = 0;
+
+		/*
+		 * Each step keeps the elements from base on that may be the
+		 * first one not smaller, and the last of them if all are
+		 * smaller. The step after probes base + (len - half) / 2 - 1.
+		 */
+		for (len = set->size; len > 1; len -= half) {
+			half = len / 2;
+
+			for (j = 0; j < size; j++) {
+				if (set->cmpfunc(set->elems[base[j] + half - 1], elems[g + j]) < 0)
+					base[j] += half;
+				if (len - half > 1)
+					__builtin_prefetch(&set->elems[base[j] + (len - half) / 2 - 1]);
+			}
+		}
+
+		for (j = 0; j < size; j++) {
+			if (set->cmpfunc(set->elems[base[j]], elems[g + j]) == 0) {
+				found[(g + j) / 8] |= 1 << ((g + j) % 8);
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+int set_rank(set_t *set, void *elem)
+{
+	return lowerbound(set, elem);
+}
+
+void *set_select(set_t *set, int k)
+{
+	if (k < 0 || k >= set->size)
+		return NULL;
+
+	return set->elems[k];
+}
+
+set_t *set_union(set_t *a, set_t *b)
+{
+	set_t *new_set = newset(a->cmpfunc, a->size + b->size);
+	int i = 0, j = 0, cmpval;
+
+	while (i < a->size && j < b->size) {
+		cmpval = a->cmpfunc(a->elems[i], b->elems[j]);
+
+		if (cmpval < 0) {
+			new_set->elems[new_set->size++] = a->elems[i++];
+		} else if (cmpval > 0) {
+			new_set->elems[new_set->size++] = b->elems[j++];
+		} else {
+			new_set->elems[new_set->size++] = a->elems[i++];
+			j++;
+		}
+	}
+
+	while (i < a->size)
+		new_set->elems[new_set->size++] = a->elems[i++];
+	while (j < b->size)
+		new_set->elems[new_set->size++] = b->elems[j++];
+
+	INFO_PRINT("set_union: Created a union set.\n");
+	return new_set;
+}
+
+/*
+ * When one set is more than GALLOP_RATIO times larger than the other,
+ * the intersections gallop through the larger one instead of stepping
+ * through it, which costs O(m log(n / m)) for m elements against n.
+ */
+#define GALLOP_RATIO 16
+
+set_t *set_intersection(set_t *a, set_t *b)
+{
+	set_t *new_set = newset(a->cmpfunc, a->size < b->size ? a->size : b->size);
+	int gallop_a = a->size > b->size * GALLOP_RATIO;
+	int gallop_b = b->size > a->size * GALLOP_RATIO;
+	int i = 0, j = 0, cmpval;
+
+	while (i < a->size && j < b->size) {
+		cmpval = a->cmpfunc(a->elems[i], b->elems[j]);
+
+		if (cmpval < 0) {
+			i = gallop_a ? gallop(a, i, b->elems[j]) : i + 1;
+		} else if (cmpval > 0) {
+			j = gallop_b ? gallop(b, j, a->elems[i]) : j + 1;
+		} else {
+			new_set->elems[new_set->size++] = a->elems[i++];
+			j++;
+		}
+	}
+
+	INFO_PRINT("set_intersection: Created a intersection set.\n");
+	return new_set;
+}
+
+set_t *set_difference(set_t *a, set_t *b)
+{
+	set_t *new_set = newset(a->cmpfunc, a->size);
+	int i = 0, j = 0, cmpval;
+
+	while (i < a->size && j < b->size) {
+		cmpval = a->cmpfunc(a->elems[i], b->elems[j]);
+
+		if (cmpval < 0) {
+			new_set->elems[new_set->size++] = a->elems[i++];
+		} else if (cmpval > 0) {
+			j++;
+		} else {
+			i++;
+			j++;
+		}
+	}
+
+	while (i < a->size)
+		new_set->elems[new_set->size++] = a->elems[i++];
+
+	INFO_PRINT("set_difference: Created a difference set.\n");
+	return new_set;
+}
+
+void set_union_into(set_t *a, set_t *b)
+{
+	set_t *merged = set_union(a, b);
+	void **elems = a->elems;
+
+	// Take over the merged array, and let the old one go with merged.
+	a->elems = merged->elems;
+	a->size = merged->size;
+	a->capacity = merged->capacity;
+
+	merged->elems = elems;
+	set_destroy(merged);
+}
+
+void set_intersect_into(set_t *a, set_t *b)
+{
+	int gallop_a = a->size > b->size * GALLOP_RATIO;
+	int gallop_b = b->size > a->size * GALLOP_RATIO;
+	int i = 0, j = 0, n = 0, cmpval;
+
+	// The kept elements are written over a from the front, in order.
+	while (i < a->size && j < b->size) {
+		cmpval = a->cmpfunc(a->elems[i], b->elems[j]);
+
+		if (cmpval < 0) {
+			i = gallop_a ? gallop(a, i, b->elems[j]) : i + 1;
+		} else if (cmpval > 0) {
+			j = gallop_b ? gallop(b, j, a->elems[i]) : j + 1;
+		} else {
+			a->elems[n++] = a->elems[i++];
+			j++;
+		}
+	}
+
+	a->size = n;
+}
+
+void set_add_all(set_t *set, void **elems, int n)
+{
+	void **sorted = sorted_copy(elems, &n, set->cmpfunc);
+	set_t other = { sorted, n, n, set->cmpfunc };
+
+	// The sorted copy already is a valid array set; merge it in.
+	set_union_into(set, &other);
+	free(sorted);
+}
+
+set_t *set_copy(set_t *set)
+{
+	set_t *copy = newset(set->cmpfunc, set->size);
+
+	memcpy(copy->elems, set->elems, set->size * sizeof(void *));
+	copy->size = set->size;
+
+	INFO_PRINT("set_copy: Created a set copy.\n");
+	return copy;
+}
+
+
+struct set_iter
+{
+	set_t *set;
+	int next;
+	int end;	// -1 runs to the end of the array, wherever it is
+};
+
+set_iter_t *set_createiter(set_t *set)
+{
+	return set_createiter_range(set, NULL, NULL);
+}
+
+set_iter_t *set_createiter_range(set_t *set, void *lo, void *hi)
+{
+	set_iter_t *iter = malloc(sizeof(set_iter_t));
+
+	if (!iter)
+		ERROR_PRINT("set_createiter: Malloc failed!\n");
+
+	iter->set = set;
+	iter->next = lo ? lowerbound(set, lo) : 0;
+	iter->end = hi ? lowerbound(set, hi) : -1;
+
+	INFO_PRINT("set_createiter: Successfully created a set iterator.\n");
+	return iter;
+}
+
+void set_destroyiter(set_iter_t *iter)
+{
+	free(iter);
+	INFO_PRINT("set_destroyiter: Successfully destroyed set.\n");
+}
+
+int set_hasnext(set_iter_t *iter)
+{
+	return iter->next < (iter->end < 0 ? iter->set->size : iter->end);
+}
+
+void *set_next(set_iter_t *iter)
+{
+	if (!set_hasnext(iter))
+		return NULL;
+
+	return iter->set->elems[iter->next++];
+}
+
+void set_iter_seek(set_iter_t *iter, void *key)
+{
+	iter->next = gallop(iter->set, iter->next, key);
+}
@@ -1,7 +1,9 @@
 #include <stdlib.h>
+#include <string.h>
 #include "bst.h"
 #include "common.h"
 #include "set.h"
+#include "sort.h"
 #include "printing.h"
 
 struct set
@@ -24,6 +26,13 @@ set_t *set_create(cmpfunc_t cmpfunc)
 	return set;
 }
 
+set_t *set_create_hashed(cmpfunc_t cmpfunc, hashfunc_t hashfunc)
+{
+	// The tree is ordered by comparisons only.
+	(void)hashfunc;
+	return set_create(cmpfunc);
+}
+
 void set_destroy(set_t *set)
 {
 	tree_destroy(set->tree);
@@ -44,27 +53,170 @@ void set_add(set_t *set, void *elem)
 
 
 
+int set_remove(set_t *set, void *elem)
+{
+	return tree_remove(set->tree, elem);
+}
+
+
+
 int set_contains(set_t *set, void *elem)
 {
 	return tree_find(set->tree, elem);
 }
 
-set_t *set_union(set_t *a, set_t *b)
+/*
+ * The searches are interleaved in tree_find_many, so the nodes of
+ * many searches are fetched from memory at the same time.
+ */
+int set_contains_many(set_t *set, void **elems, int n, unsigned char *found)
+{
+	memset(found, 0, (n + 7) / 8);
+	return tree_find_many(set->tree, elems, n, found);
+}
+
+int set_rank(set_t *set, void *elem)
+{
+	return (int)tree_rank(set->tree, elem);
+}
+
+
+
+void *set_select(set_t *set, int k)
+{
+	if (k < 0)
+		return NULL;
+
+	return tree_select(set->tree, (size_t)k);
+}
+
+/*
+ * Wraps an existing tree in a new set.
+ */
+static set_t *set_fromtree(cmpfunc_t cmpfunc, tree_t *tree)
+{
+	set_t *set = malloc(sizeof(set_t));
+
+	if (!set)
+		ERROR_PRINT("set_fromtree: Malloc failed!\n");
+
+	set->tree = tree;
+	set->cmpfunc = cmpfunc;
+
+	return set;
+}
+
+/*
+ * Allocates room for the output of a set operation, which holds at
+ * most n elements.
+ */
+static void **newbuffer(size_t n)
 {
-	void *elem;
-	set_t *new_set = set_copy(a);
+	// Always allocate at least one slot, so empty results are valid.
+	void **buf = malloc((n + 1) * sizeof(void *));
+
+	if (!buf)
+		ERROR_PRINT("newbuffer: Malloc failed!\n");
 
-	set_iter_t *iter = set_createiter(b);
+	return buf;
+}
+
+/*
+ * When one set is more than SEEK_RATIO times larger than the other,
+ * the set operations below avoid walking all of the larger one. The
+ * intersection seeks through it instead of stepping through it. Each
+ * seek is a descent from the root, so that costs O(m log n) for the m
+ * elements of the smaller set, rather than O(n + m). Union and
+ * difference start from a copy of the larger set and patch it, which
+ * is O(m log n) on top of tree_copy. That only pays off when
+ * tree_cheap_copy is set, as for the persistent tree. Otherwise the
+ * copy alone is O(n), and the patched tree is no longer perfectly
+ * balanced, so they merge like for sets of similar size.
+ */
+#define SEEK_RATIO 16
+
+
+/*
+ * Copies base, and applies op, tree_add or tree_remove, with every
+ * element of patch.
+ */
+static set_t *set_patch(set_t *base, set_t *patch, int (*op)(tree_t *, void *))
+{
+	tree_t *tree = tree_copy(base->tree);
+	tree_iter_t *iter = tree_createiter(patch->tree);
 
-	while (set_hasnext(iter)) {
-		elem = set_next(iter);
+	while (tree_hasnext(iter))
+		op(tree, tree_next(iter));
 
-		// Does not need to check if element exist as
-		// that will be handled by set_add.
-		set_add(new_set, elem);
+	tree_destroyiter(iter);
+	return set_fromtree(base->cmpfunc, tree);
+}
+
+
+/*
+ * Adds elem to tree, replacing an equal element that is already there.
+ */
+static int tree_replace(tree_t *tree, void *elem)
+{
+	tree_remove(tree, elem);
+	return tree_add(tree, elem);
+}
+
+
+/*
+ * The set operations below merge the in-order iterators of a and b,
+ * writing the result to a sorted buffer in O(n + m). The result tree
+ * is then built directly from that buffer with tree_build_sorted, so
+ * it comes out perfectly balanced instead of degenerating the way
+ * repeated tree_add in sorted order would.
+ */
+set_t *set_union(set_t *a, set_t *b)
+{
+	size_t sa = tree_size(a->tree), sb = tree_size(b->tree);
+
+	// The union holds the elements of a where both have one.
+	if (tree_cheap_copy && sa > sb * SEEK_RATIO)
+		return set_patch(a, b, tree_add);
+	if (tree_cheap_copy && sb > sa * SEEK_RATIO)
+		return set_patch(b, a, tree_replace);
+
+	tree_iter_t *ia = tree_createiter(a->tree), *ib = tree_createiter(b->tree);
+	void **buf = newbuffer(sa + sb);
+	void *ea, *eb;
+	size_t n = 0;
+	int cmpval;
+
+	// tree_next returns NULL once an iterator is exhausted.
+	ea = tree_next(ia);
+	eb = tree_next(ib);
+
+	while (ea && eb) {
+		cmpval = a->cmpfunc(ea, eb);
+
+		if (cmpval < 0) {
+			buf[n++] = ea;
+			ea = tree_next(ia);
+		} else if (cmpval > 0) {
+			buf[n++] = eb;
+			eb = tree_next(ib);
+		} else {
+			// Present in both, keep the element from a.
+			buf[n++] = ea;
+			ea = tree_next(ia);
+			eb = tree_next(ib);
+		}
 	}
 
-	set_destroyiter(iter);
+	for (; ea; ea = tree_next(ia))
+		buf[n++] = ea;
+	for (; eb; eb = tree_next(ib))
+		buf[n++] = eb;
+
+	tree_destroyiter(ia);
+	tree_destroyiter(ib);
+
+	set_t *new_set = set_fromtree(a->cmpfunc, tree_build_sorted(a->cmpfunc, buf, n));
+	free(buf);
 
 	INFO_PRINT("set_union: Created a union set.\n");
 	return new_set;
@@ -73,22 +225,42 @@ set_t *set_union(set_t *a, set_t *b)
 
 set_t *set_intersection(set_t *a, set_t *b)
 {
-	set_t *new_set = set_create(a->cmpfunc);
-
-	set_iter_t *iter = set_createiter(b);
-	void *elem;
+	tree_iter_t *ia = tree_createiter(a->tree), *ib = tree_createiter(b->tree);
+	size_t sa = tree_size(a->tree), sb = tree_size(b->tree);
+	void **buf = newbuffer(sa < sb ? sa : sb);
+	int seek_a = sa > sb * SEEK_RATIO, seek_b = sb > sa * SEEK_RATIO;
+	void *ea, *eb;
+	size_t n = 0;
+	int cmpval;
+
+	ea = tree_next(ia);
+	eb = tree_next(ib);
+
+	// Once one side runs out, nothing else can be in both.
+	while (ea && eb) {
+		cmpval = a->cmpfunc(ea, eb);
+
+		if (cmpval < 0) {
+			// Everything in a before eb is missing from b.
+			if (seek_a)
+				tree_iter_seek(ia, eb);
+			ea = tree_next(ia);
+		} else if (cmpval > 0) {
+			if (seek_b)
+				tree_iter_seek(ib, ea);
+			eb = tree_next(ib);
+		} else {
+			buf[n++] = ea;
+			ea = tree_next(ia);
+			eb = tree_next(ib);
+		}
+	}
 
-    /*
-     * As we want to find overlaps between a and b,
-     * we only need to iterate over one of them, 
-     * and see which elements from one is in the other. 
-     */
-	while (set_hasnext(iter)) {
-		elem = set_next(iter);
+	tree_destroyiter(ia);
+	tree_destroyiter(ib);
 
-		if (set_contains(a, elem))
-			set_add(new_set, elem);
-	}
+	set_t *new_set = set_fromtree(a->cmpfunc, tree_build_sorted(a->cmpfunc, buf, n));
+	free(buf);
 
 	INFO_PRINT("set_intersection: Created a intersection set.\n");
 	return new_set;
@@ -97,33 +269,126 @@ set_t *set_intersection(set_t *a, set_t *b)
 
 set_t *set_difference(set_t *a, set_t *b)
 {
-	// Create a new empty set.
-	set_t *new_set = set_create(a->cmpfunc);
+	if (tree_cheap_copy && tree_size(a->tree) > tree_size(b->tree) * SEEK_RATIO)
+		return set_patch(a, b, tree_remove);
+
+	tree_iter_t *ia = tree_createiter(a->tree), *ib = tree_createiter(b->tree);
+	void **buf = newbuffer(tree_size(a->tree));
+	void *ea, *eb;
+	size_t n = 0;
+	int cmpval;
+
+	ea = tree_next(ia);
+	eb = tree_next(ib);
+
+	while (ea && eb) {
+		cmpval = a->cmpfunc(ea, eb);
+
+		if (cmpval < 0) {
+			buf[n++] = ea;
+			ea = tree_next(ia);
+		} else if (cmpval > 0) {
+			eb = tree_next(ib);
+		} else {
+			ea = tree_next(ia);
+			eb = tree_next(ib);
+		}
+	}
 
-	/* 
-	 * Iterate over the other set.
-	 */
-	set_iter_t *iter = set_createiter(a);
-	void *elem;
+	// The rest of a is larger than everything in b.
+	for (; ea; ea = tree_next(ia))
+		buf[n++] = ea;
 
-	while (set_hasnext(iter)) {
-		elem = set_next(iter);
+	tree_destroyiter(ia);
+	tree_destroyiter(ib);
 
-		// If element from b is not contained in a add to new set.
-		if (!set_contains(b, elem))
-			set_add(new_set, elem);
-	}
+	set_t *new_set = set_fromtree(a->cmpfunc, tree_build_sorted(a->cmpfunc, buf, n));
+	free(buf);
 
 	INFO_PRINT("set_difference: Created a difference set.\n");
 	return new_set;
 }
 
 
-set_t *set_copy(set_t *set)
+/*
+ * Moves the tree of other into set, and destroys other along with the
+ * old tree of set.
+ */
+static void set_replace(set_t *set, set_t *other)
 {
-	set_t *copy = set_create(set->cmpfunc);
+	tree_t *tree = set->tree;
+
+	set->tree = other->tree;
+	other->tree = tree;
+	set_destroy(other);
+}
+
+
+/*
+ * The in-place operations reuse the merges above and swap the new,
+ * balanced tree in for the old one. That is O(n + m), with no search
+ * per element, and leaves a balanced tree behind.
+ */
+void set_union_into(set_t *a, set_t *b)
+{
+	tree_iter_t *iter;
+
+	// A few new elements are cheaper to add than to merge in.
+	if (tree_size(a->tree) > tree_size(b->tree) * SEEK_RATIO) {
+		iter = tree_createiter(b->tree);
+		while (tree_hasnext(iter))
+			tree_add(a->tree, tree_next(iter));
+		tree_destroyiter(iter);
+		return;
+	}
+
+	set_replace(a, set_union(a, b));
+}
+
+
+void set_intersect_into(set_t *a, set_t *b)
+{
+	set_replace(a, set_intersection(a, b));
+}
+
+
+set_t *set_from_sorted_array(cmpfunc_t cmpfunc, hashfunc_t hashfunc,
+                             void **elems, int n)
+{
+	void **buf = newbuffer(n);
+	set_t *set;
+
+	(void)hashfunc;
+
+	memcpy(buf, elems, n * sizeof(void *));
+	n = dedup_sorted(buf, n, cmpfunc);
 
-	copy->tree = tree_copy(set->tree);
+	set = set_fromtree(cmpfunc, tree_build_sorted(cmpfunc, buf, n));
+	free(buf);
+
+	return set;
+}
+
+
+/*
+ * Sorting the new elements once and merging them in costs
+ * O(k log k + n + k), against O(k log(n + k)) searches for k calls to
+ * set_add, and leaves a balanced tree behind.
+ */
+void set_add_all(set_t *set, void **elems, int n)
+{
+	void **sorted = sorted_copy(elems, &n, set->cmpfunc);
+	set_t *other = set_from_sorted_array(set->cmpfunc, NULL, sorted, n);
+
+	free(sorted);
+	set_union_into(set, other);
+	set_destroy(other);
+}
+
+
+set_t *set_copy(set_t *set)
+{
+	set_t *copy = set_fromtree(set->cmpfunc, tree_copy(set->tree));
 
 	INFO_PRINT("set_copy: Created a set copy.\n");
 	return copy;
@@ -138,13 +403,20 @@ struct set_iter
 
 
 set_iter_t *set_createiter(set_t *set)
+{
+	return set_createiter_range(set, NULL, NULL);
+}
+
+
+
+set_iter_t *set_createiter_range(set_t *set, void *lo, void *hi)
 {
 	set_iter_t *iter = malloc(sizeof(set_iter_t));
 
 	if (!iter)
 		ERROR_PRINT("set_createiter: Malloc failed!\n");
 
-	iter->tree_iter = tree_createiter(set->tree);
+	iter->tree_iter = tree_createiter_range(set->tree, lo, hi);
 
 	INFO_PRINT("set_createiter: Successfully created a set iterator.\n");
 	return iter;
@@ -171,3 +443,10 @@ void *set_next(set_iter_t *iter)
 {
 	return tree_next(iter->tree_iter);
 }
+
+
+
+void set_iter_seek(set_iter_t *iter, void *key)
+{
+	tree_iter_seek(iter->tree_iter, key);
+}
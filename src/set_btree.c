@@ -0,0 +1,995 @@
+/**
+ * @file set_btree.c
+ * @brief Implementation of set as a B+-tree.
+ *
+ * Every node is NODE_BYTES large and aligned to a cache line, so a
+ * node is fetched with a handful of cache misses and then searched
+ * in place, instead of paying one miss per element as in bst.c.
+ * All elements live in the leaves, and the leaves are linked in
+ * ascending order, so iteration is a plain walk along the leaf chain.
+ * Inner nodes only hold separator keys: keys[i] is the smallest
+ * element in the subtree children[i + 1].
+ *
+ * set_remove never merges or rebalances nodes. A leaf that runs empty
+ * is unlinked from its parent, and inner nodes left without children
+ * go the same way, so the tree never gets deeper than set_add made it.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "set.h"
+#include "sort.h"
+#include "printing.h"
+
+#define CACHE_LINE 64
+#define NODE_BYTES (4 * CACHE_LINE)
+
+/*
+ * Fan-out that fills a node exactly: a leaf holds a header, a next
+ * pointer and its keys, an inner node a header, its keys and one
+ * more child than keys.
+ */
+#define HEADER_BYTES (2 * sizeof(int))
+#define LEAF_KEYS ((NODE_BYTES - HEADER_BYTES - sizeof(void *)) / sizeof(void *))
+#define INNER_KEYS ((NODE_BYTES - HEADER_BYTES - sizeof(void *)) / (2 * sizeof(void *)))
+
+/*
+ * Inner nodes have at least two children when built or split, so no
+ * tree that fits in memory comes close to this depth.
+ */
+#define MAX_DEPTH 64
+
+/*
+ * Number of descents set_contains_many runs side by side.
+ */
+#define SEARCH_GROUP 16
+
+struct node;
+
+/**
+ * @typedef node
+ * @brief Header shared by leaves and inner nodes.
+ *
+ */
+typedef struct node node_t;
+
+struct node {
+	int nkeys;
+	int leaf;
+};
+
+typedef struct leaf leaf_t;
+
+struct leaf {
+	node_t hdr;
+	leaf_t *next;
+	void *keys[LEAF_KEYS];
+};
+
+typedef struct inner inner_t;
+
+struct inner {
+	node_t hdr;
+	void *keys[INNER_KEYS];
+	node_t *children[INNER_KEYS + 1];
+};
+
+struct set
+{
+	node_t *root;
+	leaf_t *first;
+	int size;
+	cmpfunc_t cmpfunc;
+};
+
+/**
+ * @brief Allocate a cache line aligned node.
+ *
+ * @param leaf 1 for a leaf, 0 for an inner node.
+ * @return node
+ */
+static node_t *newnode(int leaf)
+{
+	node_t *node = aligned_alloc(CACHE_LINE, NODE_BYTES);
+
+	if (!node)
+		ERROR_PRINT("newnode: Aligned alloc failed!\n");
+
+	node->nkeys = 0;
+	node->leaf = leaf;
+
+	if (leaf)
+		((leaf_t *)node)->next = NULL;
+
+	return node;
+}
+
+/**
+ * @brief Free a node and every node beneath it.
+ *
+ * @param node
+ */
+static void deletenode(node_t *node)
+{
+	int i;
+
+	if (!node->leaf) {
+		for (i = 0; i <= node->nkeys; i++)
+			deletenode(((inner_t *)node)->children[i]);
+	}
+
+	free(node);
+}
+
+/**
+ * @brief Find the first position in keys[0..n) whose key is not
+ * smaller than elem.
+ */
+static int lowerbound(void **keys, int n, void *elem, cmpfunc_t cmpfunc)
+{
+	int lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (cmpfunc(keys[mid], elem) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * @brief Find the child of an inner node whose subtree covers elem,
+ * i.e. the number of separators that are smaller than or equal to it.
+ */
+static int childindex(inner_t *inner, void *elem, cmpfunc_t cmpfunc)
+{
+	int lo = 0, hi = inner->hdr.nkeys, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (cmpfunc(inner->keys[mid], elem) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * @brief Descend from the root to the leaf that covers elem.
+ *
+ * @param set
+ * @param elem
+ * @return leaf
+ */
+static leaf_t *findleaf(set_t *set, void *elem)
+{
+	node_t *node = set->root;
+
+	while (!node->leaf)
+		node = ((inner_t *)node)->children[childindex((inner_t *)node, elem, set->cmpfunc)];
+
+	return (leaf_t *)node;
+}
+
+/**
+ * @brief Create a set holding the sorted, duplicate free elements
+ * elems[0..n), by filling leaves from the left and then building
+ * each inner level on top of the one below. Runs in O(n).
+ *
+ * @param cmpfunc
+ * @param elems
+ * @param n
+ * @return set
+ */
+static set_t *buildset(cmpfunc_t cmpfunc, void **elems, int n)
+{
+	set_t *set = malloc(sizeof(set_t));
+	node_t **level;
+	void **minkeys;
+	leaf_t *leaf, *prev = NULL;
+	inner_t *inner;
+	int i, j, count = 0, children;
+
+	if (!set)
+		ERROR_PRINT("set_create: Malloc failed!\n");
+
+	set->cmpfunc = cmpfunc;
+	set->size = n;
+
+	// One slot per leaf, along with the smallest key below it.
+	level = malloc((n / LEAF_KEYS + 1) * sizeof(node_t *));
+	minkeys = malloc((n / LEAF_KEYS + 1) * sizeof(void *));
+
+	if (!level || !minkeys)
+		ERROR_PRINT("buildset: Malloc failed!\n");
+
+	i = 0;
+	do {
+		leaf = (leaf_t *)newnode(1);
+
+		for (j = 0; j < (int)LEAF_KEYS && i < n; j++)
+			leaf->keys[j] = elems[i++];
+		leaf->hdr.nkeys = j;
+
+		if (prev)
+			prev->next = leaf;
+		else
+			set->first = leaf;
+		prev = leaf;
+
+		level[count] = &leaf->hdr;
+		minkeys[count++] = j ? leaf->keys[0] : NULL;
+	} while (i < n);
+
+	// Group the nodes of each level under new inner nodes.
+	while (count > 1) {
+		children = count;
+		count = 0;
+
+		for (i = 0; i < children; ) {
+			inner = (inner_t *)newnode(0);
+
+			inner->children[0] = level[i];
+			minkeys[count] = minkeys[i];
+			i++;
+
+			for (j = 0; j < (int)INNER_KEYS && i < children; j++, i++) {
+				inner->keys[j] = minkeys[i];
+				inner->children[j + 1] = level[i];
+			}
+			inner->hdr.nkeys = j;
+
+			level[count++] = &inner->hdr;
+		}
+	}
+
+	set->root = level[0];
+
+	free(level);
+	free(minkeys);
+
+	return set;
+}
+
+set_t *set_create(cmpfunc_t cmpfunc)
+{
+	return buildset(cmpfunc, NULL, 0);
+}
+
+set_t *set_create_hashed(cmpfunc_t cmpfunc, hashfunc_t hashfunc)
+{
+	// The tree is ordered by comparisons only.
+	(void)hashfunc;
+	return set_create(cmpfunc);
+}
+
+void set_destroy(set_t *set)
+{
+	deletenode(set->root);
+	free(set);
+	INFO_PRINT("set_destroy: Set successfully destroyed.\n");
+}
+
+int set_size(set_t *set)
+{
+	return set->size;
+}
+
+/**
+ * @brief Insert elem into a full leaf, moving the upper half of the
+ * keys to a new leaf on its right.
+ *
+ * @param leaf
+ * @param pos position of elem within leaf.
+ * @param elem
+ * @param splitkey set to the smallest key of the new leaf.
+ * @return new leaf
+ */
+static node_t *splitleaf(leaf_t *leaf, int pos, void *elem, void **splitkey)
+{
+	leaf_t *right = (leaf_t *)newnode(1);
+	void *keys[LEAF_KEYS + 1];
+	int i, total = LEAF_KEYS + 1, half = total / 2;
+
+	memcpy(keys, leaf->keys, pos * sizeof(void *));
+	keys[pos] = elem;
+	memcpy(&keys[pos + 1], &leaf->keys[pos], (LEAF_KEYS - pos) * sizeof(void *));
+
+	for (i = 0; i < half; i++)
+		leaf->keys[i] = keys[i];
+	for (i = half; i < total; i++)
+		right->keys[i - half] = keys[i];
+
+	leaf->hdr.nkeys = half;
+	right->hdr.nkeys = total - half;
+
+	right->next = leaf->next;
+	leaf->next = right;
+
+	*splitkey = right->keys[0];
+	return &right->hdr;
+}
+
+/**
+ * @brief Insert the separator key and its right child into a full
+ * inner node. The middle separator moves up to the parent.
+ *
+ * @param inner
+ * @param pos position of key within inner.
+ * @param key
+ * @param child subtree to the right of key.
+ * @param splitkey set to the separator that moves up.
+ * @return new inner node
+ */
+static node_t *splitinner(inner_t *inner, int pos, void *key, node_t *child,
+			  void **splitkey)
+{
+	inner_t *right = (inner_t *)newnode(0);
+	void *keys[INNER_KEYS + 1];
+	node_t *children[INNER_KEYS + 2];
+	int i, total = INNER_KEYS + 1, half = total / 2;
+
+	memcpy(keys, inner->keys, pos * sizeof(void *));
+	keys[pos] = key;
+	memcpy(&keys[pos + 1], &inner->keys[pos], (INNER_KEYS - pos) * sizeof(void *));
+
+	memcpy(children, inner->children, (pos + 1) * sizeof(node_t *));
+	children[pos + 1] = child;
+	memcpy(&children[pos + 2], &inner->children[pos + 1],
+	       (INNER_KEYS - pos) * sizeof(node_t *));
+
+	// keys[half] moves up; the keys around it are split in two.
+	for (i = 0; i < half; i++) {
+		inner->keys[i] = keys[i];
+		inner->children[i] = children[i];
+	}
+	inner->children[half] = children[half];
+	inner->hdr.nkeys = half;
+
+	for (i = half + 1; i < total; i++) {
+		right->keys[i - half - 1] = keys[i];
+		right->children[i - half - 1] = children[i];
+	}
+	right->children[total - half - 1] = children[total];
+	right->hdr.nkeys = total - half - 1;
+
+	*splitkey = keys[half];
+	return &right->hdr;
+}
+
+/**
+ * @brief Insert elem in the subtree rooted at node.
+ *
+ * @param set
+ * @param node
+ * @param elem
+ * @param splitkey set to the new separator if node was split.
+ * @param split set to the new right sibling of node, or NULL.
+ * @return 1 if elem was added, 0 if it was already present.
+ */
+static int insert(set_t *set, node_t *node, void *elem, void **splitkey,
+		  node_t **split)
+{
+	leaf_t *leaf;
+	inner_t *inner;
+	node_t *child;
+	void *childkey;
+	int pos;
+
+	*split = NULL;
+
+	if (node->leaf) {
+		leaf = (leaf_t *)node;
+		pos = lowerbound(leaf->keys, node->nkeys, elem, set->cmpfunc);
+
+		if (pos < node->nkeys && set->cmpfunc(leaf->keys[pos], elem) == 0)
+			return 0;
+
+		if (node->nkeys == LEAF_KEYS) {
+			*split = splitleaf(leaf, pos, elem, splitkey);
+			return 1;
+		}
+
+		memmove(&leaf->keys[pos + 1], &leaf->keys[pos],
+			(node->nkeys - pos) * sizeof(void *));
+		leaf->keys[pos] = elem;
+		node->nkeys++;
+		return 1;
+	}
+
+	inner = (inner_t *)node;
+	pos = childindex(inner, elem, set->cmpfunc);
+
+	if (!insert(set, inner->children[pos], elem, &childkey, &child))
+		return 0;
+
+	if (!child)
+		return 1;
+
+	if (node->nkeys == INNER_KEYS) {
+		*split = splitinner(inner, pos, childkey, child, splitkey);
+		return 1;
+	}
+
+	memmove(&inner->keys[pos + 1], &inner->keys[pos],
+		(node->nkeys - pos) * sizeof(void *));
+	memmove(&inner->children[pos + 2], &inner->children[pos + 1],
+		(node->nkeys - pos) * sizeof(node_t *));
+	inner->keys[pos] = childkey;
+	inner->children[pos + 1] = child;
+	node->nkeys++;
+	return 1;
+}
+
+void set_add(set_t *set, void *elem)
+{
+	inner_t *root;
+	node_t *split;
+	void *splitkey;
+
+	if (!insert(set, set->root, elem, &splitkey, &split)) {
+		INFO_PRINT("set_add: Elem already exist!\n");
+		return;
+	}
+
+	set->size++;
+
+	// The root was split, so the tree grows one level.
+	if (split) {
+		root = (inner_t *)newnode(0);
+		root->hdr.nkeys = 1;
+		root->keys[0] = splitkey;
+		root->children[0] = set->root;
+		root->children[1] = split;
+		set->root = &root->hdr;
+	}
+}
+
+/**
+ * @brief Get the rightmost leaf beneath node.
+ */
+static leaf_t *lastleaf(node_t *node)
+{
+	while (!node->leaf)
+		node = ((inner_t *)node)->children[node->nkeys];
+
+	return (leaf_t *)node;
+}
+
+/**
+ * @brief Remove children[i] from an inner node, along with the
+ * separator to its left, or the one to its right for children[0].
+ *
+ * @param inner
+ * @param i
+ * @return the separator that was removed, or NULL if there was none.
+ */
+static void *dropchild(inner_t *inner, int i)
+{
+	int k = i > 0 ? i - 1 : 0;
+	void *key = inner->hdr.nkeys ? inner->keys[k] : NULL;
+
+	if (inner->hdr.nkeys) {
+		memmove(&inner->keys[k], &inner->keys[k + 1],
+			(inner->hdr.nkeys - k - 1) * sizeof(void *));
+	}
+	memmove(&inner->children[i], &inner->children[i + 1],
+		(inner->hdr.nkeys - i) * sizeof(node_t *));
+	inner->hdr.nkeys--;
+
+	return key;
+}
+
+int set_remove(set_t *set, void *elem)
+{
+	inner_t *path[MAX_DEPTH], *inner;
+	int index[MAX_DEPTH], depth = 0, sep = -1, d, pos;
+	node_t *node = set->root;
+	leaf_t *leaf, *prev = NULL;
+	void *replacement = NULL;
+
+	while (!node->leaf) {
+		inner = (inner_t *)node;
+		path[depth] = inner;
+		index[depth] = childindex(inner, elem, set->cmpfunc);
+		node = inner->children[index[depth]];
+		depth++;
+	}
+
+	leaf = (leaf_t *)node;
+	pos = lowerbound(leaf->keys, node->nkeys, elem, set->cmpfunc);
+
+	if (pos == node->nkeys || set->cmpfunc(leaf->keys[pos], elem) != 0)
+		return 0;
+
+	memmove(&leaf->keys[pos], &leaf->keys[pos + 1],
+		(node->nkeys - pos - 1) * sizeof(void *));
+	node->nkeys--;
+	set->size--;
+
+	/*
+	 * Only the deepest separator the path passed to the right of can
+	 * be the removed element: it is the lower bound of the subtree
+	 * whose leftmost leaf this is. Separators are compared against
+	 * later on, so it must not be left pointing at the removed element.
+	 */
+	for (d = depth - 1; d >= 0; d--) {
+		if (index[d] > 0) {
+			sep = d;
+			break;
+		}
+	}
+	if (sep >= 0 && set->cmpfunc(path[sep]->keys[index[sep] - 1], elem) != 0)
+		sep = -1;
+
+	if (node->nkeys > 0 || depth == 0) {
+		if (sep >= 0 && node->nkeys > 0)
+			path[sep]->keys[index[sep] - 1] = leaf->keys[0];
+		return 1;
+	}
+
+	// The leaf ran empty, so take it out of the leaf chain.
+	for (d = depth - 1; d >= 0; d--) {
+		if (index[d] > 0) {
+			prev = lastleaf(path[d]->children[index[d] - 1]);
+			break;
+		}
+	}
+	if (prev)
+		prev->next = leaf->next;
+	else
+		set->first = leaf->next;
+
+	/*
+	 * Unlink the leaf, and every ancestor that is left without
+	 * children. Where the first child of a node is dropped, the
+	 * separator to its right goes with it; that was the smallest
+	 * element of the next child, so it is what the stale separator
+	 * above becomes. At level sep, the stale separator is dropped.
+	 */
+	for (d = depth - 1; d >= 0; d--) {
+		free(node);
+		node = &path[d]->hdr;
+
+		if (node->nkeys == 0 && d > 0)
+			continue;
+
+		if (node->nkeys == 0) {
+			// The root lost its only child; the tree is now empty.
+			free(node);
+			set->root = newnode(1);
+			set->first = (leaf_t *)set->root;
+			return 1;
+		}
+
+		if (index[d] == 0)
+			replacement = dropchild(path[d], 0);
+		else
+			dropchild(path[d], index[d]);
+		break;
+	}
+
+	if (sep >= 0 && sep < d)
+		path[sep]->keys[index[sep] - 1] = replacement;
+
+	// A root with a single child is of no use.
+	while (!set->root->leaf && set->root->nkeys == 0) {
+		node = set->root;
+		set->root = ((inner_t *)node)->children[0];
+		free(node);
+	}
+
+	return 1;
+}
+
+int set_contains(set_t *set, void *elem)
+{
+	leaf_t *leaf = findleaf(set, elem);
+	int pos = lowerbound(leaf->keys, leaf->hdr.nkeys, elem, set->cmpfunc);
+
+	return pos < leaf->hdr.nkeys && set->cmpfunc(leaf->keys[pos], elem) == 0;
+}
+
+/**
+ * @brief Prefetch every cache line of a node.
+ */
+static inline void prefetchnode(node_t *node)
+{
+	int i;
+
+	for (i = 0; i < NODE_BYTES; i += CACHE_LINE)
+		__builtin_prefetch((char *)node + i);
+}
+
+/*
+ * Descents in a group take turns, one level each, and every step
+ * prefetches the whole child node it moves to. By the time a descent
+ * gets its next turn, its node has most likely arrived.
+ */
+int set_contains_many(set_t *set, void **elems, int n, unsigned char *found)
+{
+	node_t *node[SEARCH_GROUP];
+	leaf_t *leaf;
+	int j, g, size, pos, inner, count = 0;
+
+	memset(found, 0, (n + 7) / 8);
+
+	for (g = 0; g < n; g += SEARCH_GROUP) {
+		size = n - g < SEARCH_GROUP ? n - g : SEARCH_GROUP;
+
+		for (j = 0; j < size; j++)
+			node[j] = set->root;
+
+		do {
+			inner = 0;
+			for (j = 0; j < size; j++) {
+				if (node[j]->leaf)
+					continue;
+				node[j] = ((inner_t *)node[j])->children[childindex((inner_t *)node[j], elems[g + j], set->cmpfunc)];
+				prefetchnode(node[j]);
+				inner = 1;
+			}
+		} while (inner);
+
+		for (j = 0; j < size; j++) {
+			leaf = (leaf_t *)node[j];
+			pos = lowerbound(leaf->keys, leaf->hdr.nkeys, elems[g + j], set->cmpfunc);
+			if (pos < leaf->hdr.nkeys && set->cmpfunc(leaf->keys[pos], elems[g + j]) == 0) {
+				found[(g + j) / 8] |= 1 << ((g + j) % 8);
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+/*
+ * The nodes do not count the elements below them, so rank and select
+ * walk the leaf chain, skipping a whole leaf at a time.
+ */
+int set_rank(set_t *set, void *elem)
+{
+	leaf_t *leaf = set->first, *target = findleaf(set, elem);
+	int rank = 0;
+
+	for (; leaf != target; leaf = leaf->next)
+		rank += leaf->hdr.nkeys;
+
+	return rank + lowerbound(leaf->keys, leaf->hdr.nkeys, elem, set->cmpfunc);
+}
+
+void *set_select(set_t *set, int k)
+{
+	leaf_t *leaf = set->first;
+
+	if (k < 0 || k >= set->size)
+		return NULL;
+
+	while (k >= leaf->hdr.nkeys) {
+		k -= leaf->hdr.nkeys;
+		leaf = leaf->next;
+	}
+
+	return leaf->keys[k];
+}
+
+/**
+ * @brief Allocate room for the output of a set operation.
+ */
+static void **newbuffer(int n)
+{
+	void **buf = malloc((n + 1) * sizeof(void *));
+
+	if (!buf)
+		ERROR_PRINT("newbuffer: Malloc failed!\n");
+
+	return buf;
+}
+
+/*
+ * The set operations below merge the leaf chains of a and b into a
+ * sorted buffer in O(n + m), and build the result from it with
+ * buildset, which fills every leaf to the brim.
+ */
+set_t *set_union(set_t *a, set_t *b)
+{
+	set_iter_t *ia = set_createiter(a), *ib = set_createiter(b);
+	void **buf = newbuffer(a->size + b->size);
+	void *ea = set_next(ia), *eb = set_next(ib);
+	int n = 0, cmpval;
+
+	while (ea && eb) {
+		cmpval = a->cmpfunc(ea, eb);
+
+		if (cmpval < 0) {
+			buf[n++] = ea;
+			ea = set_next(ia);
+		} else if (cmpval > 0) {
+			buf[n++] = eb;
+			eb = set_next(ib);
+		} else {
+			buf[n++] = ea;
+			ea = set_next(ia);
+			eb = set_next(ib);
+		}
+	}
+
+	for (; ea; ea = set_next(ia))
+		buf[n++] = ea;
+	for (; eb; eb = set_next(ib))
+		buf[n++] = eb;
+
+	set_destroyiter(ia);
+	set_destroyiter(ib);
+
+	set_t *new_set = buildset(a->cmpfunc, buf, n);
+	free(buf);
+
+	INFO_PRINT("set_union: Created a union set.\n");
+	return new_set;
+}
+
+/*
+ * When one set is more than SEEK_RATIO times larger than the other,
+ * the intersection seeks through the larger one with set_iter_seek
+ * instead of walking every leaf, which costs O(m log n) for the m
+ * elements of the smaller set.
+ */
+#define SEEK_RATIO 16
+
+set_t *set_intersection(set_t *a, set_t *b)
+{
+	set_iter_t *ia = set_createiter(a), *ib = set_createiter(b);
+	void **buf = newbuffer(a->size < b->size ? a->size : b->size);
+	void *ea = set_next(ia), *eb = set_next(ib);
+	int seek_a = a->size > b->size * SEEK_RATIO, seek_b = b->size > a->size * SEEK_RATIO;
+	int n = 0, cmpval;
+
+	while (ea && eb) {
+		cmpval = a->cmpfunc(ea, eb);
+
+		if (cmpval < 0) {
+			if (seek_a)
+				set_iter_seek(ia, eb);
+			ea = set_next(ia);
+		} else if (cmpval > 0) {
+			if (seek_b)
+				set_iter_seek(ib, ea);
+			eb = set_next(ib);
+		} else {
+			buf[n++] = ea;
+			ea = set_next(ia);
+			eb = set_next(ib);
+		}
+	}
+
+	set_destroyiter(ia);
+	set_destroyiter(ib);
+
+	set_t *new_set = buildset(a->cmpfunc, buf, n);
+	free(buf);
+
+	INFO_PRINT("set_intersection: Created a intersection set.\n");
+	return new_set;
+}
+
+set_t *set_difference(set_t *a, set_t *b)
+{
+	set_iter_t *ia = set_createiter(a), *ib = set_createiter(b);
+	void **buf = newbuffer(a->size);
+	void *ea = set_next(ia), *eb = set_next(ib);
+	int n = 0, cmpval;
+
+	while (ea && eb) {
+		cmpval = a->cmpfunc(ea, eb);
+
+		if (cmpval < 0) {
+			buf[n++] = ea;
+			ea = set_next(ia);
+		} else if (cmpval > 0) {
+			eb = set_next(ib);
+		} else {
+			ea = set_next(ia);
+			eb = set_next(ib);
+		}
+	}
+
+	for (; ea; ea = set_next(ia))
+		buf[n++] = ea;
+
+	set_destroyiter(ia);
+	set_destroyiter(ib);
+
+	set_t *new_set = buildset(a->cmpfunc, buf, n);
+	free(buf);
+
+	INFO_PRINT("set_difference: Created a difference set.\n");
+	return new_set;
+}
+
+/**
+ * @brief Move the tree of other into set, and destroy other along with
+ * the old tree of set.
+ *
+ * @param set
+ * @param other
+ */
+static void set_replace(set_t *set, set_t *other)
+{
+	node_t *root = set->root;
+
+	set->root = other->root;
+	set->first = other->first;
+	set->size = other->size;
+
+	other->root = root;
+	set_destroy(other);
+}
+
+/*
+ * Merging and rebuilding is O(n + m) and leaves every leaf full, so
+ * the in-place operations swap in the result of the ones above.
+ */
+void set_union_into(set_t *a, set_t *b)
+{
+	set_replace(a, set_union(a, b));
+}
+
+void set_intersect_into(set_t *a, set_t *b)
+{
+	set_replace(a, set_intersection(a, b));
+}
+
+set_t *set_from_sorted_array(cmpfunc_t cmpfunc, hashfunc_t hashfunc,
+                             void **elems, int n)
+{
+	void **buf = newbuffer(n);
+	set_t *set;
+
+	(void)hashfunc;
+
+	memcpy(buf, elems, n * sizeof(void *));
+	n = dedup_sorted(buf, n, cmpfunc);
+
+	set = buildset(cmpfunc, buf, n);
+	free(buf);
+
+	return set;
+}
+
+void set_add_all(set_t *set, void **elems, int n)
+{
+	void **sorted = sorted_copy(elems, &n, set->cmpfunc);
+	set_t *other = buildset(set->cmpfunc, sorted, n);
+
+	free(sorted);
+	set_union_into(set, other);
+	set_destroy(other);
+}
+
+set_t *set_copy(set_t *set)
+{
+	set_iter_t *iter = set_createiter(set);
+	void **buf = newbuffer(set->size);
+	int n = 0;
+
+	while (set_hasnext(iter))
+		buf[n++] = set_next(iter);
+
+	set_destroyiter(iter);
+
+	set_t *copy = buildset(set->cmpfunc, buf, n);
+	free(buf);
+
+	INFO_PRINT("set_copy: Created a set copy.\n");
+	return copy;
+}
+
+
+struct set_iter
+{
+	set_t *set;
+	leaf_t *leaf;
+	int pos;
+	void *hi;
+};
+
+/**
+ * @brief Move the iterator on to the next leaf if it has run off the
+ * end of the current one.
+ */
+static void nextleaf(set_iter_t *iter)
+{
+	if (iter->leaf && iter->pos == iter->leaf->hdr.nkeys) {
+		iter->leaf = iter->leaf->next;
+		iter->pos = 0;
+	}
+}
+
+set_iter_t *set_createiter(set_t *set)
+{
+	return set_createiter_range(set, NULL, NULL);
+}
+
+set_iter_t *set_createiter_range(set_t *set, void *lo, void *hi)
+{
+	set_iter_t *iter = malloc(sizeof(set_iter_t));
+
+	if (!iter)
+		ERROR_PRINT("set_createiter: Malloc failed!\n");
+
+	iter->set = set;
+	iter->hi = hi;
+
+	if (lo) {
+		iter->leaf = findleaf(set, lo);
+		iter->pos = lowerbound(iter->leaf->keys, iter->leaf->hdr.nkeys, lo, set->cmpfunc);
+		nextleaf(iter);
+	} else {
+		iter->leaf = set->first;
+		iter->pos = 0;
+	}
+
+	INFO_PRINT("set_createiter: Successfully created a set iterator.\n");
+	return iter;
+}
+
+void set_destroyiter(set_iter_t *iter)
+{
+	free(iter);
+	INFO_PRINT("set_destroyiter: Successfully destroyed set.\n");
+}
+
+int set_hasnext(set_iter_t *iter)
+{
+	// Only the first leaf of an empty tree is ever empty.
+	if (!iter->leaf || iter->pos >= iter->leaf->hdr.nkeys)
+		return 0;
+
+	return !iter->hi || iter->set->cmpfunc(iter->leaf->keys[iter->pos], iter->hi) < 0;
+}
+
+void *set_next(set_iter_t *iter)
+{
+	void *elem;
+
+	if (!set_hasnext(iter))
+		return NULL;
+
+	elem = iter->leaf->keys[iter->pos++];
+	nextleaf(iter);
+
+	return elem;
+}
+
+void set_iter_seek(set_iter_t *iter, void *key)
+{
+	cmpfunc_t cmpfunc = iter->set->cmpfunc;
+	leaf_t *leaf = iter->leaf;
+	int nkeys;
+
+	if (!set_hasnext(iter) || cmpfunc(leaf->keys[iter->pos], key) >= 0)
+		return;
+
+	// Search the current leaf if key is in it, or else from the root.
+	nkeys = leaf->hdr.nkeys;
+	if (cmpfunc(leaf->keys[nkeys - 1], key) < 0) {
+		leaf = findleaf(iter->set, key);
+		iter->leaf = leaf;
+		iter->pos = 0;
+	}
+
+	iter->pos += lowerbound(leaf->keys + iter->pos, leaf->hdr.nkeys - iter->pos, key, cmpfunc);
+	nextleaf(iter);
+}
@@ -0,0 +1,550 @@
+/**
+ * @file set_hash.c
+ * @brief Implementation of set as an open-addressing hash table.
+ *
+ * Elements are stored directly in an array of slots, and collisions
+ * are resolved by linear probing. The table is kept at most half
+ * full, so set_add and set_contains run in O(1) expected time.
+ * set_remove shifts later elements of the same probe run back into
+ * the hole it leaves, so no tombstones are needed.
+ *
+ * The elements are only sorted when an iterator is created, since
+ * set iterators must visit the elements in ascending order. The set
+ * operations walk the slot array directly and never sort.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include <stdlib.h>
+#include "common.h"
+#include "set.h"
+#include "sort.h"
+#include "printing.h"
+
+#define INITIAL_BITS 4
+#define GOLDEN_RATIO 11400714819323198485ull
+
+/*
+ * Number of lookups set_contains_many prepares before it probes.
+ */
+#define PROBE_GROUP 16
+
+struct set
+{
+	void **slots;
+	int size;
+	int bits;
+	cmpfunc_t cmpfunc;
+	hashfunc_t hashfunc;
+};
+
+/**
+ * @brief Number of slots in the table.
+ */
+#define CAPACITY(set) ((size_t)1 << (set)->bits)
+
+/**
+ * @brief Create an empty set with room for 2^bits slots.
+ *
+ * @param cmpfunc
+ * @param hashfunc
+ * @param bits
+ * @return set
+ */
+static set_t *newset(cmpfunc_t cmpfunc, hashfunc_t hashfunc, int bits)
+{
+	set_t *set = malloc(sizeof(set_t));
+
+	if (!set)
+		ERROR_PRINT("set_create: Malloc failed!\n");
+
+	set->slots = calloc((size_t)1 << bits, sizeof(void *));
+
+	if (!set->slots)
+		ERROR_PRINT("set_create: Calloc failed!\n");
+
+	set->size = 0;
+	set->bits = bits;
+	set->cmpfunc = cmpfunc;
+	set->hashfunc = hashfunc;
+
+	return set;
+}
+
+/**
+ * @brief Get the number of bits needed for a table that holds n
+ * elements at a load factor of at most 1/2.
+ *
+ * Set operations size their result up front with this. Filling a
+ * table in the slot order of another table while it grows would
+ * crowd all elements into the front of the table, since Fibonacci
+ * hashing maps slot order to slot order.
+ *
+ * @param n
+ * @return bits
+ */
+static int bitsfor(int n)
+{
+	int bits = INITIAL_BITS;
+
+	while (((size_t)1 << bits) < (size_t)n * 2 + 2)
+		bits++;
+
+	return bits;
+}
+
+/**
+ * @brief Get the home slot of an element.
+ *
+ * The user supplied hash is scrambled by Fibonacci hashing, so that
+ * weak hashes like the identity on small integers still spread
+ * evenly over the table. Without a hash function every element has
+ * the same home slot, and the table degrades to a linear scan.
+ *
+ * @param set
+ * @param elem
+ * @return slot index
+ */
+static size_t homeslot(set_t *set, void *elem)
+{
+	unsigned long long hash;
+
+	if (!set->hashfunc)
+		return 0;
+
+	hash = (unsigned long long)set->hashfunc(elem) * GOLDEN_RATIO;
+
+	return (size_t)(hash >> (64 - set->bits));
+}
+
+/**
+ * @brief Find the slot holding an element equal to elem, or the
+ * empty slot where it belongs if there is none.
+ *
+ * @param set
+ * @param elem
+ * @return slot index
+ */
+static size_t findslot(set_t *set, void *elem)
+{
+	size_t mask = CAPACITY(set) - 1;
+	size_t i = homeslot(set, elem);
+
+	while (set->slots[i] && set->cmpfunc(set->slots[i], elem) != 0)
+		i = (i + 1) & mask;
+
+	return i;
+}
+
+/**
+ * @brief Double the number of slots and rehash every element.
+ *
+ * @param set
+ */
+static void grow(set_t *set)
+{
+	void **old = set->slots;
+	size_t i, oldcap = CAPACITY(set);
+
+	set->bits++;
+	set->slots = calloc(CAPACITY(set), sizeof(void *));
+
+	if (!set->slots)
+		ERROR_PRINT("grow: Calloc failed!\n");
+
+	for (i = 0; i < oldcap; i++) {
+		if (old[i])
+			set->slots[findslot(set, old[i])] = old[i];
+	}
+
+	free(old);
+}
+
+set_t *set_create(cmpfunc_t cmpfunc)
+{
+	return newset(cmpfunc, NULL, INITIAL_BITS);
+}
+
+set_t *set_create_hashed(cmpfunc_t cmpfunc, hashfunc_t hashfunc)
+{
+	return newset(cmpfunc, hashfunc, INITIAL_BITS);
+}
+
+void set_destroy(set_t *set)
+{
+	free(set->slots);
+	free(set);
+	INFO_PRINT("set_destroy: Set successfully destroyed.\n");
+}
+
+int set_size(set_t *set)
+{
+	return set->size;
+}
+
+void set_add(set_t *set, void *elem)
+{
+	size_t i;
+
+	// Keep the load factor at or below 1/2.
+	if ((size_t)(set->size + 1) * 2 > CAPACITY(set))
+		grow(set);
+
+	i = findslot(set, elem);
+
+	if (set->slots[i]) {
+		INFO_PRINT("set_add: Elem already exist!\n");
+		return;
+	}
+
+	set->slots[i] = elem;
+	set->size++;
+}
+
+/**
+ * @brief Empty slot i, and close the hole by moving back every later
+ * element of the run whose probe sequence passes through it (Knuth,
+ * TAOCP 6.4, Algorithm R). Afterwards every element can again be
+ * found by probing from its home slot.
+ *
+ * @param set
+ * @param i
+ */
+static void removeslot(set_t *set, size_t i)
+{
+	size_t mask = CAPACITY(set) - 1;
+	size_t j = i, home;
+
+	set->slots[i] = NULL;
+	set->size--;
+
+	for (;;) {
+		j = (j + 1) & mask;
+
+		if (!set->slots[j])
+			return;
+
+		home = homeslot(set, set->slots[j]);
+
+		// Leave the element be if its home lies cyclically in (i, j].
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+
+		set->slots[i] = set->slots[j];
+		set->slots[j] = NULL;
+		i = j;
+	}
+}
+
+int set_remove(set_t *set, void *elem)
+{
+	size_t i = findslot(set, elem);
+
+	if (!set->slots[i])
+		return 0;
+
+	removeslot(set, i);
+	return 1;
+}
+
+int set_contains(set_t *set, void *elem)
+{
+	return set->slots[findslot(set, elem)] != NULL;
+}
+
+/*
+ * Lookups are done in groups. The home slots of the whole group are
+ * prefetched first, then the elements stored there, which the
+ * comparisons read, and only then is each probe run, so the cache
+ * misses of a group overlap instead of coming one after another.
+ */
+int set_contains_many(set_t *set, void **elems, int n, unsigned char *found)
+{
+	size_t home[PROBE_GROUP], mask = CAPACITY(set) - 1, i;
+	int j, g, size, count = 0;
+
+	memset(found, 0, (n + 7) / 8);
+
+	for (g = 0; g < n; g += PROBE_GROUP) {
+		size = n - g < PROBE_GROUP ? n - g : PROBE_GROUP;
+
+		for (j = 0; j < size; j++) {
+			home[j] = homeslot(set, elems[g + j]);
+			__builtin_prefetch(&set->slots[home[j]]);
+		}
+
+		for (j = 0; j < size; j++) {
+			if (set->slots[home[j]])
+				__builtin_prefetch(set->slots[home[j]]);
+		}
+
+		for (j = 0; j < size; j++) {
+			i = home[j];
+			while (set->slots[i] && set->cmpfunc(set->slots[i], elems[g + j]) != 0)
+				i = (i + 1) & mask;
+
+			if (set->slots[i]) {
+				found[(g + j) / 8] |= 1 << ((g + j) % 8);
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+int set_rank(set_t *set, void *elem)
+{
+	size_t i, cap = CAPACITY(set);
+	int rank = 0;
+
+	for (i = 0; i < cap; i++) {
+		if (set->slots[i] && set->cmpfunc(set->slots[i], elem) < 0)
+			rank++;
+	}
+
+	return rank;
+}
+
+/**
+ * @brief Get the element stored in set that is equal to elem.
+ *
+ * @param set
+ * @param elem
+ * @return stored element | NULL (not in set)
+ */
+static void *lookup(set_t *set, void *elem)
+{
+	return set->slots[findslot(set, elem)];
+}
+
+set_t *set_union(set_t *a, set_t *b)
+{
+	set_t *new_set = newset(a->cmpfunc, a->hashfunc, bitsfor(a->size + b->size));
+	size_t i;
+
+	for (i = 0; i < CAPACITY(a); i++) {
+		if (a->slots[i])
+			set_add(new_set, a->slots[i]);
+	}
+
+	for (i = 0; i < CAPACITY(b); i++) {
+		if (b->slots[i])
+			set_add(new_set, b->slots[i]);
+	}
+
+	INFO_PRINT("set_union: Created a union set.\n");
+	return new_set;
+}
+
+set_t *set_intersection(set_t *a, set_t *b)
+{
+	set_t *small = a->size <= b->size ? a : b;
+	set_t *large = small == a ? b : a;
+	set_t *new_set = newset(a->cmpfunc, a->hashfunc, bitsfor(small->size));
+	size_t i, cap = CAPACITY(small);
+	void *elem;
+
+	/*
+	 * Probe the larger set with every element of the smaller one.
+	 * The result always holds the elements of a, so look the match
+	 * up in a when it is the larger set.
+	 */
+	for (i = 0; i < cap; i++) {
+		if (!small->slots[i])
+			continue;
+
+		elem = lookup(large, small->slots[i]);
+
+		if (elem)
+			set_add(new_set, small == a ? small->slots[i] : elem);
+	}
+
+	INFO_PRINT("set_intersection: Created a intersection set.\n");
+	return new_set;
+}
+
+set_t *set_difference(set_t *a, set_t *b)
+{
+	set_t *new_set = newset(a->cmpfunc, a->hashfunc, bitsfor(a->size));
+	size_t i, cap = CAPACITY(a);
+
+	for (i = 0; i < cap; i++) {
+		if (a->slots[i] && !set_contains(b, a->slots[i]))
+			set_add(new_set, a->slots[i]);
+	}
+
+	INFO_PRINT("set_difference: Created a difference set.\n");
+	return new_set;
+}
+
+void set_union_into(set_t *a, set_t *b)
+{
+	size_t i, cap = CAPACITY(b);
+
+	/*
+	 * Grow a up front, like set_union sizes its result. Growing while
+	 * adding in the slot order of b would crowd the new elements into
+	 * the front of the table.
+	 */
+	while (CAPACITY(a) < ((size_t)1 << bitsfor(a->size + b->size)))
+		grow(a);
+
+	for (i = 0; i < cap; i++) {
+		if (b->slots[i])
+			set_add(a, b->slots[i]);
+	}
+}
+
+void set_intersect_into(set_t *a, set_t *b)
+{
+	size_t i = 0, cap = CAPACITY(a);
+
+	/*
+	 * Removing slot i may move a later element back into it, so only
+	 * move on once slot i holds an element that stays. Elements only
+	 * move into slots that have been visited when the run wraps around
+	 * the end of the table, and those have already been checked.
+	 */
+	while (i < cap) {
+		if (a->slots[i] && !set_contains(b, a->slots[i]))
+			removeslot(a, i);
+		else
+			i++;
+	}
+}
+
+set_t *set_from_sorted_array(cmpfunc_t cmpfunc, hashfunc_t hashfunc, void **elems, int n)
+{
+	set_t *set = newset(cmpfunc, hashfunc, bitsfor(n));
+	int i;
+
+	// Order does not matter to the table, but sizing it once does.
+	for (i = 0; i < n; i++)
+		set_add(set, elems[i]);
+
+	return set;
+}
+
+void set_add_all(set_t *set, void **elems, int n)
+{
+	int i;
+
+	// Grow once up front instead of doubling along the way.
+	while (CAPACITY(set) < ((size_t)1 << bitsfor(set->size + n)))
+		grow(set);
+
+	for (i = 0; i < n; i++)
+		set_add(set, elems[i]);
+}
+
+set_t *set_copy(set_t *set)
+{
+	set_t *copy = newset(set->cmpfunc, set->hashfunc, set->bits);
+
+	// Same capacity and hash function, so every slot stays in place.
+	memcpy(copy->slots, set->slots, CAPACITY(set) * sizeof(void *));
+	copy->size = set->size;
+
+	INFO_PRINT("set_copy: Created a set copy.\n");
+	return copy;
+}
+
+
+struct set_iter
+{
+	void **elems;
+	int size;
+	int next;
+	cmpfunc_t cmpfunc;
+};
+
+set_iter_t *set_createiter(set_t *set)
+{
+	return set_createiter_range(set, NULL, NULL);
+}
+
+set_iter_t *set_createiter_range(set_t *set, void *lo, void *hi)
+{
+	set_iter_t *iter = malloc(sizeof(set_iter_t));
+	size_t i, cap = CAPACITY(set);
+	int n = 0;
+	void *elem;
+
+	if (!iter)
+		ERROR_PRINT("set_createiter: Malloc failed!\n");
+
+	iter->elems = malloc((set->size + 1) * sizeof(void *));
+
+	if (!iter->elems)
+		ERROR_PRINT("set_createiter: Malloc failed!\n");
+
+	// Only the elements within the range are sorted.
+	for (i = 0; i < cap; i++) {
+		elem = set->slots[i];
+
+		if (elem && (!lo || set->cmpfunc(elem, lo) >= 0) &&
+		    (!hi || set->cmpfunc(elem, hi) < 0))
+			iter->elems[n++] = elem;
+	}
+
+	iter->size = sort_unique(iter->elems, n, set->cmpfunc);
+	iter->next = 0;
+	iter->cmpfunc = set->cmpfunc;
+
+	INFO_PRINT("set_createiter: Successfully created a set iterator.\n");
+	return iter;
+}
+
+void set_destroyiter(set_iter_t *iter)
+{
+	free(iter->elems);
+	free(iter);
+	INFO_PRINT("set_destroyiter: Successfully destroyed set.\n");
+}
+
+int set_hasnext(set_iter_t *iter)
+{
+	return iter->next < iter->size;
+}
+
+void *set_next(set_iter_t *iter)
+{
+	if (iter->next >= iter->size)
+		return NULL;
+
+	return iter->elems[iter->next++];
+}
+
+void set_iter_seek(set_iter_t *iter, void *key)
+{
+	int lo = iter->next, hi = iter->size, mid;
+
+	// Binary search the sorted elements that are still ahead.
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (iter->cmpfunc(iter->elems[mid], key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	iter->next = lo;
+}
+
+void *set_select(set_t *set, int k)
+{
+	set_iter_t *iter;
+	void *elem;
+
+	if (k < 0 || k >= set->size)
+		return NULL;
+
+	// The table keeps no order, so sort the elements like an iterator.
+	iter = set_createiter(set);
+	elem = iter->elems[k];
+	set_destroyiter(iter);
+
+	return elem;
+}
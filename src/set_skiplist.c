@@ -0,0 +1,736 @@
+/**
+ * @file set_skiplist.c
+ * @brief Implementation of set as a lock-free skip list.
+ *
+ * set_add, set_remove and set_contains may be called from any number
+ * of threads at the same time, without a lock. Every level of the skip
+ * list is a sorted singly linked list, and a node is linked in with a
+ * single compare-and-swap per level: first on the bottom level, which
+ * makes the element part of the set, and then on each level above,
+ * which only serves to speed up searches. A thread that loses a race
+ * simply searches again and retries.
+ *
+ * Removal marks the next pointers of a node, top level first, by
+ * setting their lowest bit. Marking the bottom level is what removes
+ * the element, so exactly one thread wins. Marked nodes can no longer
+ * be linked to, and every search unlinks the ones it passes. A removed
+ * node may still be read by other threads, so it is only freed when
+ * the set is destroyed.
+ *
+ * Iteration walks the bottom level in ascending order. An iterator
+ * that runs concurrently with set_add sees every element that was in
+ * the set when it was created, and possibly some that were added later.
+ * The remaining operations (set_union, set_copy, set_destroy, ...) read
+ * their arguments the same way, but set_destroy must not race with any
+ * other operation on the same set.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "common.h"
+#include "set.h"
+#include "printing.h"
+
+#define MAX_LEVEL 32
+
+struct node;
+
+/**
+ * @typedef node
+ * @brief Node holding one element, linked in on levels [0, height).
+ *
+ */
+typedef struct node node_t;
+
+struct node {
+	void *elem;
+	int height;
+	node_t *retired;
+	_Atomic(node_t *) next[];
+};
+
+struct set
+{
+	node_t *head;
+	_Atomic(node_t *) retired;
+	atomic_int size;
+	cmpfunc_t cmpfunc;
+};
+
+/**
+ * @brief Check if a next pointer is marked, i.e. its node is removed.
+ */
+static inline int ismarked(node_t *next)
+{
+	return ((uintptr_t)next & 1) != 0;
+}
+
+static inline node_t *mark(node_t *next)
+{
+	return (node_t *)((uintptr_t)next | 1);
+}
+
+static inline node_t *unmark(node_t *next)
+{
+	return (node_t *)((uintptr_t)next & ~(uintptr_t)1);
+}
+
+/**
+ * @brief Create a node with room for height levels.
+ *
+ * @param elem
+ * @param height
+ * @return node
+ */
+static node_t *newnode(void *elem, int height)
+{
+	node_t *node = malloc(sizeof(node_t) + height * sizeof(_Atomic(node_t *)));
+	int i;
+
+	if (!node)
+		ERROR_PRINT("newnode: Malloc failed!\n");
+
+	node->elem = elem;
+	node->height = height;
+
+	for (i = 0; i < height; i++)
+		atomic_init(&node->next[i], NULL);
+
+	return node;
+}
+
+/**
+ * @brief Draw a random height, where each extra level has probability
+ * 1/2. Every thread keeps its own xorshift state, so no thread ever
+ * waits on another to get a random number.
+ *
+ * @return height in [1, MAX_LEVEL]
+ */
+static int randomheight(void)
+{
+	static _Thread_local unsigned int state = 0;
+	int height = 1;
+
+	if (state == 0)
+		state = (unsigned int)(size_t)&state | 1;
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	// Count the trailing one bits of the random word.
+	while (height < MAX_LEVEL && (state >> (height - 1)) & 1)
+		height++;
+
+	return height;
+}
+
+/**
+ * @brief Find, on every level, the last node before elem (preds) and
+ * the first node at or after it (succs), unlinking removed nodes on
+ * the way. If another thread changes a link first, start over.
+ *
+ * @param set
+ * @param elem
+ * @param preds
+ * @param succs
+ * @return 1 if succs[0] holds an element equal to elem, 0 otherwise.
+ */
+static int findnode(set_t *set, void *elem, node_t **preds, node_t **succs)
+{
+	node_t *pred, *curr = NULL, *succ;
+	int level;
+
+retry:
+	pred = set->head;
+
+	for (level = MAX_LEVEL - 1; level >= 0; level--) {
+		curr = unmark(atomic_load(&pred->next[level]));
+
+		while (curr) {
+			succ = atomic_load(&curr->next[level]);
+
+			// Unlink curr if it is removed, and look at what follows.
+			if (ismarked(succ)) {
+				node_t *expected = curr;
+
+				if (!atomic_compare_exchange_strong(&pred->next[level],
+								    &expected, unmark(succ)))
+					goto retry;
+
+				curr = unmark(succ);
+				continue;
+			}
+
+			if (set->cmpfunc(curr->elem, elem) >= 0)
+				break;
+
+			pred = curr;
+			curr = succ;
+		}
+
+		preds[level] = pred;
+		succs[level] = curr;
+	}
+
+	return curr && set->cmpfunc(curr->elem, elem) == 0;
+}
+
+/**
+ * @brief Create an empty set.
+ */
+static set_t *newset(cmpfunc_t cmpfunc)
+{
+	set_t *set = malloc(sizeof(set_t));
+
+	if (!set)
+		ERROR_PRINT("set_create: Malloc failed!\n");
+
+	set->head = newnode(NULL, MAX_LEVEL);
+	atomic_init(&set->retired, NULL);
+	atomic_init(&set->size, 0);
+	set->cmpfunc = cmpfunc;
+
+	return set;
+}
+
+set_t *set_create(cmpfunc_t cmpfunc)
+{
+	return newset(cmpfunc);
+}
+
+set_t *set_create_hashed(cmpfunc_t cmpfunc, hashfunc_t hashfunc)
+{
+	// The skip list is ordered by comparisons only.
+	(void)hashfunc;
+	return newset(cmpfunc);
+}
+
+void set_destroy(set_t *set)
+{
+	node_t *node = set->head, *next;
+
+	// Removed nodes that are still linked are freed with the retired.
+	while (node) {
+		next = atomic_load(&node->next[0]);
+		if (!ismarked(next))
+			free(node);
+		node = unmark(next);
+	}
+
+	node = atomic_load(&set->retired);
+	while (node) {
+		next = node->retired;
+		free(node);
+		node = next;
+	}
+
+	free(set);
+	INFO_PRINT("set_destroy: Set successfully destroyed.\n");
+}
+
+int set_size(set_t *set)
+{
+	return atomic_load(&set->size);
+}
+
+void set_add(set_t *set, void *elem)
+{
+	node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+	node_t *node = NULL, *expected;
+	int level, height = randomheight();
+
+	for (;;) {
+		if (findnode(set, elem, preds, succs)) {
+			INFO_PRINT("set_add: Elem already exist!\n");
+			free(node);
+			return;
+		}
+
+		if (!node)
+			node = newnode(elem, height);
+
+		for (level = 0; level < height; level++)
+			atomic_store(&node->next[level], succs[level]);
+
+		// Linking in the bottom level is what adds the element.
+		expected = succs[0];
+		if (atomic_compare_exchange_strong(&preds[0]->next[0], &expected, node))
+			break;
+	}
+
+	atomic_fetch_add(&set->size, 1);
+
+	/*
+	 * Link the upper levels. If another thread got in between pred
+	 * and succ, search again for fresh neighbours on every level. If
+	 * the node is removed meanwhile, its next pointers are marked, and
+	 * it is not linked any further. A node marked just after the check
+	 * may still be linked on one level; searches skip it there.
+	 */
+	for (level = 1; level < height; level++) {
+		for (;;) {
+			// A removed node must not be linked in ahead of a new one.
+			if (ismarked(atomic_load(&node->next[level])))
+				return;
+
+			expected = succs[level];
+			if (atomic_compare_exchange_strong(&preds[level]->next[level], &expected, node))
+				break;
+
+			if (!findnode(set, elem, preds, succs) || succs[0] != node)
+				return;
+
+			expected = atomic_load(&node->next[level]);
+			if (ismarked(expected) ||
+			    !atomic_compare_exchange_strong(&node->next[level], &expected, succs[level]))
+				return;
+		}
+	}
+}
+
+int set_remove(set_t *set, void *elem)
+{
+	node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+	node_t *node, *next, *retired;
+	int level;
+
+	if (!findnode(set, elem, preds, succs))
+		return 0;
+
+	node = succs[0];
+
+	// Mark the upper levels, so nothing more is linked after the node.
+	for (level = node->height - 1; level > 0; level--) {
+		next = atomic_load(&node->next[level]);
+		while (!ismarked(next) &&
+		       !atomic_compare_exchange_weak(&node->next[level], &next, mark(next)))
+			;
+	}
+
+	// Whoever marks the bottom level removes the element.
+	next = atomic_load(&node->next[0]);
+	for (;;) {
+		if (ismarked(next))
+			return 0;
+		if (atomic_compare_exchange_weak(&node->next[0], &next, mark(next)))
+			break;
+	}
+
+	atomic_fetch_sub(&set->size, 1);
+
+	// Unlink the node from every level.
+	findnode(set, elem, preds, succs);
+
+	retired = atomic_load(&set->retired);
+	do {
+		node->retired = retired;
+	} while (!atomic_compare_exchange_weak(&set->retired, &retired, node));
+
+	return 1;
+}
+
+int set_contains(set_t *set, void *elem)
+{
+	node_t *pred = set->head, *curr = NULL, *succ;
+	int level, cmpval = 1;
+
+	/*
+	 * Removed nodes are skipped over on every level, not unlinked, to
+	 * stay wait-free. A removed node may still be linked on an upper
+	 * level ahead of a live node for the same element, so only the
+	 * bottom level decides.
+	 */
+	for (level = MAX_LEVEL - 1; level >= 0; level--) {
+		curr = unmark(atomic_load(&pred->next[level]));
+
+		while (curr) {
+			succ = atomic_load(&curr->next[level]);
+			if (ismarked(succ)) {
+				curr = unmark(succ);
+				continue;
+			}
+			if ((cmpval = set->cmpfunc(curr->elem, elem)) >= 0)
+				break;
+			pred = curr;
+			curr = succ;
+		}
+	}
+
+	return curr && cmpval == 0;
+}
+
+/*
+ * The lookups are done one at a time, each a plain set_contains, so
+ * they see the set the same way while other threads change it.
+ */
+int set_contains_many(set_t *set, void **elems, int n, unsigned char *found)
+{
+	int i, count = 0;
+
+	memset(found, 0, (n + 7) / 8);
+	for (i = 0; i < n; i++) {
+		if (set_contains(set, elems[i])) {
+			found[i / 8] |= 1 << (i % 8);
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * The nodes do not count the nodes they skip over, so rank and select
+ * walk the bottom level. Like iteration, they do not see a consistent
+ * snapshot while other threads change the set.
+ */
+int set_rank(set_t *set, void *elem)
+{
+	set_iter_t *iter = set_createiter_range(set, NULL, elem);
+	int rank = 0;
+
+	while (set_next(iter))
+		rank++;
+
+	set_destroyiter(iter);
+	return rank;
+}
+
+void *set_select(set_t *set, int k)
+{
+	set_iter_t *iter = set_createiter(set);
+	void *elem;
+
+	if (k < 0) {
+		set_destroyiter(iter);
+		return NULL;
+	}
+
+	while ((elem = set_next(iter)) && k-- > 0)
+		;
+
+	set_destroyiter(iter);
+	return elem;
+}
+
+/**
+ * @brief Builder that appends elements in ascending order to a set
+ * that no other thread can see yet, so no atomics are needed.
+ */
+typedef struct builder {
+	set_t *set;
+	node_t *last[MAX_LEVEL];
+} builder_t;
+
+static void builder_init(builder_t *builder, set_t *set)
+{
+	int level;
+
+	builder->set = set;
+	for (level = 0; level < MAX_LEVEL; level++)
+		builder->last[level] = set->head;
+}
+
+static void builder_append(builder_t *builder, void *elem)
+{
+	int level, height = randomheight();
+	node_t *node = newnode(elem, height);
+
+	for (level = 0; level < height; level++) {
+		atomic_store_explicit(&builder->last[level]->next[level], node,
+				      memory_order_relaxed);
+		builder->last[level] = node;
+	}
+
+	atomic_fetch_add_explicit(&builder->set->size, 1, memory_order_relaxed);
+}
+
+/*
+ * The set operations below merge the bottom levels of a and b, and
+ * append the result to a new skip list in ascending order.
+ */
+set_t *set_union(set_t *a, set_t *b)
+{
+	set_t *new_set = newset(a->cmpfunc);
+	set_iter_t *ia = set_createiter(a), *ib = set_createiter(b);
+	void *ea = set_next(ia), *eb = set_next(ib);
+	builder_t builder;
+	int cmpval;
+
+	builder_init(&builder, new_set);
+
+	while (ea && eb) {
+		cmpval = a->cmpfunc(ea, eb);
+
+		if (cmpval < 0) {
+			builder_append(&builder, ea);
+			ea = set_next(ia);
+		} else if (cmpval > 0) {
+			builder_append(&builder, eb);
+			eb = set_next(ib);
+		} else {
+			builder_append(&builder, ea);
+			ea = set_next(ia);
+			eb = set_next(ib);
+		}
+	}
+
+	for (; ea; ea = set_next(ia))
+		builder_append(&builder, ea);
+	for (; eb; eb = set_next(ib))
+		builder_append(&builder, eb);
+
+	set_destroyiter(ia);
+	set_destroyiter(ib);
+
+	INFO_PRINT("set_union: Created a union set.\n");
+	return new_set;
+}
+
+set_t *set_intersection(set_t *a, set_t *b)
+{
+	set_t *new_set = newset(a->cmpfunc);
+	set_iter_t *ia = set_createiter(a), *ib = set_createiter(b);
+	void *ea = set_next(ia), *eb = set_next(ib);
+	builder_t builder;
+	int cmpval;
+
+	builder_init(&builder, new_set);
+
+	while (ea && eb) {
+		cmpval = a->cmpfunc(ea, eb);
+
+		if (cmpval < 0) {
+			ea = set_next(ia);
+		} else if (cmpval > 0) {
+			eb = set_next(ib);
+		} else {
+			builder_append(&builder, ea);
+			ea = set_next(ia);
+			eb = set_next(ib);
+		}
+	}
+
+	set_destroyiter(ia);
+	set_destroyiter(ib);
+
+	INFO_PRINT("set_intersection: Created a intersection set.\n");
+	return new_set;
+}
+
+set_t *set_difference(set_t *a, set_t *b)
+{
+	set_t *new_set = newset(a->cmpfunc);
+	set_iter_t *ia = set_createiter(a), *ib = set_createiter(b);
+	void *ea = set_next(ia), *eb = set_next(ib);
+	builder_t builder;
+	int cmpval;
+
+	builder_init(&builder, new_set);
+
+	while (ea && eb) {
+		cmpval = a->cmpfunc(ea, eb);
+
+		if (cmpval < 0) {
+			builder_append(&builder, ea);
+			ea = set_next(ia);
+		} else if (cmpval > 0) {
+			eb = set_next(ib);
+		} else {
+			ea = set_next(ia);
+			eb = set_next(ib);
+		}
+	}
+
+	for (; ea; ea = set_next(ia))
+		builder_append(&builder, ea);
+
+	set_destroyiter(ia);
+	set_destroyiter(ib);
+
+	INFO_PRINT("set_difference: Created a difference set.\n");
+	return new_set;
+}
+
+/*
+ * The in-place operations only use set_add and set_remove, so they are
+ * as safe to run concurrently with other operations on a as those are.
+ */
+void set_union_into(set_t *a, set_t *b)
+{
+	set_iter_t *iter = set_createiter(b);
+
+	while (set_hasnext(iter))
+		set_add(a, set_next(iter));
+
+	set_destroyiter(iter);
+}
+
+void set_intersect_into(set_t *a, set_t *b)
+{
+	set_iter_t *iter = set_createiter(a);
+	void *elem;
+
+	while (set_hasnext(iter)) {
+		elem = set_next(iter);
+
+		if (!set_contains(b, elem))
+			set_remove(a, elem);
+	}
+
+	set_destroyiter(iter);
+}
+
+set_t *set_copy(set_t *set)
+{
+	set_t *copy = newset(set->cmpfunc);
+	set_iter_t *iter = set_createiter(set);
+	builder_t builder;
+
+	builder_init(&builder, copy);
+
+	while (set_hasnext(iter))
+		builder_append(&builder, set_next(iter));
+
+	set_destroyiter(iter);
+
+	INFO_PRINT("set_copy: Created a set copy.\n");
+	return copy;
+}
+
+set_t *set_from_sorted_array(cmpfunc_t cmpfunc, hashfunc_t hashfunc,
+			     void **elems, int n)
+{
+	set_t *set = newset(cmpfunc);
+	builder_t builder;
+	int i;
+
+	(void)hashfunc;
+	builder_init(&builder, set);
+
+	for (i = 0; i < n; i++) {
+		if (i == 0 || cmpfunc(elems[i - 1], elems[i]) != 0)
+			builder_append(&builder, elems[i]);
+	}
+
+	return set;
+}
+
+/*
+ * Like the in-place operations, this only uses set_add, so other
+ * threads may use the set meanwhile. Merging would need a rebuild
+ * that they could not see.
+ */
+void set_add_all(set_t *set, void **elems, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		set_add(set, elems[i]);
+}
+
+
+struct set_iter
+{
+	set_t *set;
+	node_t *node;
+	void *hi;
+};
+
+/**
+ * @brief Move the iterator past nodes that have been removed, and end
+ * it at the upper bound of its range.
+ */
+static void skipremoved(set_iter_t *iter)
+{
+	node_t *next;
+
+	while (iter->node && ismarked(next = atomic_load(&iter->node->next[0])))
+		iter->node = unmark(next);
+
+	if (iter->node && iter->hi && iter->set->cmpfunc(iter->node->elem, iter->hi) >= 0)
+		iter->node = NULL;
+}
+
+/**
+ * @brief Find the first node at the bottom level whose element is not
+ * smaller than key, descending like set_contains without helping to
+ * unlink removed nodes. The node found may itself be removed.
+ *
+ * @param set
+ * @param key
+ * @return node | NULL (every element is smaller than key)
+ */
+static node_t *lowerbound(set_t *set, void *key)
+{
+	node_t *pred = set->head, *curr = NULL;
+	int level;
+
+	for (level = MAX_LEVEL - 1; level >= 0; level--) {
+		curr = unmark(atomic_load(&pred->next[level]));
+
+		while (curr && set->cmpfunc(curr->elem, key) < 0) {
+			pred = curr;
+			curr = unmark(atomic_load(&pred->next[level]));
+		}
+	}
+
+	return curr;
+}
+
+set_iter_t *set_createiter(set_t *set)
+{
+	return set_createiter_range(set, NULL, NULL);
+}
+
+set_iter_t *set_createiter_range(set_t *set, void *lo, void *hi)
+{
+	set_iter_t *iter = malloc(sizeof(set_iter_t));
+
+	if (!iter)
+		ERROR_PRINT("set_createiter: Malloc failed!\n");
+
+	iter->set = set;
+	iter->hi = hi;
+	iter->node = lo ? lowerbound(set, lo) : unmark(atomic_load(&set->head->next[0]));
+	skipremoved(iter);
+
+	INFO_PRINT("set_createiter: Successfully created a set iterator.\n");
+	return iter;
+}
+
+void set_destroyiter(set_iter_t *iter)
+{
+	free(iter);
+	INFO_PRINT("set_destroyiter: Successfully destroyed set.\n");
+}
+
+int set_hasnext(set_iter_t *iter)
+{
+	return iter->node != NULL;
+}
+
+void *set_next(set_iter_t *iter)
+{
+	node_t *node = iter->node;
+
+	if (!node)
+		return NULL;
+
+	iter->node = unmark(atomic_load(&node->next[0]));
+	skipremoved(iter);
+
+	return node->elem;
+}
+
+void set_iter_seek(set_iter_t *iter, void *key)
+{
+	if (!iter->node || iter->set->cmpfunc(iter->node->elem, key) >= 0)
+		return;
+
+	iter->node = lowerbound(iter->set, key);
+	skipremoved(iter);
+}
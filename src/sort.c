@@ -0,0 +1,88 @@
+/**
+ * @file sort.c
+ * @brief Sorting and deduplication of element arrays, shared by the
+ * set backends.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sort.h"
+#include "printing.h"
+
+/**
+ * @brief Merge sort elems[0..n) using tmp as scratch space. Equal
+ * elements keep their order.
+ *
+ * @param elems
+ * @param tmp
+ * @param n
+ * @param cmpfunc
+ */
+static void mergesort_elems(void **elems, void **tmp, int n, cmpfunc_t cmpfunc)
+{
+	int half = n / 2, i = 0, j = half, k = 0;
+
+	if (n < 2)
+		return;
+
+	mergesort_elems(elems, tmp, half, cmpfunc);
+	mergesort_elems(elems + half, tmp, n - half, cmpfunc);
+
+	while (i < half && j < n)
+		tmp[k++] = cmpfunc(elems[j], elems[i]) < 0 ? elems[j++] : elems[i++];
+	while (i < half)
+		tmp[k++] = elems[i++];
+
+	// Whatever is left of the second half is already in place.
+	memcpy(elems, tmp, k * sizeof(void *));
+}
+
+int dedup_sorted(void **elems, int n, cmpfunc_t cmpfunc)
+{
+	int i, k = 0;
+
+	for (i = 0; i < n; i++) {
+		if (k == 0 || cmpfunc(elems[k - 1], elems[i]) != 0)
+			elems[k++] = elems[i];
+	}
+
+	return k;
+}
+
+int sort_unique(void **elems, int n, cmpfunc_t cmpfunc)
+{
+	void **tmp;
+	int i;
+
+	for (i = 1; i < n; i++) {
+		if (cmpfunc(elems[i - 1], elems[i]) > 0)
+			break;
+	}
+
+	if (i < n) {
+		tmp = malloc(n * sizeof(void *));
+
+		if (!tmp)
+			ERROR_PRINT("sort_unique: Malloc failed!\n");
+
+		mergesort_elems(elems, tmp, n, cmpfunc);
+		free(tmp);
+	}
+
+	return dedup_sorted(elems, n, cmpfunc);
+}
+
+void **sorted_copy(void **elems, int *n, cmpfunc_t cmpfunc)
+{
+	void **copy = malloc((*n + 1) * sizeof(void *));
+
+	if (!copy)
+		ERROR_PRINT("sorted_copy: Malloc failed!\n");
+
+	memcpy(copy, elems, *n * sizeof(void *));
+	*n = sort_unique(copy, *n, cmpfunc);
+
+	return copy;
+}
@@ -1,33 +1,65 @@
 /* Author: Steffen Viken Valvaag <steffenv@cs.uit.no> */
 #include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
-#include "list.h"
 #include "set.h"
+#include "frozenset.h"
+#include "intern.h"
 #include "common.h"
 #include "printing.h"
 
 /**
- * @typedef Operations on sets which use two
- * sets as arguments.
+ * @typedef In-place operations on sets, which
+ * change the first set using the second.
  */
-typedef set_t *(*set_oper) (set_t *, set_t *);
+typedef void (*set_oper) (set_t *, set_t *);
 
 /*
- * Case-insensitive comparison function for strings.
+ * Every word is interned, and the sets hold word IDs in place of
+ * the words themselves.  The IDs are case-folded, so two words are
+ * the same word, ignoring case, exactly when their IDs are equal.
  */
-static int compare_words(void *a, void *b)
+static intern_t *symbols;
+
+#define ID_ELEM(id) ((void *)(uintptr_t)(id))
+#define ELEM_ID(elem) ((uint32_t)(uintptr_t)(elem))
+
+/*
+ * Comparison function for word IDs.
+ */
+static int compare_ids(void *a, void *b)
+{
+    uint32_t ia = ELEM_ID(a);
+    uint32_t ib = ELEM_ID(b);
+
+    return (ia > ib) - (ia < ib);
+}
+
+/*
+ * Hash function for word IDs.  The IDs are dense, so they can be
+ * used as they are.
+ */
+static unsigned long hash_ids(void *a)
+{
+    return ELEM_ID(a);
+}
+
+/*
+ * Turns a word into its ID, for tokenize_file_into_set.
+ */
+static void *word_id(const char *word, void *table)
 {
-    return strcasecmp(a, b);
+    return ID_ELEM(intern_word(table, word));
 }
 
 /*
- * Returns the set of (unique) words found in the given file.
+ * Returns the set of (unique) words found in the given file, as
+ * word IDs.
  */
 static set_t *tokenize(char *filename)
 {
-	set_t *wordset = set_create(compare_words);
-	list_t *wordlist = list_create(compare_words);
-	list_iter_t *it;
+	set_t *wordset = set_create_hashed(compare_ids, hash_ids);
 	FILE *f;
 	
 	DEBUG_PRINT("TOKENIZE: %s\n", filename);
@@ -36,19 +68,13 @@ static set_t *tokenize(char *filename)
 		perror("fopen");
 		ERROR_PRINT("fopen() failed");
 	}
-	tokenize_file(f, wordlist);
-	
-	it = list_createiter(wordlist);
-	while (list_hasnext(it)) {
-		set_add(wordset, list_next(it));		
-	}
-	list_destroyiter(it);
-	list_destroy(wordlist);
+	tokenize_file_into_set(f, wordset, word_id, symbols);
+	fclose(f);
 	return wordset;
 }
 
 /*
- * Prints a set of words.
+ * Prints a set of word IDs as words.
  */
 static void printwords(char *prefix, set_t *words)
 {
@@ -57,50 +83,110 @@ static void printwords(char *prefix, set_t *words)
 	it = set_createiter(words);
 	INFO_PRINT("%s: ", prefix);
 	while (set_hasnext(it)) {
-		INFO_PRINT(" %s", (char *)set_next(it));
+		INFO_PRINT(" %s", intern_lookup(symbols, ELEM_ID(set_next(it))));
 	}
 	printf("\n");
 	set_destroyiter(it);
 }
 
 
+/*
+ * The state of dir_apply_oper while it walks a directory.
+ */
+typedef struct {
+	set_t *keywords;
+	set_oper oper;
+} apply_state_t;
+
 /**
- * @brief Get the intersection of words from all files in input
- * list.
- *
- * @param files 
- * @return intersection
+ * @brief Apply the operation to the accumulated words and the words
+ * of the file, which is the first file if there are no words yet.
  */
-static set_t *list_apply_oper(list_t *filelist, set_oper oper)
+static void apply_file(char *fname, void *arg)
 {
-	char *fname;
-	set_t *wordset, *keywords;
-	list_iter_t *fiter;
+	apply_state_t *state = arg;
+	set_t *wordset;
 
-	fiter = list_createiter(filelist);
+	// Tokenize the file, and get the set.
+	wordset = tokenize(fname);
 
-	// Get the first set of words.
-	if (list_hasnext(fiter)) {
+	// The first set of words.
+	if (state->keywords == NULL) {
+		state->keywords = wordset;
+		return;
+	}
 
-		// Get first filename
-		fname = list_next(fiter);
+	// Apply parameter operation on all files. Only the
+	// accumulated set is kept alive between files.
+	state->oper(state->keywords, wordset);
+	set_destroy(wordset);
+}
 
-		// Tokenize the file, and get the set.
-		keywords = tokenize(fname);
-	}
+/**
+ * @brief Apply an operation to the words of all files in a
+ * directory, for instance to get the intersection of them.
+ *
+ * Each file is tokenized as soon as the directory walk finds it.
+ *
+ * @param dir 
+ * @param oper 
+ * @return the accumulated words
+ */
+static set_t *dir_apply_oper(char *dir, set_oper oper)
+{
+	apply_state_t state = { NULL, oper };
+
+	walk_files(dir, apply_file, &state);
+	if (state.keywords == NULL)
+		state.keywords = set_create_hashed(compare_ids, hash_ids);
+	return state.keywords;
+}
+
+/**
+ * @brief Classify one mail file using the frozen filterset, and
+ * print the result.
+ */
+static void classify_file(char *fname, void *arg)
+{
+	frozenset_t *frozen = arg;
+	char *classification;
+	int found, nwords;
+	void **words;
+	unsigned char *hits;
+	set_t *mailwords;
+	set_iter_t *worditer;
 
-	// Find intersection between all words of all files.
-	while (list_hasnext(fiter)) {
-		fname = list_next(fiter);
-		wordset = tokenize(fname);
+	// Tokenize into sets of words.
+	mailwords = tokenize(fname);
 
-		// Apply parameter operation on all files.
-		keywords = oper(keywords, wordset);
+	// Count the mailwords that are in the filterset, looking
+	// them all up in one batch.
+	nwords = 0;
+	words = malloc(set_size(mailwords) * sizeof(void *) + 1);
+	hits = malloc(set_size(mailwords) / 8 + 1);
+	if (words == NULL || hits == NULL)
+		ERROR_PRINT("out of memory");
+	worditer = set_createiter(mailwords);
+	while (set_hasnext(worditer)) {
+		words[nwords++] = set_next(worditer);
 	}
+	set_destroyiter(worditer);
+	found = frozenset_contains_many(frozen, words, nwords, hits);
+	free(words);
+	free(hits);
 
-	list_destroyiter(fiter);
+	// Returns SPAM if more than 0 spamwords found. Else Not spam.
+	classification = found > 0 ? "SPAM" : "Not spam";
 
-	return keywords;
+	// Match format of comparison file.
+	printf(
+		"%s: %d spam word(s) -> %s\n",
+		fname,
+		found,
+		classification
+	);
+
+	set_destroy(mailwords);
 }
 
 /**
@@ -123,59 +209,28 @@ static set_t *list_apply_oper(list_t *filelist, set_oper oper)
  */
 static void spamfilter(char *spam, char *nonspam, char *mail)
 {
-	void *fname;
-	char *classification;
-	list_t *spamfiles, *nonspamfiles, *mailfiles;
-	set_t *spamwords, *nonspamwords, *mailwords, *filterset, *result;
-	list_iter_t *mailiter;
+	set_t *spamwords, *nonspamwords, *filterset;
+	frozenset_t *frozen;
 
-	// Put filenames of all files of input directories
-	// into separate lists.
-	spamfiles = find_files(spam);
-	nonspamfiles = find_files(nonspam);
-	mailfiles = find_files(mail);
-
-	// Apply intersection to spamwords and union to non-spamwords.
-	spamwords = list_apply_oper(spamfiles, set_intersection);
-	nonspamwords = list_apply_oper(nonspamfiles, set_union);
+	// Walk the input directories, tokenizing files as they are
+	// found. Apply intersection to spamwords and union to
+	// non-spamwords.
+	spamwords = dir_apply_oper(spam, set_intersect_into);
+	nonspamwords = dir_apply_oper(nonspam, set_union_into);
 
 	// Find the difference between spam and non-spam.
 	filterset = set_difference(spamwords, nonspamwords);
 
-	mailiter = list_createiter(mailfiles);
-
-	// Iterate over the mail files.
-	while (list_hasnext(mailiter)) {
-		fname = list_next(mailiter);
-
-		// Tokenize into sets of words.
-		mailwords = tokenize(fname);
-
-		// Find intersection between the filterset and mailwords.
-		result = set_intersection(mailwords, filterset);
-		
-
-		// Returns SPAM if more than 0 spamwords found. Else Not spam.
-		classification = set_size(result) > 0 ? "SPAM" : "Not spam";
+	// The filterset is only read from now on, so freeze it.
+	frozen = set_freeze(filterset, compare_ids);
+	set_destroy(filterset);
 
-		// Match format of comparison file.
-		printf(
-			"%s: %d spam word(s) -> %s\n",
-			(char *)fname,
-			set_size(result),
-			classification
-		);
-	}
+	// Classify the mail files as they are found.
+	walk_files(mail, classify_file, frozen);
 
-	list_destroyiter(mailiter);
-	list_destroy(spamfiles);
-	list_destroy(nonspamfiles);
-	list_destroy(mailfiles);
-	set_destroy(filterset);
-	set_destroy(result);
+	frozenset_destroy(frozen);
 	set_destroy(spamwords);
 	set_destroy(nonspamwords);
-	set_destroy(mailwords);
 }
 
 /*
@@ -197,6 +252,8 @@ int main(int argc, char **argv)
 	DEBUG_PRINT("%s\n",nonspamdir);
 	DEBUG_PRINT("%s\n",maildir);
 
+	symbols = intern_create();
 	spamfilter(spamdir, nonspamdir, maildir);
+	intern_destroy(symbols);
 	return 0;
 }
@@ -0,0 +1,259 @@
+/*
+ * Multi-threaded stress test and throughput benchmark for sets that
+ * support concurrent set_add, set_remove and set_contains
+ * (IMPLEMENTATION=skiplist).
+ *
+ * For every thread count from 1 up to the given maximum, the threads
+ * all add the same n keys to one shared set, each starting at its own
+ * offset so that they race on every key, look all of them up, and then
+ * remove the odd keys. Every odd key must be removed by exactly one
+ * thread, and afterwards the set must hold exactly the even keys, in
+ * ascending order.
+ *
+ * Then the threads churn a few keys: every thread adds all of them,
+ * but each key has one owner, the only thread that removes it. A key
+ * must be found by its owner between the owner adding and removing
+ * it, even while other threads add it again and again.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "set.h"
+#include "printing.h"
+
+#define MAX_THREADS 64
+
+/* The number of keys the churn test adds and removes over and over. */
+#define CHURN_KEYS 64
+
+static int compare_ints(void *a, void *b)
+{
+    int *ia = a;
+    int *ib = b;
+
+    return (*ia)-(*ib);
+}
+
+static unsigned long hash_ints(void *a)
+{
+    return (unsigned long)*(int *)a;
+}
+
+typedef struct worker {
+    pthread_t thread;
+    set_t *set;
+    int **keys;
+    int n;
+    int offset;
+    int missing;
+    int removed;
+    int id;
+    int threads;
+    pthread_barrier_t *barrier;
+} worker_t;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *work(void *arg)
+{
+    worker_t *w = arg;
+    int *key;
+    int i;
+
+    for (i = 0; i < w->n; i++) {
+	set_add(w->set, w->keys[(w->offset + i) % w->n]);
+    }
+
+    /* Every key this thread added must be visible to it. */
+    for (i = 0; i < w->n; i++) {
+	if (!set_contains(w->set, w->keys[(w->offset + i) % w->n]))
+	    w->missing++;
+    }
+
+    /* No key may be removed while another thread still looks for it. */
+    pthread_barrier_wait(w->barrier);
+
+    for (i = 0; i < w->n; i++) {
+	key = w->keys[(w->offset + i) % w->n];
+	if (*key % 2 == 1 && set_remove(w->set, key))
+	    w->removed++;
+    }
+
+    return NULL;
+}
+
+/*
+ * Adds every churn key in each round, and removes the ones this
+ * thread owns right after checking that they are there.
+ */
+static void *churn(void *arg)
+{
+    worker_t *w = arg;
+    int *key;
+    int i, round;
+
+    for (round = 0; round < w->n; round++) {
+	for (i = 0; i < CHURN_KEYS; i++) {
+	    key = w->keys[(i + round) % CHURN_KEYS];
+	    set_add(w->set, key);
+	    if (*key % w->threads != w->id)
+		continue;
+	    if (!set_contains(w->set, key))
+		w->missing++;
+	    if (set_remove(w->set, key))
+		w->removed++;
+	}
+    }
+
+    return NULL;
+}
+
+/*
+ * Checks that the set holds exactly the even keys of 0..n-1 in
+ * ascending order.
+ */
+static int check_set(set_t *set, int n)
+{
+    set_iter_t *iter = set_createiter(set);
+    int expected = 0;
+
+    while (set_hasnext(iter)) {
+	if (*(int *)set_next(iter) != expected) {
+	    set_destroyiter(iter);
+	    return 0;
+	}
+	expected += 2;
+    }
+
+    set_destroyiter(iter);
+    return expected / 2 == (n + 1) / 2 && set_size(set) == (n + 1) / 2;
+}
+
+int main(int argc, char **argv)
+{
+    worker_t workers[MAX_THREADS];
+    pthread_barrier_t barrier;
+    set_t *set;
+    int **keys, *tmp, *churnkeys[CHURN_KEYS];
+    int i, j, n, threads, maxthreads, removed;
+    double start, elapsed;
+
+    if (argc != 3) {
+	ERROR_PRINT("Must provide exactly 2 arguments!\nUsage: %s <threads> <n>\n", argv[0]);
+	return 1;
+    }
+
+    maxthreads = atoi(argv[1]);
+    n = atoi(argv[2]);
+
+    if (maxthreads < 1 || maxthreads > MAX_THREADS || n < CHURN_KEYS) {
+	ERROR_PRINT("Threads must be within 1..%d, and n at least %d\n", MAX_THREADS, CHURN_KEYS);
+	return 1;
+    }
+
+    /* Shuffle the keys, so insertion order is random. */
+    keys = malloc(sizeof(int *) * n);
+    for (i = 0; i < n; i++) {
+	keys[i] = malloc(sizeof(int));
+	*keys[i] = i;
+    }
+    srand(time(NULL));
+    for (i = n - 1; i > 0; i--) {
+	j = rand() % (i + 1);
+	tmp = keys[i];
+	keys[i] = keys[j];
+	keys[j] = tmp;
+    }
+
+    /* The churn keys are 0..CHURN_KEYS-1, found among the first n keys. */
+    for (i = 0; i < n; i++) {
+	if (*keys[i] < CHURN_KEYS)
+	    churnkeys[*keys[i]] = keys[i];
+    }
+
+    printf("threads,seconds,ops_per_second\n");
+
+    for (threads = 1; threads <= maxthreads; threads++) {
+	set = set_create_hashed(compare_ints, hash_ints);
+	pthread_barrier_init(&barrier, NULL, threads);
+
+	start = now();
+	for (i = 0; i < threads; i++) {
+	    workers[i].set = set;
+	    workers[i].keys = keys;
+	    workers[i].n = n;
+	    workers[i].offset = (int)((long)n * i / threads);
+	    workers[i].missing = 0;
+	    workers[i].removed = 0;
+	    workers[i].barrier = &barrier;
+	    if (pthread_create(&workers[i].thread, NULL, work, &workers[i]) != 0)
+		ERROR_PRINT("pthread_create failed\n");
+	}
+	removed = 0;
+	for (i = 0; i < threads; i++) {
+	    pthread_join(workers[i].thread, NULL);
+	    if (workers[i].missing)
+		ERROR_PRINT("Thread %d could not find %d of its keys\n", i, workers[i].missing);
+	    removed += workers[i].removed;
+	}
+	elapsed = now() - start;
+	pthread_barrier_destroy(&barrier);
+
+	if (removed != n / 2)
+	    ERROR_PRINT("Removed %d odd keys, expected %d\n", removed, n / 2);
+
+	if (!check_set(set, n))
+	    ERROR_PRINT("Set is invalid after %d threads (size %d, expected %d)\n",
+			threads, set_size(set), (n + 1) / 2);
+
+	/* Each thread does n adds, n lookups and n removal attempts. */
+	printf("%d,%lf,%.0lf\n", threads, elapsed, 3.0 * n * threads / elapsed);
+
+	set_destroy(set);
+    }
+
+    /* Churn the values 0..CHURN_KEYS-1, a few times for every n / CHURN_KEYS keys. */
+    printf("churn_threads,seconds,ops_per_second\n");
+    for (threads = 2; threads <= maxthreads; threads++) {
+	set = set_create_hashed(compare_ints, hash_ints);
+
+	start = now();
+	for (i = 0; i < threads; i++) {
+	    workers[i].set = set;
+	    workers[i].keys = churnkeys;
+	    workers[i].n = n / CHURN_KEYS;
+	    workers[i].id = i;
+	    workers[i].threads = threads;
+	    workers[i].missing = 0;
+	    workers[i].removed = 0;
+	    if (pthread_create(&workers[i].thread, NULL, churn, &workers[i]) != 0)
+		ERROR_PRINT("pthread_create failed\n");
+	}
+	for (i = 0; i < threads; i++) {
+	    pthread_join(workers[i].thread, NULL);
+	    if (workers[i].missing)
+		ERROR_PRINT("Thread %d lost %d of its churned keys\n", i, workers[i].missing);
+	    if (workers[i].removed != workers[i].n * ((CHURN_KEYS - i + threads - 1) / threads))
+		ERROR_PRINT("Thread %d removed %d of its churned keys\n", i, workers[i].removed);
+	}
+	elapsed = now() - start;
+
+	/* Each round, each thread adds every key, and looks up and removes its own. */
+	printf("%d,%lf,%.0lf\n", threads, elapsed,
+	       (double)(n / CHURN_KEYS) * (CHURN_KEYS * threads + 2 * CHURN_KEYS) / elapsed);
+
+	set_destroy(set);
+    }
+
+    for (i = 0; i < n; i++) {
+	free(keys[i]);
+    }
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,343 @@
+/**
+ * @file wordscan.c
+ * @brief Implementation of word scanners, with a scalar, an SSE2 and
+ * an AVX2 version.
+ *
+ * The scalar version looks up every byte in a table, and is the
+ * reference the others are tested against. The vector versions
+ * classify a block of 64 bytes at a time into a bitmask with one bit
+ * per byte, set for word characters. The words start and end where
+ * the mask changes, so each boundary is found by counting trailing
+ * zeros instead of by looking at every byte.
+ *
+ * @author Christian Salomonsen
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wordscan.h"
+#include "printing.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#define BLOCK 64
+
+typedef size_t (*scanfunc_t)(wordscan_t *, size_t *, size_t *, size_t);
+
+/*
+ * pos is the offset of the next byte to classify. The vector versions
+ * only stop at whole blocks, so a word may be in progress at pos; it
+ * started at start.
+ */
+struct wordscan {
+	const unsigned char *data;
+	size_t size;
+	size_t pos;
+	size_t start;
+	int inword;
+	scanfunc_t scanfunc;
+};
+
+/*
+ * 1 for the bytes that make up words, [a-zA-Z0-9'_], and 0 for the rest.
+ */
+static const unsigned char wordchar[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x00 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x10 */
+	0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x20: ' */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,	/* 0x30: 0-9 */
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x40: A-O */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,	/* 0x50: P-Z _ */
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x60: a-o */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,	/* 0x70: p-z */
+};
+
+/**
+ * @brief Find words one byte at a time.
+ *
+ * Never leaves a word in progress, so it can stop after any word.
+ */
+static size_t scan_scalar(wordscan_t *scan, size_t *starts, size_t *ends, size_t max)
+{
+	const unsigned char *data = scan->data;
+	size_t n = 0, pos = scan->pos, size = scan->size, start;
+
+	while (n < max) {
+		while (pos < size && !wordchar[data[pos]])
+			pos++;
+		if (pos == size)
+			break;
+		start = pos;
+		while (pos < size && wordchar[data[pos]] && pos - start < WORDSCAN_MAX_WORD)
+			pos++;
+		starts[n] = start;
+		ends[n++] = pos;
+	}
+	scan->pos = pos;
+	return n;
+}
+
+/**
+ * @brief Store the word from start to end, split into pieces no
+ * longer than WORDSCAN_MAX_WORD.
+ *
+ * @return the new number of stored words.
+ */
+static inline size_t emit(size_t start, size_t end, size_t *starts, size_t *ends, size_t n)
+{
+	while (end - start > WORDSCAN_MAX_WORD) {
+		starts[n] = start;
+		ends[n++] = start + WORDSCAN_MAX_WORD;
+		start += WORDSCAN_MAX_WORD;
+	}
+	starts[n] = start;
+	ends[n++] = end;
+	return n;
+}
+
+/**
+ * @brief Find words a block at a time, from the bitmasks made by
+ * classify.
+ *
+ * Inlined into each vector version, so that classify is inlined too.
+ * A block holds at most 32 words, and cutting long words adds at most
+ * two more, so a block is only scanned while there is room for 64.
+ */
+static inline __attribute__((always_inline)) size_t
+scan_blocks(wordscan_t *scan, uint64_t (*classify)(const unsigned char *),
+	    size_t *starts, size_t *ends, size_t max)
+{
+	unsigned char tail[BLOCK];
+	const unsigned char *block;
+	uint64_t mask, edges;
+	size_t n = 0, base, i;
+
+	while (scan->pos < scan->size && n + BLOCK <= max) {
+		base = scan->pos;
+		if (scan->size - base >= BLOCK) {
+			block = scan->data + base;
+		} else {
+			/* Pad the last block with bytes that are not word characters. */
+			memset(tail, 0, BLOCK);
+			memcpy(tail, scan->data + base, scan->size - base);
+			block = tail;
+		}
+		mask = classify(block);
+
+		/* Cut a long word in progress, so no word grows past one piece and a block. */
+		while (scan->inword && base - scan->start >= WORDSCAN_MAX_WORD) {
+			starts[n] = scan->start;
+			ends[n++] = scan->start + WORDSCAN_MAX_WORD;
+			scan->start += WORDSCAN_MAX_WORD;
+		}
+
+		/* Words start and end where a bit differs from the one before it. */
+		edges = mask ^ ((mask << 1) | (uint64_t)scan->inword);
+		while (edges) {
+			i = base + __builtin_ctzll(edges);
+			if (scan->inword)
+				n = emit(scan->start, i, starts, ends, n);
+			else
+				scan->start = i;
+			scan->inword = !scan->inword;
+			edges &= edges - 1;
+		}
+		scan->pos = base + BLOCK < scan->size ? base + BLOCK : scan->size;
+	}
+
+	/* A word that runs to the end of a buffer of whole blocks. */
+	if (scan->pos == scan->size && scan->inword && n + 2 <= max) {
+		n = emit(scan->start, scan->size, starts, ends, n);
+		scan->inword = 0;
+	}
+	return n;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * Range checks on bytes are done as signed comparisons, after adding
+ * an offset that moves the first byte of the range to -128. Bytes
+ * outside the range wrap around to values above the end of it.
+ * Letters are folded to lower case by setting bit 5 first, which maps
+ * no other byte into a-z.
+ */
+#define LOWER_OFFSET ((char)(0x80 - 'a'))
+#define LOWER_END ((char)(-128 + 26))
+#define DIGIT_OFFSET ((char)(0x80 - '0'))
+#define DIGIT_END ((char)(-128 + 10))
+
+/**
+ * @brief Classify 16 bytes with SSE2.
+ *
+ * @return 0xff in each byte that is a word character, 0 in the rest.
+ */
+static inline __m128i wordchars_sse2(__m128i c)
+{
+	__m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	__m128i alpha = _mm_cmplt_epi8(_mm_add_epi8(lower, _mm_set1_epi8(LOWER_OFFSET)),
+				       _mm_set1_epi8(LOWER_END));
+	__m128i digit = _mm_cmplt_epi8(_mm_add_epi8(c, _mm_set1_epi8(DIGIT_OFFSET)),
+				       _mm_set1_epi8(DIGIT_END));
+	__m128i quote = _mm_cmpeq_epi8(c, _mm_set1_epi8('\''));
+	__m128i under = _mm_cmpeq_epi8(c, _mm_set1_epi8('_'));
+
+	return _mm_or_si128(_mm_or_si128(alpha, digit), _mm_or_si128(quote, under));
+}
+
+static inline uint64_t classify_sse2(const unsigned char *p)
+{
+	uint64_t mask = 0;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+		mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(wordchars_sse2(c)) << (16 * i);
+	}
+	return mask;
+}
+
+static size_t scan_sse2(wordscan_t *scan, size_t *starts, size_t *ends, size_t max)
+{
+	return scan_blocks(scan, classify_sse2, starts, ends, max);
+}
+
+/**
+ * @brief Classify 32 bytes with AVX2, the same way as wordchars_sse2.
+ */
+__attribute__((target("avx2")))
+static inline __m256i wordchars_avx2(__m256i c)
+{
+	__m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+	__m256i alpha = _mm256_cmpgt_epi8(_mm256_set1_epi8(LOWER_END),
+					  _mm256_add_epi8(lower, _mm256_set1_epi8(LOWER_OFFSET)));
+	__m256i digit = _mm256_cmpgt_epi8(_mm256_set1_epi8(DIGIT_END),
+					  _mm256_add_epi8(c, _mm256_set1_epi8(DIGIT_OFFSET)));
+	__m256i quote = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\''));
+	__m256i under = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_'));
+
+	return _mm256_or_si256(_mm256_or_si256(alpha, digit), _mm256_or_si256(quote, under));
+}
+
+__attribute__((target("avx2")))
+static inline uint64_t classify_avx2(const unsigned char *p)
+{
+	__m256i lo = _mm256_loadu_si256((const __m256i *)p);
+	__m256i hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+
+	return (uint64_t)(uint32_t)_mm256_movemask_epi8(wordchars_avx2(lo)) |
+	       (uint64_t)(uint32_t)_mm256_movemask_epi8(wordchars_avx2(hi)) << 32;
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(wordscan_t *scan, size_t *starts, size_t *ends, size_t max)
+{
+	return scan_blocks(scan, classify_avx2, starts, ends, max);
+}
+
+#endif
+
+/*
+ * The implementation new scanners use, picked on first use.
+ */
+static scanfunc_t current;
+
+static struct {
+	const char *name;
+	scanfunc_t func;
+} impls[] = {
+	{ "scalar", scan_scalar },
+#ifdef HAVE_X86_SIMD
+	{ "sse2", scan_sse2 },
+	{ "avx2", scan_avx2 },
+#endif
+};
+
+#define NUM_IMPLS (sizeof(impls) / sizeof(impls[0]))
+
+/**
+ * @brief Check whether the CPU can run the implementation at index i
+ * of impls.
+ */
+static int supported(size_t i)
+{
+#ifdef HAVE_X86_SIMD
+	if (impls[i].func == scan_avx2)
+		return __builtin_cpu_supports("avx2");
+#endif
+	(void)i;
+	return 1;
+}
+
+/**
+ * @brief Pick the last supported implementation, which is the fastest.
+ */
+static scanfunc_t fastest(void)
+{
+	size_t i = NUM_IMPLS;
+
+	while (!supported(--i))
+		;
+	return impls[i].func;
+}
+
+wordscan_t *wordscan_create(const char *data, size_t size)
+{
+	wordscan_t *scan = malloc(sizeof(wordscan_t));
+
+	if (!scan)
+		ERROR_PRINT("wordscan_create: Malloc failed!\n");
+
+	if (!current)
+		current = fastest();
+
+	scan->data = (const unsigned char *)data;
+	scan->size = size;
+	scan->pos = 0;
+	scan->start = 0;
+	scan->inword = 0;
+	scan->scanfunc = current;
+
+	return scan;
+}
+
+void wordscan_destroy(wordscan_t *scan)
+{
+	free(scan);
+}
+
+size_t wordscan_next(wordscan_t *scan, size_t *starts, size_t *ends, size_t max)
+{
+	return scan->scanfunc(scan, starts, ends, max);
+}
+
+int wordscan_select(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < NUM_IMPLS; i++) {
+		if (strcmp(impls[i].name, name) == 0 && supported(i)) {
+			current = impls[i].func;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+const char *wordscan_impl(void)
+{
+	size_t i;
+
+	if (!current)
+		current = fastest();
+	for (i = 0; i < NUM_IMPLS; i++) {
+		if (impls[i].func == current)
+			break;
+	}
+	return impls[i].name;
+}